@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "FrameCodec.h"
+
+// One direction of a serial line in virtual time: frames are serialised back
+// to back at the baud rate, arrive after the adapter latency and are lost
+// with the given probability (a CRC error drops the whole frame).
+class SimulatedLine {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  SimulatedLine(int baud, Clock::duration latency, double loss, uint32_t seed)
+      : baud_(baud), latency_(latency), loss_(loss), rng_(seed) {}
+
+  // Returns false if the frame is corrupted on the way
+  bool Transmit(const std::vector<uint8_t>& payload, Clock::time_point now,
+                Clock::time_point& arrival) {
+    std::vector<uint8_t> frame;
+    FrameCodec::Encode(FrameCodec::Framing::kLegacy, payload.data(),
+                       payload.size(), frame);
+    busy_until_ = std::max(busy_until_, now) +
+                  std::chrono::nanoseconds(frame.size() * 10 * 1000000000LL / baud_);
+    arrival = busy_until_ + latency_;
+    wire_bytes_ += frame.size();
+    return std::uniform_real_distribution<double>(0, 1)(rng_) >= loss_;
+  }
+
+  uint64_t wire_bytes() const { return wire_bytes_; }
+
+ private:
+  int baud_;
+  Clock::duration latency_;
+  double loss_;
+  std::mt19937 rng_;
+  Clock::time_point busy_until_{};
+  uint64_t wire_bytes_ = 0;
+};
@@ -0,0 +1,171 @@
+// Firmware upload time against the simulated ECU over a simulated serial
+// link, in virtual time. The host runs the real FirmwareUpload and Segmenter,
+// the ECU the real Segmenter and EcuSimulator, which takes a fixed time per
+// byte to program each block and handles one request at a time.
+// Usage: firmware_bench [image_kib]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "EcuSimulator.h"
+#include "FirmwareUpload.h"
+#include "FrameCodec.h"
+#include "Protocol.h"
+#include "Segmenter.h"
+#include "SimulatedLine.h"
+
+namespace {
+
+using Clock = Segmenter::Clock;
+
+// Flash programming speed of a typical MCU (about 8 ms per 4 KiB)
+constexpr auto kProgramTimePerByte = std::chrono::nanoseconds(2000);
+
+struct Event {
+  enum Kind { kToEcu, kToHost, kEcuDone } kind;
+  Clock::time_point time;
+  std::vector<uint8_t> payload;
+  bool operator>(const Event& other) const { return time > other.time; }
+};
+
+struct Scenario {
+  int baud;
+  size_t block_size;
+  size_t window;
+  double loss;
+  double flash_errors;
+};
+
+void Run(const Scenario& sc, const std::vector<uint8_t>& image) {
+  Clock::time_point now = Clock::now();
+  const Clock::time_point start = now;
+
+  EcuSimulator::Config ecu_config;
+  ecu_config.flash_error_rate = sc.flash_errors;
+  EcuSimulator ecu(ecu_config);
+  Segmenter ecu_link;
+  Segmenter host_link;
+  FirmwareUpload::Config upload_config;
+  upload_config.block_size = sc.block_size;
+  upload_config.window = sc.window;
+  upload_config.timeout = FirmwareUpload::TimeoutFor(sc.block_size, sc.baud);
+  FirmwareUpload upload(upload_config);
+
+  SimulatedLine to_ecu(sc.baud, std::chrono::milliseconds(2), sc.loss, 1);
+  SimulatedLine to_host(sc.baud, std::chrono::milliseconds(2), sc.loss, 2);
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+  Clock::time_point ecu_busy_until = now;
+
+  auto transmit = [&](std::vector<uint8_t> frame, bool host_side) {
+    Clock::time_point arrival;
+    SimulatedLine& line = host_side ? to_ecu : to_host;
+    if (line.Transmit(frame, now, arrival)) {
+      events.push({host_side ? Event::kToEcu : Event::kToHost, arrival, std::move(frame)});
+    }
+  };
+  // Payloads larger than a frame go through the sender's segmenter, as in
+  // SerialTransport::Send
+  auto send = [&](Segmenter::Frames& payloads, bool host_side) {
+    Segmenter& link = host_side ? host_link : ecu_link;
+    for (auto& payload : payloads) {
+      if (payload.size() <= FrameCodec::kMaxPayload) {
+        transmit(std::move(payload), host_side);
+        continue;
+      }
+      Segmenter::Frames segments;
+      link.Send(std::move(payload), now, segments);
+      for (auto& segment : segments) transmit(std::move(segment), host_side);
+    }
+    payloads.clear();
+  };
+
+  Segmenter::Frames out;
+  Segmenter::Frames completed;
+  upload.Start(image, now, out);
+  send(out, true);
+
+  const auto tick = std::chrono::milliseconds(1);
+  Clock::time_point next_poll = now + tick;
+  while (upload.active() && now - start < std::chrono::hours(1)) {
+    if (events.empty() || events.top().time > next_poll) {
+      now = next_poll;
+      next_poll += tick;
+      host_link.Poll(now, out);
+      for (auto& frame : out) transmit(std::move(frame), true);
+      out.clear();
+      ecu_link.Poll(now, out);
+      for (auto& frame : out) transmit(std::move(frame), false);
+      out.clear();
+      upload.Poll(now, out);
+      send(out, true);
+      continue;
+    }
+
+    Event e = events.top();
+    events.pop();
+    now = e.time;
+    if (e.kind == Event::kEcuDone) {
+      ecu.HandleRequest(e.payload, now, out);
+      send(out, false);
+      continue;
+    }
+
+    bool to_ecu = e.kind == Event::kToEcu;
+    Segmenter& link = to_ecu ? ecu_link : host_link;
+    Segmenter::Frames replies;
+    if (!link.OnFrame(e.payload, now, replies, completed)) {
+      completed.push_back(std::move(e.payload));
+    }
+    for (auto& frame : replies) transmit(std::move(frame), !to_ecu);
+    for (auto& payload : completed) {
+      if (to_ecu) {
+        // The ECU handles requests in order; programming a block takes time
+        bool write = payload.size() > 1 && payload[0] == protocol::kFirmware &&
+                     payload[1] == protocol::kFirmwareWrite;
+        ecu_busy_until = std::max(ecu_busy_until, now) +
+                         (write ? kProgramTimePerByte * static_cast<int64_t>(payload.size())
+                                : Clock::duration(0));
+        events.push({Event::kEcuDone, ecu_busy_until, std::move(payload)});
+      } else {
+        upload.OnResponse(payload, now, out);
+        send(out, true);
+      }
+    }
+    completed.clear();
+  }
+
+  double seconds = std::chrono::duration<double>(now - start).count();
+  double rate = image.size() / seconds;
+  printf("%7d %6zu %6zu %5.1f%% %5.1f%% %8.2f s %8.0f B/s %6.1f%% %7zu %7llu  %s\n",
+         sc.baud, sc.block_size, sc.window, sc.loss * 100, sc.flash_errors * 100,
+         seconds, rate, 100 * rate / (sc.baud / 10.0), upload.blocks_resent(),
+         static_cast<unsigned long long>(host_link.stats().retransmits),
+         upload.state() == FirmwareUpload::State::kDone ? "verified" : upload.error().c_str());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t kib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  std::vector<uint8_t> image(kib * 1024);
+  std::mt19937 rng(5);
+  for (auto& b : image) b = static_cast<uint8_t>(rng());
+
+  printf("%zu KiB image, 2 ms latency each way, %lld ns/byte flash programming\n",
+         kib, static_cast<long long>(kProgramTimePerByte.count()));
+  printf("   baud  block window   loss flasherr      time        rate   line  resent  frames  result\n");
+  for (int baud : {115200, 1000000}) {
+    for (size_t block : {1024, 4096}) {
+      for (size_t window : {1, 4}) {
+        Run({baud, block, window, 0, 0}, image);
+      }
+    }
+    Run({baud, 4096, 4, 0.01, 0}, image);
+    Run({baud, 4096, 4, 0.01, 0.02}, image);
+    Run({baud, 4096, 4, 0.05, 0.05}, image);
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+// Decode throughput and resynchronisation cost of the legacy and COBS
+// framings. Usage: frame_codec_bench [frames]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "FrameCodec.h"
+
+namespace {
+
+using Framing = FrameCodec::Framing;
+
+// Read size of the transport loops
+constexpr size_t kChunk = 256;
+
+// Telemetry-like payloads: small signed values give plenty of 0x00 and 0xFF
+// bytes, and some 0xAA bytes act as false legacy sync candidates
+std::vector<std::vector<uint8_t>> MakePayloads(size_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> byte(0, 255);
+  const size_t sizes[] = {2, 17, 44, 53, 76, 126, 252};
+  std::vector<std::vector<uint8_t>> payloads(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto& p = payloads[i];
+    p.resize(sizes[i % (sizeof(sizes) / sizeof(sizes[0]))]);
+    for (auto& b : p) {
+      int r = byte(rng);
+      b = r < 64 ? 0x00 : r < 96 ? 0xFF : r < 112 ? 0xAA : byte(rng);
+    }
+  }
+  return payloads;
+}
+
+std::vector<uint8_t> EncodeStream(Framing framing,
+                                  const std::vector<std::vector<uint8_t>>& payloads,
+                                  std::vector<size_t>& offsets) {
+  std::vector<uint8_t> stream;
+  offsets.clear();
+  for (const auto& p : payloads) {
+    offsets.push_back(stream.size());
+    FrameCodec::Encode(framing, p.data(), p.size(), stream);
+  }
+  return stream;
+}
+
+size_t Decode(Framing framing, const std::vector<uint8_t>& stream,
+              uint64_t* crc_errors) {
+  FrameCodec codec;
+  codec.SetFraming(framing);
+  size_t frames = 0;
+  auto handler = [&](std::vector<uint8_t>&, const uint8_t*, size_t) { ++frames; };
+  for (size_t pos = 0; pos < stream.size(); pos += kChunk) {
+    size_t n = std::min(kChunk, stream.size() - pos);
+    codec.Feed(stream.data() + pos, n, handler);
+  }
+  if (crc_errors) *crc_errors = codec.crc_errors();
+  return frames;
+}
+
+void Run(const char* name, Framing framing,
+         const std::vector<std::vector<uint8_t>>& payloads) {
+  std::vector<size_t> offsets;
+  std::vector<uint8_t> stream = EncodeStream(framing, payloads, offsets);
+
+  auto start = std::chrono::steady_clock::now();
+  size_t frames = Decode(framing, stream, nullptr);
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Corrupt the length byte (legacy) or the first code byte (COBS) of every
+  // 100th frame: the damaged frame itself is lost in either case, anything
+  // beyond that is the resynchronisation cost
+  std::vector<uint8_t> damaged = stream;
+  size_t corrupted = 0;
+  for (size_t i = 0; i < offsets.size(); i += 100) {
+    damaged[offsets[i] + (framing == Framing::kLegacy ? 1 : 0)] = 0xFE;
+    ++corrupted;
+  }
+  uint64_t crc_errors = 0;
+  size_t survived = Decode(framing, damaged, &crc_errors);
+  size_t lost = payloads.size() - survived;
+
+  size_t payload_bytes = 0;
+  for (const auto& p : payloads) payload_bytes += p.size();
+
+  printf("%-7s %9zu frames %8.2f MB  %10.0f frames/s %7.1f MB/s  overhead %5.2f%%\n",
+         name, frames, stream.size() / 1e6, frames / s, stream.size() / s / 1e6,
+         100.0 * stream.size() / payload_bytes - 100.0);
+  printf("        %zu corrupted: %zu frames lost (%.2f per corruption), %llu CRC checks failed\n",
+         corrupted, lost, static_cast<double>(lost) / corrupted,
+         static_cast<unsigned long long>(crc_errors));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  auto payloads = MakePayloads(count);
+  Run("legacy", Framing::kLegacy, payloads);
+  Run("cobs", Framing::kCobs, payloads);
+  return 0;
+}
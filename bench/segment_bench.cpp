@@ -0,0 +1,123 @@
+// Goodput of segmented transfers over a simulated serial link, in virtual
+// time: line rate, adapter latency and frame loss (a CRC error drops the
+// whole frame) are modelled, the Segmenter code is the real one.
+// Usage: segment_bench [transfer_kib]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "FrameCodec.h"
+#include "Segmenter.h"
+#include "SimulatedLine.h"
+
+namespace {
+
+using Clock = Segmenter::Clock;
+
+struct Delivery {
+  Clock::time_point time;
+  bool to_receiver;
+  std::vector<uint8_t> payload;
+  bool operator>(const Delivery& other) const { return time > other.time; }
+};
+
+void Run(int baud, size_t window, double loss, size_t transfer_bytes,
+         int transfers) {
+  Segmenter::Config config;
+  config.window = window;
+  Segmenter sender(config);
+  Segmenter receiver(config);
+  SimulatedLine forward(baud, std::chrono::milliseconds(2), loss, 1);
+  SimulatedLine backward(baud, std::chrono::milliseconds(2), loss, 2);
+
+  std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> wire;
+  Clock::time_point now{std::chrono::seconds(1)};
+  Clock::time_point start = now;
+
+  auto transmit = [&](Segmenter::Frames& frames, bool to_receiver) {
+    for (auto& payload : frames) {
+      Clock::time_point arrival;
+      SimulatedLine& line = to_receiver ? forward : backward;
+      if (line.Transmit(payload, now, arrival)) {
+        wire.push({arrival, to_receiver, std::move(payload)});
+      }
+    }
+    frames.clear();
+  };
+
+  std::mt19937 rng(3);
+  std::vector<uint8_t> payload(transfer_bytes);
+  for (auto& b : payload) b = static_cast<uint8_t>(rng());
+
+  Segmenter::Frames out;
+  Segmenter::Frames completed;
+  for (int i = 0; i < transfers; ++i) sender.Send(payload, now, out);
+  transmit(out, true);
+
+  auto wall_start = std::chrono::steady_clock::now();
+  int received = 0;
+  bool intact = true;
+  const auto tick = std::chrono::milliseconds(1);
+  Clock::time_point next_poll = now + tick;
+  while (received + sender.stats().transfers_failed < static_cast<uint64_t>(transfers) &&
+         now - start < std::chrono::hours(1)) {
+    if (!wire.empty() && wire.top().time <= next_poll) {
+      Delivery d = wire.top();
+      wire.pop();
+      now = d.time;
+      Segmenter& peer = d.to_receiver ? receiver : sender;
+      peer.OnFrame(d.payload, now, out, completed);
+      transmit(out, !d.to_receiver);
+      for (const auto& c : completed) {
+        ++received;
+        intact = intact && c == payload;
+      }
+      completed.clear();
+    } else {
+      now = next_poll;
+      next_poll += tick;
+      sender.Poll(now, out);
+      transmit(out, true);
+      receiver.Poll(now, out);
+      transmit(out, false);
+    }
+  }
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+  double seconds = std::chrono::duration<double>(now - start).count();
+  double goodput = received * static_cast<double>(transfer_bytes) / seconds;
+  double line_rate = baud / 10.0;
+  const Segmenter::Stats& s = sender.stats();
+  printf("%7d %6zu %5.1f%% %9.0f B/s %6.1f%% %8llu %8llu %6llu %s %7.1f MB/s cpu\n",
+         baud, window, loss * 100, goodput, 100 * goodput / line_rate,
+         static_cast<unsigned long long>(s.retransmits),
+         static_cast<unsigned long long>(receiver.stats().acks_sent),
+         static_cast<unsigned long long>(s.transfers_failed),
+         intact && received == transfers ? "ok  " : "FAIL",
+         received * transfer_bytes / wall_s / 1e6);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t kib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  const int transfers = 4;
+
+  // Data per full frame: 246 of 252 payload bytes plus 4 bytes of framing
+  double ceiling = 100.0 * Segmenter::kSegmentData /
+                   (FrameCodec::kMaxPayload + 4);
+  printf("%d transfers of %zu KiB, 2 ms latency each way, ceiling %.1f%% of line rate\n",
+         transfers, kib, ceiling);
+  printf("   baud window   loss    goodput      line  retrans     acks failed\n");
+  for (int baud : {115200, 1000000}) {
+    for (size_t window : {4, 16, 32}) {
+      for (double loss : {0.0, 0.01, 0.05}) {
+        Run(baud, window, loss, kib * 1024, transfers);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3, as used by zlib and most bootloaders); pass the
+// previous result as crc to checksum data in pieces
+uint32_t Crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+// SHA-256 (FIPS 180-4), incremental
+class Sha256 {
+ public:
+  using Digest = std::array<uint8_t, 32>;
+
+  Sha256();
+  void Update(const uint8_t* data, size_t len);
+  Digest Final();
+
+  static Digest Hash(const uint8_t* data, size_t len);
+
+ private:
+  void Compress(const uint8_t* block);
+
+  uint32_t state_[8];
+  uint8_t buffer_[64];
+  size_t buffered_ = 0;
+  uint64_t length_ = 0;  // Bytes hashed so far
+};
@@ -0,0 +1,429 @@
+#include "CliRunner.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "DriveMixer.h"
+
+namespace {
+
+// Bytes requested per read_log; larger responses arrive segmented
+constexpr int kLogChunk = 0xFFFF;
+
+}  // namespace
+
+CliRunner::CliRunner(const Options& options, QObject *parent)
+    : QObject(parent), options_(options), out_(stdout) {
+    connector_ = new ECUConnector(this);
+    profiler_ = new LinkProfiler(connector_, this);
+    connect(profiler_, &LinkProfiler::StepFinished, this, &CliRunner::OnPingStep);
+    connect(profiler_, &LinkProfiler::Finished, this, &CliRunner::OnPingFinished);
+
+    responseTimer_ = new QTimer(this);
+    responseTimer_->setSingleShot(true);
+    connect(responseTimer_, &QTimer::timeout, this, &CliRunner::OnResponseTimeout);
+
+    pollTimer_ = new QTimer(this);
+    pollTimer_->setTimerType(Qt::PreciseTimer);
+    connect(pollTimer_, &QTimer::timeout, this, &CliRunner::OnPollTick);
+
+    connect(connector_, &ECUConnector::ConnectionChanged, this, &CliRunner::OnConnectionChanged);
+    connect(connector_, &ECUConnector::ErrorOccurred, this, &CliRunner::OnError);
+    connect(connector_, &ECUConnector::ApiVersionReceived, this, &CliRunner::OnApiVersion);
+    connect(connector_, &ECUConnector::EncoderValuesUpdated, this, &CliRunner::OnEncoders);
+    connect(connector_, &ECUConnector::ImuDataReceived, this, &CliRunner::OnImu);
+    connect(connector_, &ECUConnector::BurstSamplesReceived, this, &CliRunner::OnBurstSamples);
+    connect(connector_, &ECUConnector::BurstGapDetected, this, &CliRunner::OnBurstGap);
+    connect(connector_, &ECUConnector::EcuLogReceived, this, &CliRunner::OnEcuLog);
+    connect(connector_, &ECUConnector::FirmwareProgress, this, &CliRunner::OnFirmwareProgress);
+    connect(connector_, &ECUConnector::FirmwareUploadFinished, this, &CliRunner::OnFirmwareFinished);
+    connect(connector_, &ECUConnector::ControlLatencyMeasured, this, &CliRunner::OnControlLatency);
+}
+
+void CliRunner::Start() {
+    if (!options_.recordPath.isEmpty()) {
+        recordFile_.setFileName(options_.recordPath);
+        if (!recordFile_.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            OnError("Cannot open record file: " + recordFile_.errorString());
+            Finish(2);
+            return;
+        }
+        recordStream_.setDevice(&recordFile_);
+        recordStream_ << "time_ms,kind,values\n";
+    }
+
+    clock_.start();
+    startTime_ = std::chrono::steady_clock::now();
+    connector_->SetCobsFraming(options_.cobs);
+    connector_->Connect(options_.port, options_.baud);
+}
+
+void CliRunner::OnConnectionChanged(bool connected) {
+    if (connected) {
+        RunNext();
+    } else if (!finished_) {
+        Finish(exitCode_ ? exitCode_ : 1);
+    }
+}
+
+void CliRunner::OnError(const QString& message) {
+    fprintf(stderr, "error: %s\n", qPrintable(message));
+    exitCode_ = 1;
+}
+
+void CliRunner::RunNext() {
+    if (options_.commands.isEmpty()) {
+        Finish(exitCode_);
+        return;
+    }
+
+    pendingCommand_ = options_.commands.takeFirst();
+    if (pendingCommand_ == "version") {
+        connector_->GetApiVersion();
+    } else if (pendingCommand_ == "encoders") {
+        connector_->GetAllEncoders();
+    } else if (pendingCommand_ == "imu") {
+        connector_->GetImu();
+    } else if (pendingCommand_ == "stop") {
+        connector_->SetAllMotorsSpeed({0, 0, 0, 0});
+        // set_all_motors_speed has no decoded response, continue right away
+        QTimer::singleShot(0, this, &CliRunner::RunNext);
+        return;
+    } else if (pendingCommand_ == "poll") {
+        connector_->ResetControlLatency();
+        if (!options_.gamepadDevice.isEmpty() && !StartGamepad()) {
+            Finish(2);
+            return;
+        }
+        polling_ = true;
+        if (options_.burstHz > 0) connector_->RequestBurst(options_.burstHz);
+        pollTimer_->start(options_.periodMs);
+        responseTimer_->start(options_.durationMs);
+        OnPollTick();
+        return;
+    } else if (pendingCommand_ == "ping") {
+        // Starts once the API version requested on connect is known
+        if (connector_->ApiVersion() > 0) {
+            StartPingProfile();
+            return;
+        }
+    } else if (pendingCommand_ == "log") {
+        if (connector_->ApiVersion() > 0) {
+            StartLogRead();
+            return;
+        }
+    } else if (pendingCommand_ == "firmware") {
+        if (connector_->ApiVersion() > 0) {
+            StartFirmwareUpload();
+            return;
+        }
+    } else {
+        OnError("Unknown command: " + pendingCommand_);
+        Finish(2);
+        return;
+    }
+    responseTimer_->start(options_.timeoutMs);
+}
+
+void CliRunner::OnApiVersion(int version) {
+    Record("api_version", {QString::number(version)});
+    if (pendingCommand_ == "version") {
+        out_ << "api_version " << version << Qt::endl;
+        responseTimer_->stop();
+        RunNext();
+    } else if (pendingCommand_ == "ping" && !profiler_->IsRunning()) {
+        responseTimer_->stop();
+        StartPingProfile();
+    } else if (pendingCommand_ == "log" && !logReading_) {
+        responseTimer_->stop();
+        StartLogRead();
+    } else if (pendingCommand_ == "firmware" && !firmwareStarted_) {
+        responseTimer_->stop();
+        StartFirmwareUpload();
+    }
+}
+
+void CliRunner::StartPingProfile() {
+    if (!connector_->SupportsPing()) {
+        OnError(QString("ping needs API version %1, ECU reports %2").arg(protocol::kApiPing).arg(connector_->ApiVersion()));
+        Finish(1);
+        return;
+    }
+    profiler_->Start(options_.ping);
+}
+
+void CliRunner::StartLogRead() {
+    if (!connector_->SupportsEcuLog()) {
+        OnError(QString("log needs API version %1, ECU reports %2").arg(protocol::kApiSegmentation).arg(connector_->ApiVersion()));
+        Finish(1);
+        return;
+    }
+    logReading_ = true;
+    logBytes_ = 0;
+    logStart_ = std::chrono::steady_clock::now();
+    RequestLog(0);
+}
+
+void CliRunner::RequestLog(uint32_t offset) {
+    connector_->ReadEcuLog(offset, kLogChunk);
+    // A full chunk takes a while to arrive on a slow line
+    responseTimer_->start(options_.timeoutMs + static_cast<int>(qint64(kLogChunk) * 10 * 1000 / options_.baud));
+}
+
+void CliRunner::OnEcuLog(uint32_t offset, uint32_t total, const QByteArray& text) {
+    if (!logReading_) return;
+    responseTimer_->stop();
+    out_ << QString::fromUtf8(text);
+    logBytes_ += text.size();
+
+    uint32_t next = offset + static_cast<uint32_t>(text.size());
+    if (!text.isEmpty() && next < total) {
+        RequestLog(next);
+        return;
+    }
+
+    logReading_ = false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - logStart_).count();
+    out_ << "ecu_log bytes " << logBytes_ << " ms " << qint64(seconds * 1000)
+         << " throughput_Bps " << qint64(seconds > 0 ? logBytes_ / seconds : 0)
+         << " segment_acks " << connector_->SegmentStats().acks_sent << Qt::endl;
+    Record("ecu_log", {QString::number(logBytes_), QString::number(seconds * 1000, 'f', 0)});
+    RunNext();
+}
+
+void CliRunner::StartFirmwareUpload() {
+    firmwareStarted_ = true;
+    if (!connector_->SupportsFirmwareUpdate()) {
+        OnError(QString("firmware needs API version %1, ECU reports %2").arg(protocol::kApiFirmware).arg(connector_->ApiVersion()));
+        Finish(1);
+        return;
+    }
+    QFile file(options_.firmwarePath);
+    if (options_.firmwarePath.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        OnError("Cannot read firmware image: " + (options_.firmwarePath.isEmpty() ? "no --firmware given" : file.errorString()));
+        Finish(2);
+        return;
+    }
+    QByteArray data = file.readAll();
+    std::vector<uint8_t> image(data.begin(), data.end());
+    firmwareReportedPct_ = 0;
+    firmwareBytes_ = data.size();
+    firmwareStart_ = std::chrono::steady_clock::now();
+    if (!connector_->UploadFirmware(image, options_.firmwareBlockSize)) {
+        OnError(QString("Cannot upload a %1 byte image in blocks of %2").arg(firmwareBytes_).arg(options_.firmwareBlockSize));
+        Finish(2);
+    }
+}
+
+void CliRunner::OnFirmwareProgress(qint64 confirmed, qint64 total) {
+    // One line per 10 percent
+    int pct = total > 0 ? static_cast<int>(confirmed * 100 / total) : 0;
+    if (pct / 10 == firmwareReportedPct_ / 10 && pct != 100) return;
+    firmwareReportedPct_ = pct;
+    out_ << "firmware_progress " << confirmed << " / " << total << " (" << pct << "%)" << Qt::endl;
+}
+
+void CliRunner::OnFirmwareFinished(bool ok, const QString& message) {
+    if (pendingCommand_ != "firmware") return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - firmwareStart_).count();
+    qint64 bytes = firmwareBytes_;
+    double rate = seconds > 0 ? bytes / seconds : 0;
+    out_ << "firmware " << (ok ? "ok" : "failed") << " bytes " << bytes << " ms " << qint64(seconds * 1000)
+         << " throughput_Bps " << qint64(rate)
+         << " line_rate_pct " << QString::number(100 * rate / (options_.baud / 10.0), 'f', 1)
+         << " resent " << connector_->FirmwareBlocksResent() << Qt::endl;
+    Record("firmware", {ok ? "ok" : "failed", QString::number(bytes), QString::number(seconds * 1000, 'f', 0),
+                        QString::number(connector_->FirmwareBlocksResent())});
+    if (!ok) {
+        OnError(message);
+        Finish(1);
+        return;
+    }
+    RunNext();
+}
+
+void CliRunner::OnPingStep(const LinkProfileStep& step) {
+    out_ << "ping size " << step.dataBytes << " rate " << step.rateHz
+         << " sent " << step.sent << " lost " << (step.sent - step.received)
+         << " rtt_us min " << qint64(step.rttMinUs) << " p50 " << qint64(step.rttP50Us)
+         << " p90 " << qint64(step.rttP90Us) << " p99 " << qint64(step.rttP99Us)
+         << " max " << qint64(step.rttMaxUs)
+         << " wire_bytes " << step.wireBytes << " serialise_us " << qint64(step.serialiseUs)
+         << " overhead_us " << qint64(step.overheadUs)
+         << " throughput_Bps " << qint64(step.throughputBps) << Qt::endl;
+    Record("ping", {QString::number(step.dataBytes), QString::number(step.rateHz),
+                    QString::number(step.sent), QString::number(step.received),
+                    QString::number(step.rttMinUs, 'f', 0), QString::number(step.rttP50Us, 'f', 0),
+                    QString::number(step.rttP90Us, 'f', 0), QString::number(step.rttP99Us, 'f', 0),
+                    QString::number(step.rttMaxUs, 'f', 0), QString::number(step.serialiseUs, 'f', 0),
+                    QString::number(step.throughputBps, 'f', 0)});
+}
+
+void CliRunner::OnPingFinished() {
+    // The per-byte cost is the line rate actually achieved, the rest is fixed
+    // per transaction (USB adapter latency, OS scheduling, ECU dispatch)
+    double usPerByte = profiler_->UsPerByte();
+    out_ << "link fixed_us " << qint64(profiler_->FixedOverheadUs())
+         << " us_per_byte " << QString::number(usPerByte, 'f', 2)
+         << " effective_baud " << (usPerByte > 0 ? qint64(10e6 / usPerByte) : 0) << Qt::endl;
+    RunNext();
+}
+
+void CliRunner::OnEncoders(const std::vector<float>& values) {
+    QStringList fields;
+    for (float v : values) fields << QString::number(v);
+    RecordSample("encoders", fields, connector_->SampleTime());
+    if (pendingCommand_ == "encoders") {
+        out_ << "encoders " << fields.join(' ') << Qt::endl;
+        responseTimer_->stop();
+        RunNext();
+    }
+}
+
+void CliRunner::OnImu(const ImuData& data) {
+    QStringList fields;
+    for (float value : data.ToArray()) fields << QString::number(value);
+    RecordSample("imu", fields, connector_->SampleTime());
+    if (pendingCommand_ == "imu") {
+        out_ << "imu " << fields.join(' ') << Qt::endl;
+        responseTimer_->stop();
+        RunNext();
+    }
+}
+
+void CliRunner::OnBurstSamples(const std::vector<BurstSample>& samples) {
+    // Burst rows carry the ECU sample time in microseconds as the first value
+    for (const BurstSample& sample : samples) {
+        QStringList fields{QString::number(sample.ecuTimeUs)};
+        for (float d : sample.deltas) fields << QString::number(d);
+        if (sample.hostTime != std::chrono::steady_clock::time_point{}) {
+            RecordSample("burst", fields, sample.hostTime);
+        } else {
+            Record("burst", fields);
+        }
+    }
+}
+
+void CliRunner::OnBurstGap(uint32_t missedSamples, bool overrun) {
+    Record("burst_gap", {QString::number(missedSamples), overrun ? "overrun" : "lost"});
+}
+
+bool CliRunner::StartGamepad() {
+    try {
+        gamepad_ = std::make_unique<Gamepad>(options_.gamepadDevice.toStdString(), Gamepad::Config());
+    } catch (const std::exception& e) {
+        OnError(QString::fromStdString(e.what()));
+        return false;
+    }
+    out_ << "gamepad " << QString::fromStdString(gamepad_->name()) << Qt::endl;
+    connector_->SetSetpointRate(options_.setpointRateHz, std::chrono::milliseconds(options_.periodMs));
+    connector_->SetAllMotorsSpeed({0, 0, 0, 0});
+    int maxRpm = options_.maxRpm;
+    gamepad_->Start([this, maxRpm](const Gamepad::State& state) {
+        connector_->SubmitSetpoint(MixDifferentialDrive(state.x, state.y, maxRpm), state.time);
+    });
+    return true;
+}
+
+void CliRunner::OnControlLatency(const ControlLatency::Measurement& m) {
+    QStringList fields{QString::number(m.total_us / 1000, 'f', 1), QString::number(m.host_us / 1000, 'f', 1),
+                       QString::number(m.link_us / 1000, 'f', 1), QString::number(m.response_us / 1000, 'f', 1)};
+    out_ << "latency total_ms " << fields[0] << " host_ms " << fields[1] << " link_ms " << fields[2]
+         << " response_ms " << fields[3] << Qt::endl;
+    RecordSample("latency", fields, m.input);
+}
+
+void CliRunner::PrintControlLatency() {
+    ControlLatency::Summary summary = connector_->ControlLatencySummary();
+    if (summary.count == 0) return;
+    out_ << "latency_summary count " << summary.count
+         << " p50_ms " << QString::number(summary.p50_us / 1000, 'f', 1)
+         << " p90_ms " << QString::number(summary.p90_us / 1000, 'f', 1)
+         << " max_ms " << QString::number(summary.max_us / 1000, 'f', 1)
+         << " host_p50_ms " << QString::number(summary.host_p50_us / 1000, 'f', 1)
+         << " link_p50_ms " << QString::number(summary.link_p50_us / 1000, 'f', 1)
+         << " response_p50_ms " << QString::number(summary.response_p50_us / 1000, 'f', 1) << Qt::endl;
+    // Total latency in 10 ms buckets, the last one open-ended
+    constexpr int kBuckets = 20;
+    std::vector<size_t> counts = connector_->ControlLatencyHistogram(10000, kBuckets);
+    for (int i = 0; i < kBuckets; ++i) {
+        if (counts[i] == 0) continue;
+        QString range = i + 1 < kBuckets ? QString("%1-%2").arg(i * 10, 3).arg((i + 1) * 10, 3)
+                                         : QString(">=%1").arg(i * 10, 5);
+        out_ << "latency_ms " << range << ' ' << QString(int(std::min<size_t>(counts[i], 60)), QChar('#'))
+             << ' ' << counts[i] << Qt::endl;
+    }
+}
+
+void CliRunner::OnResponseTimeout() {
+    if (polling_) {
+        // Poll duration elapsed
+        polling_ = false;
+        pollTimer_->stop();
+        if (gamepad_) {
+            gamepad_.reset();
+            SetpointDispatcher::Stats stats = connector_->SetpointStats();
+            out_ << "setpoints sent " << stats.sent << " held " << stats.held
+                 << " coalesced " << stats.coalesced << " keepalives " << stats.keepalives << Qt::endl;
+            connector_->SetSetpointRate(options_.setpointRateHz, std::chrono::milliseconds(0));
+        }
+        connector_->SetAllMotorsSpeed({0, 0, 0, 0});
+        PrintControlLatency();
+        if (options_.burstHz > 0) {
+            connector_->RequestBurst(0);
+            out_ << "burst_lost " << connector_->BurstLostSamples() << Qt::endl;
+        }
+        if (connector_->HasClockSync()) {
+            const ClockSync& sync = connector_->GetClockSync();
+            out_ << "clock_sync offset_us " << qint64(sync.offset_us())
+                 << " drift_ppm " << QString::number(sync.drift_ppm(), 'f', 1)
+                 << " delay_us " << qint64(sync.min_delay_us())
+                 << " jitter_us " << QString::number(sync.jitter_us(), 'f', 0) << Qt::endl;
+        }
+        RunNext();
+        return;
+    }
+    OnError("Timeout waiting for response to " + pendingCommand_);
+    Finish(1);
+}
+
+void CliRunner::OnPollTick() {
+    if (!connector_->IsConnected()) return;
+    // Gamepad setpoints come from its thread and are kept alive by the connector
+    if (!gamepad_) connector_->SetAllMotorsSpeed(options_.speeds);
+    if (connector_->SupportsTelemetry()) {
+        // The status block carries the ECU capture time once the clocks are synchronised
+        uint8_t fields = protocol::kFieldEncoders | protocol::kFieldImu;
+        if (connector_->HasClockSync()) fields |= protocol::kFieldStatus;
+        connector_->GetTelemetry(fields);
+    } else {
+        connector_->GetAllEncoders();
+        connector_->GetImu();
+    }
+}
+
+void CliRunner::Record(const QString& kind, const QStringList& values) {
+    if (!recordFile_.isOpen()) return;
+    recordStream_ << clock_.elapsed() << ',' << kind << ',' << values.join(',') << '\n';
+}
+
+void CliRunner::RecordSample(const QString& kind, const QStringList& values,
+                             std::chrono::steady_clock::time_point captured) {
+    if (!recordFile_.isOpen()) return;
+    auto timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(captured - startTime_).count();
+    recordStream_ << qint64(timeMs) << ',' << kind << ',' << values.join(',') << '\n';
+}
+
+void CliRunner::Finish(int exitCode) {
+    if (finished_) return;
+    finished_ = true;
+    pollTimer_->stop();
+    gamepad_.reset();
+    responseTimer_->stop();
+    if (recordFile_.isOpen()) {
+        recordStream_.flush();
+        recordFile_.close();
+    }
+    connector_->Disconnect();
+    emit Finished(exitCode);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "ECUConnector.h"
+#include "Gamepad.h"
+#include "LinkProfiler.h"
+
+// Runs a scripted sequence of protocol commands without any GUI.
+// Commands: version, encoders, imu, stop, poll, ping, log, firmware.
+class CliRunner : public QObject {
+    Q_OBJECT
+public:
+    struct Options {
+        QString port = "/dev/ttyUSB0";
+        int baud = 115200;
+        int periodMs = 100;
+        int durationMs = 10000;
+        int timeoutMs = 500;
+        int burstHz = 0;
+        bool cobs = false;
+        LinkProfiler::Config ping;
+        QString firmwarePath;
+        int firmwareBlockSize = 4096;
+        std::vector<int> speeds{0, 0, 0, 0};
+        // While polling, drive from this evdev gamepad instead of speeds
+        QString gamepadDevice;
+        int maxRpm = 200;
+        int setpointRateHz = 50;
+        QString recordPath;
+        QStringList commands;
+    };
+
+    explicit CliRunner(const Options& options, QObject *parent = nullptr);
+
+    void Start();
+
+signals:
+    void Finished(int exitCode);
+
+private slots:
+    void OnConnectionChanged(bool connected);
+    void OnError(const QString& message);
+    void OnApiVersion(int version);
+    void OnEncoders(const std::vector<float>& values);
+    void OnImu(const ImuData& data);
+    void OnBurstSamples(const std::vector<BurstSample>& samples);
+    void OnBurstGap(uint32_t missedSamples, bool overrun);
+    void OnResponseTimeout();
+    void OnPollTick();
+    void OnPingStep(const LinkProfileStep& step);
+    void OnPingFinished();
+    void OnEcuLog(uint32_t offset, uint32_t total, const QByteArray& text);
+    void OnFirmwareProgress(qint64 confirmed, qint64 total);
+    void OnFirmwareFinished(bool ok, const QString& message);
+    void OnControlLatency(const ControlLatency::Measurement& measurement);
+
+private:
+    void RunNext();
+    void StartPingProfile();
+    void StartLogRead();
+    void RequestLog(uint32_t offset);
+    void StartFirmwareUpload();
+    bool StartGamepad();
+    void PrintControlLatency();
+    void Finish(int exitCode);
+    void Record(const QString& kind, const QStringList& values);
+    // Rows of decoded samples are stamped with the capture time
+    void RecordSample(const QString& kind, const QStringList& values,
+                      std::chrono::steady_clock::time_point captured);
+
+    Options options_;
+    ECUConnector* connector_;
+    LinkProfiler* profiler_;
+    QTimer* responseTimer_;
+    QTimer* pollTimer_;
+    QElapsedTimer clock_;
+    std::chrono::steady_clock::time_point startTime_;
+
+    QString pendingCommand_;
+    bool polling_ = false;
+    bool logReading_ = false;
+    qint64 logBytes_ = 0;
+    std::chrono::steady_clock::time_point logStart_;
+    bool firmwareStarted_ = false;
+    int firmwareReportedPct_ = 0;
+    qint64 firmwareBytes_ = 0;
+    std::chrono::steady_clock::time_point firmwareStart_;
+    bool finished_ = false;
+    int exitCode_ = 0;
+
+    std::unique_ptr<Gamepad> gamepad_;
+
+    QFile recordFile_;
+    QTextStream recordStream_;
+    QTextStream out_;
+};
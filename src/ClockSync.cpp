@@ -0,0 +1,84 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ClockSync::AddExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+  Exchange e;
+  e.host_us = t1 + (t4 - t1) / 2;
+  // Assumes the request and the response took equally long; the error is at
+  // most half the asymmetry, which is why slow exchanges are filtered
+  e.offset_us = ((t2 - t1) + (t3 - t4)) / 2.0;
+  e.delay_us = std::max<int64_t>(0, (t4 - t1) - (t3 - t2));
+
+  history_.push_back(e);
+  if (history_.size() > kWindow) history_.pop_front();
+  Fit();
+}
+
+void ClockSync::Reset() {
+  history_.clear();
+  ref_host_us_ = 0;
+  offset_us_ = 0;
+  drift_ = 0;
+  min_delay_us_ = 0;
+  jitter_us_ = 0;
+}
+
+int64_t ClockSync::EcuToHost(int64_t ecu_us) const {
+  // Inverse of HostToEcu: ecu = host + offset + drift * (host - ref)
+  double rel = static_cast<double>(ecu_us - ref_host_us_) - offset_us_;
+  return ref_host_us_ + std::llround(rel / (1.0 + drift_));
+}
+
+int64_t ClockSync::HostToEcu(int64_t host_us) const {
+  double rel = static_cast<double>(host_us - ref_host_us_);
+  return host_us + std::llround(offset_us_ + drift_ * rel);
+}
+
+void ClockSync::Fit() {
+  min_delay_us_ = history_.front().delay_us;
+  for (const Exchange& e : history_) min_delay_us_ = std::min(min_delay_us_, e.delay_us);
+
+  // Queueing only ever adds delay, so the fastest exchanges carry the least
+  // asymmetry. Widen the gate until enough of them remain for a line fit.
+  int64_t margin = std::max(kMinDelayMarginUs, min_delay_us_ / 2);
+  size_t wanted = std::min<size_t>(history_.size(), 4);
+  size_t accepted = 0;
+  for (;;) {
+    accepted = 0;
+    for (const Exchange& e : history_) {
+      if (e.delay_us <= min_delay_us_ + margin) ++accepted;
+    }
+    if (accepted >= wanted) break;
+    margin *= 2;
+  }
+
+  ref_host_us_ = history_.back().host_us;
+
+  // Least squares over the accepted exchanges, relative to the newest one
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (const Exchange& e : history_) {
+    if (e.delay_us > min_delay_us_ + margin) continue;
+    double x = static_cast<double>(e.host_us - ref_host_us_);
+    n += 1;
+    sx += x;
+    sy += e.offset_us;
+    sxx += x * x;
+    sxy += x * e.offset_us;
+  }
+  double var = n * sxx - sx * sx;
+  // Drift needs the exchanges to span some time; a single burst of them does not
+  drift_ = var > n * n * 1e12 ? (n * sxy - sx * sy) / var : 0.0;
+  drift_ = std::clamp(drift_, -kMaxDrift, kMaxDrift);
+  offset_us_ = (sy - drift_ * sx) / n;
+
+  double sq = 0;
+  for (const Exchange& e : history_) {
+    if (e.delay_us > min_delay_us_ + margin) continue;
+    double x = static_cast<double>(e.host_us - ref_host_us_);
+    double r = e.offset_us - (offset_us_ + drift_ * x);
+    sq += r * r;
+  }
+  jitter_us_ = std::sqrt(sq / n);
+}
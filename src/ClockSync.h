@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Estimates the ECU clock relative to the host clock from time_sync exchanges
+// (NTP-style four timestamps). Keeps a sliding window of exchanges, discards
+// those delayed by queueing on either side and fits offset and drift to the
+// rest, so the estimate keeps tracking a crystal that runs fast or slow.
+//
+// All times are in microseconds: host times on the host's monotonic clock,
+// ECU times on the ECU clock.
+class ClockSync {
+ public:
+  // t1: host sent the request, t2: ECU received it, t3: ECU sent the
+  // response, t4: host received it
+  void AddExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+  void Reset();
+
+  bool valid() const { return !history_.empty(); }
+  size_t exchanges() const { return history_.size(); }
+
+  int64_t EcuToHost(int64_t ecu_us) const;
+  int64_t HostToEcu(int64_t host_us) const;
+
+  // ECU clock minus host clock at the newest exchange
+  double offset_us() const { return offset_us_; }
+  // How much faster the ECU clock runs, in parts per million
+  double drift_ppm() const { return drift_ * 1e6; }
+  // Shortest round trip in the window, excluding ECU processing
+  int64_t min_delay_us() const { return min_delay_us_; }
+  // RMS deviation of the accepted exchanges from the fit
+  double jitter_us() const { return jitter_us_; }
+
+ private:
+  struct Exchange {
+    int64_t host_us;   // Midpoint of t1 and t4
+    double offset_us;  // Offset measured by this exchange
+    int64_t delay_us;  // Round trip minus ECU processing
+  };
+
+  static constexpr size_t kWindow = 64;
+  // Exchanges slower than the fastest by more than this take part in the fit
+  // only while there are too few fast ones
+  static constexpr int64_t kMinDelayMarginUs = 200;
+  // Plausible crystal tolerance; anything beyond is noise over a short window
+  static constexpr double kMaxDrift = 500e-6;
+
+  void Fit();
+
+  std::deque<Exchange> history_;
+  int64_t ref_host_us_ = 0;  // Fit reference point (newest exchange)
+  double offset_us_ = 0;
+  double drift_ = 0;
+  int64_t min_delay_us_ = 0;
+  double jitter_us_ = 0;
+};
@@ -0,0 +1,87 @@
+#include "CompactCodec.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace compact {
+
+namespace {
+
+// Sensor group of each IMU field: 3 accel, 3 gyro, 3 mag, 4 quaternion
+constexpr int kFieldSensor[kImuFields] = {0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 3};
+
+constexpr int kMaxVarintBytes = 5;
+
+}  // namespace
+
+void EncodeDeltas(const int32_t* deltas, int count, std::vector<uint8_t>& out) {
+  for (int i = 0; i < count; ++i) {
+    // Zigzag keeps small negative deltas small: 0, -1, 1, -2 -> 0, 1, 2, 3
+    uint32_t v = (static_cast<uint32_t>(deltas[i]) << 1) ^
+                 static_cast<uint32_t>(deltas[i] >> 31);
+    while (v >= 0x80) {
+      out.push_back(static_cast<uint8_t>(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+  }
+}
+
+bool DecodeDeltas(const uint8_t*& p, const uint8_t* end, int32_t* deltas,
+                  int count) {
+  const uint8_t* q = p;
+  for (int i = 0; i < count; ++i) {
+    uint32_t v = 0;
+    int shift = 0;
+    for (;;) {
+      if (q == end || shift >= kMaxVarintBytes * 7) return false;
+      uint8_t byte = *q++;
+      // The fifth byte holds only the top 4 bits of a 32-bit value
+      if (shift == 28 && (byte & 0x70)) return false;
+      v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) break;
+    }
+    deltas[i] = static_cast<int32_t>((v >> 1) ^ (~(v & 1) + 1));
+  }
+  p = q;
+  return true;
+}
+
+void EncodeImu(const float* fields, const uint8_t* exponents,
+               std::vector<uint8_t>& out) {
+  out.insert(out.end(), exponents, exponents + kImuSensors);
+  for (int i = 0; i < kImuFields; ++i) {
+    float scaled = std::ldexp(fields[i], exponents[kFieldSensor[i]]);
+    // Saturate instead of wrapping when a value exceeds the range
+    long raw = std::lround(std::clamp(scaled, -32768.0f, 32767.0f));
+    out.push_back(static_cast<uint8_t>(raw & 0xFF));
+    out.push_back(static_cast<uint8_t>((raw >> 8) & 0xFF));
+  }
+}
+
+bool DecodeImu(const uint8_t*& p, const uint8_t* end, float* fields) {
+  if (end - p < static_cast<std::ptrdiff_t>(kImuBlockSize)) return false;
+
+  float sensor_scale[kImuSensors];
+  for (int s = 0; s < kImuSensors; ++s) {
+    if (p[s] > 30) return false;
+    sensor_scale[s] = std::ldexp(1.0f, -p[s]);
+  }
+  const uint8_t* raw = p + kImuSensors;
+
+  // Branch-free fixed-trip-count loops over plain arrays so the compiler can
+  // vectorise the widening and the multiply
+  float scale[kImuFields];
+  for (int i = 0; i < kImuFields; ++i) scale[i] = sensor_scale[kFieldSensor[i]];
+  int16_t values[kImuFields];
+  for (int i = 0; i < kImuFields; ++i) {
+    values[i] = static_cast<int16_t>(raw[2 * i] | (raw[2 * i + 1] << 8));
+  }
+  for (int i = 0; i < kImuFields; ++i) fields[i] = values[i] * scale[i];
+
+  p += kImuBlockSize;
+  return true;
+}
+
+}  // namespace compact
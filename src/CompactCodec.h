@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact get_telemetry blocks (layout 2, see doc/protocol.md). Shared by the
+// connector and the simulator.
+namespace compact {
+
+// Encoder deltas: one zigzag varint per motor
+void EncodeDeltas(const int32_t* deltas, int count, std::vector<uint8_t>& out);
+// Advances p past the block; false if it is truncated or malformed
+bool DecodeDeltas(const uint8_t*& p, const uint8_t* end, int32_t* deltas,
+                  int count);
+
+// IMU: one scale exponent per sensor (accel, gyro, mag, quaternion), then
+// the 13 fields in hardware order as little-endian int16, value = raw * 2^-exp
+constexpr int kImuFields = 13;
+constexpr int kImuSensors = 4;
+constexpr size_t kImuBlockSize = kImuSensors + kImuFields * 2;
+
+// Default exponents: accel +/-128 m/s^2, gyro +/-32 rad/s, mag +/-128 uT,
+// quaternion +/-2
+constexpr uint8_t kDefaultImuExponents[kImuSensors] = {8, 10, 8, 14};
+
+void EncodeImu(const float* fields, const uint8_t* exponents,
+               std::vector<uint8_t>& out);
+bool DecodeImu(const uint8_t*& p, const uint8_t* end, float* fields);
+
+}  // namespace compact
@@ -0,0 +1,130 @@
+#include "ControlLatency.h"
+
+#include <algorithm>
+
+namespace {
+
+int Sign(double v) { return (v > 0) - (v < 0); }
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+  size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+double Micros(ControlLatency::Clock::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+}  // namespace
+
+void ControlLatency::OnSetpoint(const std::vector<int>& speeds,
+                                Clock::time_point input_time) {
+  if (speeds.size() != 4) return;
+  std::array<int, 4> direction{};
+  bool changed = false;
+  for (size_t i = 0; i < 4; ++i) {
+    int sign = Sign(speeds[i]);
+    if (sign != 0 && sign != commanded_[i]) {
+      direction[i] = sign;
+      changed = true;
+    }
+    // A motor being measured no longer commanded that way
+    if (active_ && direction_[i] != 0 && sign != direction_[i]) {
+      active_ = false;
+      ++superseded_;
+    }
+    commanded_[i] = sign;
+  }
+  if (!changed) return;
+  if (active_) ++superseded_;
+  active_ = true;
+  sent_ = false;
+  direction_ = direction;
+  input_ = input_time;
+}
+
+void ControlLatency::OnSent(const std::vector<int>& speeds,
+                            Clock::time_point now) {
+  if (!active_ || sent_ || speeds.size() != 4) return;
+  for (size_t i = 0; i < 4; ++i) {
+    if (direction_[i] != 0 && Sign(speeds[i]) != direction_[i]) return;
+  }
+  sent_ = true;
+  sent_at_ = now;
+}
+
+bool ControlLatency::OnEncoders(const std::vector<float>& deltas,
+                                Clock::time_point captured, double link_us) {
+  if (!active_ || deltas.size() < 4) return false;
+  if (captured - input_ > config_.timeout) {
+    active_ = false;
+    ++timeouts_;
+    return false;
+  }
+  // Motion captured before the setpoint left the host is not a response
+  if (!sent_ || captured <= sent_at_) return false;
+  for (size_t i = 0; i < 4; ++i) {
+    if (direction_[i] != 0 && deltas[i] * direction_[i] < config_.min_ticks) {
+      return false;
+    }
+  }
+
+  Measurement m;
+  m.input = input_;
+  m.host_us = std::max(0.0, Micros(sent_at_ - input_));
+  m.total_us = std::max(m.host_us, Micros(captured - input_));
+  m.link_us = std::min(link_us, m.total_us - m.host_us);
+  m.response_us = m.total_us - m.host_us - m.link_us;
+  measurements_.push_back(m);
+  // A long session must not grow without bound
+  while (measurements_.size() > std::max<size_t>(config_.max_measurements, 1)) {
+    measurements_.pop_front();
+  }
+  ++count_;
+  max_us_ = std::max(max_us_, m.total_us);
+  active_ = false;
+  return true;
+}
+
+void ControlLatency::Reset() {
+  commanded_ = {};
+  active_ = false;
+  measurements_.clear();
+  count_ = 0;
+  max_us_ = 0;
+  superseded_ = 0;
+  timeouts_ = 0;
+}
+
+ControlLatency::Summary ControlLatency::Summarize() const {
+  Summary s;
+  s.count = count_;
+  if (measurements_.empty()) return s;
+  std::vector<double> total, host, link, response;
+  for (const Measurement& m : measurements_) {
+    total.push_back(m.total_us);
+    host.push_back(m.host_us);
+    link.push_back(m.link_us);
+    response.push_back(m.response_us);
+  }
+  s.p50_us = Percentile(total, 0.5);
+  s.p90_us = Percentile(total, 0.9);
+  s.max_us = max_us_;
+  s.host_p50_us = Percentile(host, 0.5);
+  s.link_p50_us = Percentile(link, 0.5);
+  s.response_p50_us = Percentile(response, 0.5);
+  return s;
+}
+
+std::vector<size_t> ControlLatency::Histogram(double bucket_us,
+                                              size_t buckets) const {
+  std::vector<size_t> counts(buckets, 0);
+  if (buckets == 0 || bucket_us <= 0) return counts;
+  for (const Measurement& m : measurements_) {
+    size_t index = static_cast<size_t>(m.total_us / bucket_us);
+    ++counts[std::min(index, buckets - 1)];
+  }
+  return counts;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Input-to-motion latency of teleoperation. An input that commands a motor
+// into a new direction starts a measurement, which ends with the first
+// encoder sample in which every such motor moves that way. Each measurement
+// is split into
+//   host:     input event to the setpoint frame leaving the host
+//   link:     one-way link delay (half the minimum time_sync round trip)
+//   response: the rest, ECU dispatch plus motor and encoder response
+// One measurement runs at a time; a new direction before the response
+// supersedes it.
+//
+// ECUConnector owns it and holds its latency mutex around every call, since
+// inputs arrive on the GUI or gamepad thread, sends on the setpoint
+// dispatcher's thread and encoder samples on the connector's. All times are
+// on the connector's clock: input times as given with the setpoint (the
+// kernel's event time for a gamepad), send times read from its scheduler
+// and capture times mapped from the ECU clock.
+class ControlLatency {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Config {
+    float min_ticks = 1;  // Encoder delta that counts as motion
+    Clock::duration timeout = std::chrono::seconds(2);
+    // Measurements kept for the percentiles and the histogram; older ones
+    // only still count in Summary::count and Summary::max_us
+    size_t max_measurements = 4096;
+  };
+
+  struct Measurement {
+    Clock::time_point input;
+    double host_us = 0;
+    double link_us = 0;
+    double response_us = 0;
+    double total_us = 0;
+  };
+
+  struct Summary {
+    size_t count = 0;  // Since the last reset, including dropped ones
+    double p50_us = 0;
+    double p90_us = 0;
+    double max_us = 0;
+    // Medians of the parts
+    double host_p50_us = 0;
+    double link_p50_us = 0;
+    double response_p50_us = 0;
+  };
+
+  ControlLatency() = default;
+  explicit ControlLatency(const Config& config) : config_(config) {}
+
+  // A setpoint from input that happened at input_time
+  void OnSetpoint(const std::vector<int>& speeds, Clock::time_point input_time);
+  // A setpoint frame handed to the transport
+  void OnSent(const std::vector<int>& speeds, Clock::time_point now);
+  // Encoder deltas captured at captured (host time base); true when this
+  // sample completed a measurement
+  bool OnEncoders(const std::vector<float>& deltas, Clock::time_point captured,
+                  double link_us);
+
+  void Reset();
+
+  // The most recent Config::max_measurements, oldest first
+  const std::deque<Measurement>& measurements() const { return measurements_; }
+  uint64_t superseded() const { return superseded_; }
+  uint64_t timeouts() const { return timeouts_; }
+  Summary Summarize() const;
+  // Counts of total latency in buckets of bucket_us over the kept
+  // measurements; the last bucket also holds everything beyond
+  std::vector<size_t> Histogram(double bucket_us, size_t buckets) const;
+
+ private:
+  Config config_;
+  std::array<int, 4> commanded_{};  // Sign of the last setpoint per motor
+  bool active_ = false;
+  bool sent_ = false;
+  std::array<int, 4> direction_{};  // Motors measured and their direction
+  Clock::time_point input_;
+  Clock::time_point sent_at_;
+  std::deque<Measurement> measurements_;
+  size_t count_ = 0;
+  double max_us_ = 0;
+  uint64_t superseded_ = 0;
+  uint64_t timeouts_ = 0;
+};
@@ -1,6 +1,9 @@
 #include "ControlPanel.h"
 #include "VirtualJoystick.h"
+#include "DriveMixer.h"
 #include "ECUConnector.h"
+#include "Gamepad.h"
+#include "Protocol.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -19,6 +22,11 @@ ControlPanel::ControlPanel(ECUConnector* connector, QWidget *parent)
     // Don't start timer immediately, wait for connection
 }
 
+ControlPanel::~ControlPanel() {
+    // Joins the input thread before the widgets it posts to go away
+    gamepad_.reset();
+}
+
 void ControlPanel::SetupUi() {
     QHBoxLayout* mainLayout = new QHBoxLayout(this);
     
@@ -50,6 +58,16 @@ void ControlPanel::SetupUi() {
     periodLayout->addWidget(periodSpin_);
     connLayout->addLayout(periodLayout);
     
+    QHBoxLayout* rateLayout = new QHBoxLayout();
+    rateLayout->addWidget(new QLabel("Setpoint rate (Hz):"));
+    setpointRateSpin_ = new QSpinBox();
+    setpointRateSpin_->setToolTip("Most setpoints per second sent while the joystick or sliders move");
+    setpointRateSpin_->setRange(5, 500);
+    setpointRateSpin_->setValue(50);
+    connect(setpointRateSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, &ControlPanel::ApplySetpointRate);
+    rateLayout->addWidget(setpointRateSpin_);
+    connLayout->addLayout(rateLayout);
+    
     QHBoxLayout* maxRpmLayout = new QHBoxLayout();
     maxRpmLayout->addWidget(new QLabel("Max RPM:"));
     maxRpmSpin_ = new QSpinBox();
@@ -62,6 +80,36 @@ void ControlPanel::SetupUi() {
     connectButton_ = new QPushButton("Connect");
     connect(connectButton_, &QPushButton::clicked, this, &ControlPanel::OnConnectClicked);
     connLayout->addWidget(connectButton_);
+    
+    QHBoxLayout* udpLayout = new QHBoxLayout();
+    udpExportCheck_ = new QCheckBox("UDP:");
+    udpExportCheck_->setToolTip("Stream decoded telemetry to a UDP endpoint (e.g. PlotJuggler UDP server)");
+    connect(udpExportCheck_, &QCheckBox::toggled, this, &ControlPanel::OnUdpExportToggled);
+    udpLayout->addWidget(udpExportCheck_);
+    udpTargetEdit_ = new QLineEdit("127.0.0.1:9870");
+    udpLayout->addWidget(udpTargetEdit_);
+    udpFormatCombo_ = new QComboBox();
+    udpFormatCombo_->addItems({"JSON", "MessagePack"});
+    udpLayout->addWidget(udpFormatCombo_);
+    connLayout->addLayout(udpLayout);
+    
+    QHBoxLayout* burstLayout = new QHBoxLayout();
+    burstCheck_ = new QCheckBox("Burst (Hz):");
+    burstCheck_->setToolTip("Let the ECU sample the encoders at a high rate and read them in batches (API version 5+)");
+    burstLayout->addWidget(burstCheck_);
+    burstRateSpin_ = new QSpinBox();
+    burstRateSpin_->setRange(100, protocol::kBurstMaxRateHz);
+    burstRateSpin_->setValue(1000);
+    burstRateSpin_->setSingleStep(100);
+    burstLayout->addWidget(burstRateSpin_);
+    connect(burstCheck_, &QCheckBox::toggled, this, &ControlPanel::OnBurstSettingsChanged);
+    connect(burstRateSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, &ControlPanel::OnBurstSettingsChanged);
+    connLayout->addLayout(burstLayout);
+    
+    cobsCheck_ = new QCheckBox("COBS framing");
+    cobsCheck_->setToolTip("Switch the link to COBS framing, which resynchronises after corrupted bytes within one frame (API version 6+)");
+    connect(cobsCheck_, &QCheckBox::toggled, this, &ControlPanel::OnCobsFramingToggled);
+    connLayout->addWidget(cobsCheck_);
     connLayout->addStretch();
     
     mainLayout->addWidget(connGroup);
@@ -107,6 +155,7 @@ void ControlPanel::SetupUi() {
         connect(slider, &QSlider::valueChanged, this, [this, i](int val){
             if (!allSameCheck_->isChecked()) {
                 currentSpeeds_[i] = val;
+                DispatchSpeeds();
             }
         });
         
@@ -130,12 +179,58 @@ void ControlPanel::SetupUi() {
     connect(joystick_, &VirtualJoystick::positionChanged, this, &ControlPanel::OnJoystickPositionChanged);
     gamepadLayout->addWidget(joystick_);
     
+    QHBoxLayout* padLayout = new QHBoxLayout();
+    gamepadCheck_ = new QCheckBox("Gamepad:");
+    gamepadCheck_->setToolTip("Drive with a physical gamepad (left stick), read through evdev on its own thread");
+    connect(gamepadCheck_, &QCheckBox::toggled, this, &ControlPanel::OnGamepadToggled);
+    padLayout->addWidget(gamepadCheck_);
+    gamepadCombo_ = new QComboBox();
+    gamepadCombo_->setEditable(true);
+    for (const std::string& device : Gamepad::FindDevices()) {
+        gamepadCombo_->addItem(QString::fromStdString(device));
+    }
+    if (gamepadCombo_->count() == 0) gamepadCombo_->setEditText("/dev/input/event0");
+    padLayout->addWidget(gamepadCombo_);
+    gamepadLayout->addLayout(padLayout);
+    
+    QHBoxLayout* shapeLayout = new QHBoxLayout();
+    shapeLayout->addWidget(new QLabel("Deadzone:"));
+    deadzoneSpin_ = new QDoubleSpinBox();
+    deadzoneSpin_->setRange(0, 0.5);
+    deadzoneSpin_->setSingleStep(0.01);
+    deadzoneSpin_->setValue(Gamepad::Config().deadzone);
+    shapeLayout->addWidget(deadzoneSpin_);
+    shapeLayout->addWidget(new QLabel("Expo:"));
+    expoSpin_ = new QDoubleSpinBox();
+    expoSpin_->setRange(0, 1);
+    expoSpin_->setSingleStep(0.05);
+    expoSpin_->setValue(Gamepad::Config().expo);
+    shapeLayout->addWidget(expoSpin_);
+    gamepadLayout->addLayout(shapeLayout);
+    
+    latencyLabel_ = new QLabel("Input to motion: -");
+    latencyLabel_->setToolTip("Time from an input that changes a motor's direction to the first encoder sample "
+                              "showing that motion: host / link / ECU and motor response, median in brackets");
+    connect(connector_, &ECUConnector::ControlLatencyMeasured, this, &ControlPanel::OnControlLatency);
+    gamepadLayout->addWidget(latencyLabel_);
+    
     mainLayout->addWidget(gamepadGroup);
     
     // Initialize ranges
     OnMaxRpmChanged(maxRpmSpin_->value());
 }
 
+void ControlPanel::OnControlLatency(const ControlLatency::Measurement& m) {
+    ControlLatency::Summary summary = connector_->ControlLatencySummary();
+    latencyLabel_->setText(QString("Input to motion: %1 ms (%2 / %3 / %4) [p50 %5 ms, n=%6]")
+                               .arg(m.total_us / 1000, 0, 'f', 1)
+                               .arg(m.host_us / 1000, 0, 'f', 1)
+                               .arg(m.link_us / 1000, 0, 'f', 1)
+                               .arg(m.response_us / 1000, 0, 'f', 1)
+                               .arg(summary.p50_us / 1000, 0, 'f', 1)
+                               .arg(qulonglong(summary.count)));
+}
+
 void ControlPanel::OnConnectClicked() {
     if (connector_->IsConnected()) {
         connector_->Disconnect();
@@ -151,6 +246,9 @@ void ControlPanel::OnConnectionChanged(bool connected) {
     
     if (connected) {
         updateTimer_->start(periodSpin_->value());
+        RequestTelemetryStreams(true);
+        ApplySetpointRate();
+        DispatchSpeeds();
     } else {
         updateTimer_->stop();
     }
@@ -159,7 +257,37 @@ void ControlPanel::OnConnectionChanged(bool connected) {
 void ControlPanel::OnPeriodChanged(int val) {
     if (updateTimer_->isActive()) {
         updateTimer_->setInterval(val);
+        RequestTelemetryStreams(true);
     }
+    ApplySetpointRate();
+}
+
+void ControlPanel::ApplySetpointRate() {
+    // The last setpoint is repeated once per period as a keepalive
+    std::chrono::milliseconds keepalive(dispatchEnabled_ ? periodSpin_->value() : 0);
+    connector_->SetSetpointRate(setpointRateSpin_->value(), keepalive);
+}
+
+void ControlPanel::DispatchSpeeds() {
+    // Sent now, or as soon as the setpoint rate allows
+    if (dispatchEnabled_ && connector_->IsConnected()) connector_->SubmitSetpoint(currentSpeeds_);
+}
+
+void ControlPanel::RequestTelemetryStreams(bool enabled) {
+    // Firmware with streaming support pushes encoders and IMU at the poll rate,
+    // so the periodic timer has nothing to poll
+    int rateHz = enabled ? 1000 / periodSpin_->value() : 0;
+    connector_->RequestStreams(protocol::kStreamEncoders | protocol::kStreamImu, rateHz);
+}
+
+void ControlPanel::OnBurstSettingsChanged() {
+    // Applied by the connector now or as soon as the API version is known
+    connector_->RequestBurst(burstCheck_->isChecked() ? burstRateSpin_->value() : 0);
+}
+
+void ControlPanel::OnCobsFramingToggled(bool enabled) {
+    // Negotiated now or as soon as the API version is known
+    connector_->SetCobsFraming(enabled);
 }
 
 void ControlPanel::OnAllMotorsSliderChanged(int value) {
@@ -172,6 +300,7 @@ void ControlPanel::OnAllMotorsSliderChanged(int value) {
         for (int i = 0; i < 4; ++i) {
             currentSpeeds_[i] = value;
         }
+        DispatchSpeeds();
     }
 }
 
@@ -181,9 +310,18 @@ void ControlPanel::OnIndividualMotorSliderChanged(int value) {
 
 void ControlPanel::OnTimerTimeout() {
     if (connector_->IsConnected()) {
-        connector_->SetAllMotorsSpeed(currentSpeeds_);
-        connector_->GetAllEncoders();
-        connector_->GetImu();
+        // Setpoints go out when the input changes, and the connector repeats
+        // the last one as a keepalive. Fall back to polling whenever a stream is unsupported or has stalled
+        uint8_t fields = 0;
+        if (!connector_->IsStreaming(protocol::kStreamEncoders)) fields |= protocol::kFieldEncoders;
+        if (!connector_->IsStreaming(protocol::kStreamImu)) fields |= protocol::kFieldImu;
+        if (fields && connector_->SupportsTelemetry()) {
+            // One request and one snapshot instead of two round trips
+            connector_->GetTelemetry(fields | protocol::kFieldStatus);
+        } else {
+            if (fields & protocol::kFieldEncoders) connector_->GetAllEncoders();
+            if (fields & protocol::kFieldImu) connector_->GetImu();
+        }
     }
 }
 
@@ -203,6 +341,7 @@ int ControlPanel::GetMaxRpm() const {
 }
 
 void ControlPanel::OnMaxRpmChanged(int value) {
+    maxRpm_ = value;
     if (allMotorsSlider_) allMotorsSlider_->setRange(-value, value);
     if (allMotorsSpin_) allMotorsSpin_->setRange(-value, value);
     
@@ -217,22 +356,12 @@ void ControlPanel::OnMaxRpmChanged(int value) {
 }
 
 void ControlPanel::OnJoystickPositionChanged(double x, double y) {
-    // Differential drive: y = forward/back, x = turn
-    // Left motors (M1, M2): -y + x, Right motors (M3, M4): -y - x
-    // (negate y because up on joystick should be forward)
-    int maxRpm = maxRpmSpin_->value();
-    int leftSpeed = static_cast<int>((-y + x) * maxRpm);
-    int rightSpeed = static_cast<int>((-y - x) * maxRpm);
-    
-    // Clamp to range
-    leftSpeed = qBound(-maxRpm, leftSpeed, maxRpm);
-    rightSpeed = qBound(-maxRpm, rightSpeed, maxRpm);
-    
-    // Motors: M1,M2 = left side, M3,M4 = right side
-    currentSpeeds_[0] = leftSpeed;  // M1
-    currentSpeeds_[1] = leftSpeed;  // M2
-    currentSpeeds_[2] = rightSpeed; // M3
-    currentSpeeds_[3] = rightSpeed; // M4
+    ShowSpeeds(MixDifferentialDrive(x, y, maxRpmSpin_->value()));
+    DispatchSpeeds();
+}
+
+void ControlPanel::ShowSpeeds(const std::vector<int>& speeds) {
+    currentSpeeds_ = speeds;
     
     // Update sliders to reflect
     allSameCheck_->setChecked(false); // Individual mode
@@ -241,16 +370,73 @@ void ControlPanel::OnJoystickPositionChanged(double x, double y) {
         motorSliders_[i]->setValue(currentSpeeds_[i]);
         motorSliders_[i]->blockSignals(false);
     }
+}
+
+void ControlPanel::OnGamepadToggled(bool enabled) {
+    gamepadCombo_->setEnabled(!enabled);
+    deadzoneSpin_->setEnabled(!enabled);
+    expoSpin_->setEnabled(!enabled);
+    gamepad_.reset();
+    if (!enabled) return;
     
-    // Motor speeds will be sent by the periodic timer
+    Gamepad::Config config;
+    config.deadzone = deadzoneSpin_->value();
+    config.expo = expoSpin_->value();
+    try {
+        gamepad_ = std::make_unique<Gamepad>(gamepadCombo_->currentText().toStdString(), config);
+    } catch (const std::exception& e) {
+        qWarning() << "Gamepad:" << e.what();
+        gamepadCheck_->setChecked(false);
+        return;
+    }
+    gamepad_->Start([this](const Gamepad::State& state) {
+        // Input thread: the setpoint goes to the ECU without waiting for
+        // the GUI event loop, which only updates the display
+        if (!dispatchEnabled_) return;
+        connector_->SubmitSetpoint(MixDifferentialDrive(state.x, state.y, maxRpm_), state.time);
+        QMetaObject::invokeMethod(this, [this, state] {
+            OnGamepadState(state.x, state.y, state.connected);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ControlPanel::OnGamepadState(double x, double y, bool connected) {
+    if (!gamepad_) return;
+    ShowSpeeds(MixDifferentialDrive(x, y, maxRpmSpin_->value()));
+    if (!connected) {
+        qWarning() << "Gamepad disconnected";
+        gamepadCheck_->setChecked(false);
+    }
+}
+
+void ControlPanel::OnUdpExportToggled(bool enabled) {
+    udpTargetEdit_->setEnabled(!enabled);
+    udpFormatCombo_->setEnabled(!enabled);
+    
+    if (!enabled) {
+        connector_->StopTelemetryExport();
+        return;
+    }
+    
+    QString host = udpTargetEdit_->text().section(':', 0, 0);
+    int port = udpTargetEdit_->text().section(':', 1, 1).toInt();
+    bool msgPack = udpFormatCombo_->currentIndex() == 1;
+    if (port <= 0 || !connector_->StartTelemetryExport(host, port, msgPack)) {
+        udpExportCheck_->setChecked(false);
+    }
 }
 
 void ControlPanel::SetPeriodicUpdatesEnabled(bool enabled) {
+    dispatchEnabled_ = enabled;
+    ApplySetpointRate();
     if (enabled) {
         if (connector_->IsConnected()) {
             updateTimer_->start(periodSpin_->value());
+            RequestTelemetryStreams(true);
+            DispatchSpeeds();
         }
     } else {
         updateTimer_->stop();
+        RequestTelemetryStreams(false);
     }
 }
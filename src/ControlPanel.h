@@ -7,9 +7,15 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QLabel>
 #include <QTimer>
+#include <atomic>
+#include <memory>
 #include <vector>
+#include "ControlLatency.h"
 
+class Gamepad;
 class VirtualJoystick;
 class ECUConnector;
 
@@ -17,6 +23,7 @@ class ControlPanel : public QWidget {
     Q_OBJECT
 public:
     explicit ControlPanel(ECUConnector* connector, QWidget *parent = nullptr);
+    ~ControlPanel();
     int GetMaxRpm() const;
     void SetPeriodicUpdatesEnabled(bool enabled);
 
@@ -31,11 +38,21 @@ private slots:
     void OnTimerTimeout();
     void OnStopClicked();
     void OnPeriodChanged(int val);
+    void ApplySetpointRate();
     void OnMaxRpmChanged(int value);
     void OnJoystickPositionChanged(double x, double y);
+    void OnUdpExportToggled(bool enabled);
+    void OnBurstSettingsChanged();
+    void OnCobsFramingToggled(bool enabled);
+    void OnGamepadToggled(bool enabled);
+    void OnControlLatency(const ControlLatency::Measurement& measurement);
 
 private:
     void SetupUi();
+    void RequestTelemetryStreams(bool enabled);
+    void ShowSpeeds(const std::vector<int>& speeds);
+    void DispatchSpeeds();
+    void OnGamepadState(double x, double y, bool connected);
     
     ECUConnector* connector_;
     
@@ -43,8 +60,15 @@ private:
     QLineEdit* portEdit_;
     QComboBox* baudCombo_;
     QSpinBox* periodSpin_;
+    QSpinBox* setpointRateSpin_;
     QSpinBox* maxRpmSpin_;
     QPushButton* connectButton_;
+    QCheckBox* udpExportCheck_;
+    QLineEdit* udpTargetEdit_;
+    QComboBox* udpFormatCombo_;
+    QCheckBox* burstCheck_;
+    QSpinBox* burstRateSpin_;
+    QCheckBox* cobsCheck_;
     
     // Sliders UI
     QSlider* allMotorsSlider_;
@@ -54,6 +78,16 @@ private:
     std::vector<QSpinBox*> motorSpins_;
     
     VirtualJoystick* joystick_;
+    QCheckBox* gamepadCheck_;
+    QComboBox* gamepadCombo_;
+    QDoubleSpinBox* deadzoneSpin_;
+    QDoubleSpinBox* expoSpin_;
+    QLabel* latencyLabel_;
+    // Read on the gamepad thread, which must not touch the widgets
+    std::atomic<int> maxRpm_{200};
+    // Off while another tab (the protocol tester) drives the motors
+    std::atomic<bool> dispatchEnabled_{true};
+    std::unique_ptr<Gamepad> gamepad_;
     
     QTimer* updateTimer_;
     std::vector<int> currentSpeeds_;
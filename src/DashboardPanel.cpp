@@ -2,21 +2,40 @@
 #include "ECUConnector.h"
 #include "ProtocolTestPanel.h"
 #include "IMUPanel.h"
+#include "FleetPanel.h"
+#include "RenderGate.h"
+#include "StartupProfile.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGroupBox>
 #include <QLabel>
-#include <QDateTime>
 #include <QDebug>
+#include <QShowEvent>
+#include <QTimer>
 #include <QWheelEvent>
+#include <chrono>
 #include <limits>
 
+namespace {
+
+// Chart times are milliseconds on the connector's clock, which a test
+// harness may run in virtual time
+qint64 ToMillis(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+}  // namespace
+
 ZoomableChartView::ZoomableChartView(QWidget *parent)
-    : QChartView(parent) {
+    : TimedChartView(nullptr, parent) {
 }
 
 void ZoomableChartView::wheelEvent(QWheelEvent *event) {
+    if (chart()->series().isEmpty()) {
+        QChartView::wheelEvent(event);
+        return;
+    }
     if (event->modifiers() & Qt::ControlModifier) {
         // Ctrl + wheel: Zoom in/out on X-axis only
         qreal factor = (event->angleDelta().y() > 0) ? 0.8 : 1.25; // Zoom in/out
@@ -43,12 +62,35 @@ void ZoomableChartView::wheelEvent(QWheelEvent *event) {
     }
 }
 
+LazyTab::LazyTab(std::function<QWidget*()> factory, QWidget *parent)
+    : QWidget(parent), factory_(std::move(factory)) {
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+}
+
+QWidget* LazyTab::EnsureContent() {
+    if (!content_) {
+        content_ = factory_();
+        layout()->addWidget(content_);
+    }
+    return content_;
+}
+
+void LazyTab::showEvent(QShowEvent *event) {
+    EnsureContent();
+    QWidget::showEvent(event);
+}
+
 DashboardPanel::DashboardPanel(ECUConnector* connector, QWidget *parent)
     : QWidget(parent), connector_(connector), lastEncoders_(4, 0), startTime_(0) {
+    renderQuality_ = new RenderQuality(this);
+    connect(renderQuality_, &RenderQuality::LevelChanged, this, &DashboardPanel::ApplyRenderQuality);
     SetupUi();
-    SetupChart();
+    memoryRegistration_ = MemoryBudget::Global().Register("PID chart", this);
     
     connect(connector_, &ECUConnector::EncoderValuesUpdated, this, &DashboardPanel::OnEncoderDataReceived);
+    connect(connector_, &ECUConnector::BurstSamplesReceived, this, &DashboardPanel::OnBurstSamplesReceived);
+    connect(connector_, &ECUConnector::ConnectionChanged, this, [this](bool) { burst_ = BurstPlot(); });
     connect(connector_, &ECUConnector::SpeedSet, this, [this](const std::vector<int>& speeds){
         // Update setpoint series
         // We need to sync this with the timer or just add a point at current time
@@ -56,16 +98,18 @@ DashboardPanel::DashboardPanel(ECUConnector* connector, QWidget *parent)
         // But chart X axis is time.
         // Let's just update the setpoint value for the next plot update?
         // Or better, add a point now.
-        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        qint64 now = ToMillis(connector_->Executor()->Now());
         if (startTime_ == 0) startTime_ = now;
         qreal t = (now - startTime_);
+        bool visible = IsChartDrawn();
+        bool draw = visible && setpointSeq_++ % stride_ == 0;
         
         for (int i = 0; i < 4; ++i) {
             if (i < speeds.size()) {
-                setpointSeries_[i]->append(t, speeds[i]);
-                if (setpointSeries_[i]->count() > 1000) setpointSeries_[i]->remove(0);
+                AddPoint(setpointPoints_[i], setpointSeries_[i], t, speeds[i], draw);
             }
         }
+        if (!visible) chartStale_ = true;
     });
 }
 
@@ -79,6 +123,8 @@ void DashboardPanel::SetupUi() {
     // Chart Tab
     chartTab_ = new QWidget();
     QVBoxLayout* chartLayout = new QVBoxLayout(chartTab_);
+    chartGate_ = new RenderGate(chartTab_);
+    connect(chartGate_, &RenderGate::Opened, this, &DashboardPanel::RenderChart);
     
     // Controls
     QGroupBox* controlsGroup = new QGroupBox("Chart Controls");
@@ -110,6 +156,7 @@ void DashboardPanel::SetupUi() {
     
     // Chart View
     chartView_ = new ZoomableChartView();
+    chartView_->SetRenderQuality(renderQuality_);
     chartView_->setRenderHint(QPainter::Antialiasing);
     chartView_->setRubberBand(QChartView::HorizontalRubberBand); // Enable horizontal scrolling
     connect(chartView_, &ZoomableChartView::viewChanged, this, &DashboardPanel::SyncScrollBarToAxis);
@@ -126,17 +173,40 @@ void DashboardPanel::SetupUi() {
     tabWidget_->addTab(chartTab_, "PID Regulator");
     
     // Protocol Test Tab
-    protocolTab_ = new ProtocolTestPanel(connector_);
-    tabWidget_->addTab(protocolTab_, "Protocol Tester");
+    tabWidget_->addTab(new LazyTab([this] {
+        StartupProfile::Phase phase("protocol tester tab");
+        protocolTab_ = new ProtocolTestPanel(connector_);
+        return protocolTab_;
+    }), "Protocol Tester");
 
     // IMU Tab
-    imuTab_ = new IMUPanel(connector_);
-    tabWidget_->addTab(imuTab_, "IMU");
+    tabWidget_->addTab(new LazyTab([this] {
+        StartupProfile::Phase phase("IMU tab");
+        imuTab_ = new IMUPanel(connector_, renderQuality_);
+        return imuTab_;
+    }), "IMU");
+
+    // Fleet Tab: its own connections, plus a tile fed from connector_
+    tabWidget_->addTab(new LazyTab([this] {
+        StartupProfile::Phase phase("fleet tab");
+        return new FleetPanel(connector_);
+    }), "Fleet");
     
     connect(tabWidget_, &QTabWidget::currentChanged, this, &DashboardPanel::OnTabChanged);
 }
 
+void DashboardPanel::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    // Let the window paint first, then build the chart
+    if (!chart_) {
+        QTimer::singleShot(0, this, [this] {
+            if (!chart_) SetupChart();
+        });
+    }
+}
+
 void DashboardPanel::SetupChart() {
+    StartupProfile::Phase phase("PID chart");
     chart_ = new QChart();
     chart_->setTitle("Motor Speed Control - Setpoint vs Actual RPM");
     
@@ -147,7 +217,7 @@ void DashboardPanel::SetupChart() {
     
     axisY_ = new QValueAxis();
     axisY_->setTitleText("RPM");
-    axisY_->setRange(-100, 100);
+    axisY_->setRange(-maxRpm_, maxRpm_);
     chart_->addAxis(axisY_, Qt::AlignLeft);
     
     QColor colors[] = {Qt::red, Qt::blue, Qt::green, QColor("orange")};
@@ -176,13 +246,119 @@ void DashboardPanel::SetupChart() {
     }
     
     chartView_->setChart(chart_);
+    OnMotorSelectionChanged();
+    if (!autoScrollCheck_->isChecked()) OnAutoScrollChanged(Qt::Unchecked);
+    // Plot what arrived before the chart existed
+    chartStale_ = true;
+    ApplyRenderQuality(renderQuality_->level());
+    RenderChart();
+}
+
+void DashboardPanel::ApplyRenderQuality(int level) {
+    if (!chart_) return;
+    if (!autoScrollCheck_->isChecked()) {
+        chart_->setAnimationOptions(level >= RenderQuality::NoAnimations ? QChart::NoAnimation
+                                                                         : QChart::SeriesAnimations);
+    }
+    chartView_->setRenderHint(QPainter::Antialiasing, level < RenderQuality::NoAntialiasing);
+    int stride = level >= RenderQuality::Decimated ? 2 : 1;
+    if (stride != stride_) {
+        stride_ = stride;
+        chartStale_ = true;
+        RenderChart();
+    }
+}
+
+bool DashboardPanel::IsChartDrawn() const {
+    return chart_ && chartGate_->IsOpen();
+}
+
+void DashboardPanel::AddPoint(QList<QPointF>& points, QLineSeries* series, qreal t, qreal value, bool draw) {
+    points.append(QPointF(t, value));
+    if (points.size() > maxPoints_) points.removeFirst();
+    if (!draw) return;
+    series->append(t, value);
+    if (series->count() > maxPoints_ / stride_) series->remove(0);
+}
+
+QList<QPointF> DashboardPanel::Decimate(const QList<QPointF>& points) const {
+    if (stride_ == 1) return points;
+    QList<QPointF> drawn;
+    drawn.reserve(points.size() / stride_ + 1);
+    for (qsizetype i = 0; i < points.size(); i += stride_) drawn.append(points[i]);
+    return drawn;
+}
+
+void DashboardPanel::RenderChart() {
+    if (!chartStale_ || !IsChartDrawn()) return;
+    chartStale_ = false;
+    qreal t = 0;
+    for (int i = 0; i < 4; ++i) {
+        setpointSeries_[i]->replace(Decimate(setpointPoints_[i]));
+        currentSeries_[i]->replace(Decimate(currentPoints_[i]));
+        if (!currentPoints_[i].isEmpty()) t = qMax(t, currentPoints_[i].last().x());
+    }
+    ScrollTo(t);
+}
+
+size_t DashboardPanel::MemoryUsage() const {
+    size_t points = 0;
+    for (int i = 0; i < 4; ++i) {
+        points += setpointPoints_[i].size() + currentPoints_[i].size();
+        if (chart_) points += setpointSeries_[i]->count() + currentSeries_[i]->count();
+    }
+    return points * sizeof(QPointF);
+}
+
+size_t DashboardPanel::Shed(size_t) {
+    if (maxPoints_ <= MIN_POINTS) return 0;
+    size_t before = MemoryUsage();
+    // Points dropped from the store that lost the most
+    qsizetype removed = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (QList<QPointF>* points : {&setpointPoints_[i], &currentPoints_[i]}) {
+            qsizetype older = points->size() / 2;
+            qsizetype dropped = older / 2;
+            if (dropped == 0) continue;
+            QList<QPointF> thinned;
+            thinned.reserve(points->size() - dropped);
+            for (qsizetype j = 0; j < older; j += 2) thinned.append(points->at(j));
+            thinned.append(points->mid(older));
+            *points = std::move(thinned);
+            removed = qMax(removed, dropped);
+        }
+    }
+    if (removed == 0) return 0;
+    maxPoints_ = qMax<int>(MIN_POINTS, maxPoints_ - int(removed));
+    chartStale_ = true;
+    RenderChart();
+    return before - qMin(before, MemoryUsage());
+}
+
+void DashboardPanel::ScrollTo(qreal t) {
+    if (autoScrollCheck_->isChecked()) {
+        if (t > 10000) {
+            axisX_->setRange(t - 10000, t);
+        }
+    } else {
+        // In manual mode, don't auto-update the axis range
+        // Just update the scroll bar to reflect new data availability
+        UpdateScrollBar();
+    }
 }
 
 void DashboardPanel::OnEncoderDataReceived(const std::vector<float>& encoders) {
-    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    // Burst samples carry the same motion at a higher rate and exact timing
+    if (connector_->IsBurstActive()) return;
+
+    // Use the capture time, so link jitter does not show up in the RPM
+    qint64 now = ToMillis(connector_->SampleTime());
     if (startTime_ == 0) startTime_ = now;
     
     qreal t = (now - startTime_);
+    // Hidden or minimised: the points are only stored, the chart is redrawn when shown
+    bool visible = IsChartDrawn();
+    bool draw = visible && encoderSeq_++ % stride_ == 0;
     
     for (int i = 0; i < 4; ++i) {
         if (i >= encoders.size()) break;
@@ -210,8 +386,7 @@ void DashboardPanel::OnEncoderDataReceived(const std::vector<float>& encoders) {
             motorData_[i].accumulatedTicks = 0;
             motorData_[i].lastTime = now;
             
-            currentSeries_[i]->append(t, rpm);
-            if (currentSeries_[i]->count() > 1000) currentSeries_[i]->remove(0);
+            AddPoint(currentPoints_[i], currentSeries_[i], t, rpm, draw);
         }
         
         // Also add a point for setpoint to keep lines in sync visually
@@ -222,29 +397,67 @@ void DashboardPanel::OnEncoderDataReceived(const std::vector<float>& encoders) {
              // Or always? If we don't add current point, chart might lag?
              // Let's add setpoint point only when we update RPM to keep X axis synced
              if (dt >= 20) {
-                 setpointSeries_[i]->append(t, speeds[i]);
-                 if (setpointSeries_[i]->count() > 1000) setpointSeries_[i]->remove(0);
+                 AddPoint(setpointPoints_[i], setpointSeries_[i], t, speeds[i], draw);
              }
         }
     }
     
-    if (autoScrollCheck_->isChecked()) {
-        if (t > 10000) {
-            axisX_->setRange(t - 10000, t);
+    if (!visible) {
+        chartStale_ = true;
+        return;
+    }
+    ScrollTo(t);
+}
+
+void DashboardPanel::OnBurstSamplesReceived(const std::vector<BurstSample>& samples) {
+    if (samples.empty()) return;
+    qint64 now = ToMillis(connector_->Executor()->Now());
+    if (startTime_ == 0) startTime_ = now;
+
+    // Place the ECU timeline on the chart axis once, at the newest sample
+    if (!burst_.anchored) {
+        burst_.offsetMs = (now - startTime_) - samples.back().ecuTimeUs / 1000.0;
+        burst_.windowStartUs = samples.front().ecuTimeUs;
+        burst_.anchored = true;
+    }
+
+    // Plot one RPM point per window; the timing comes from the ECU clock
+    qreal t = 0;
+    bool visible = IsChartDrawn();
+    std::vector<int> speeds = connector_->GetCurrentSpeeds();
+    for (const BurstSample& sample : samples) {
+        for (int i = 0; i < 4; ++i) burst_.ticks[i] += sample.deltas[i];
+        uint64_t dtUs = sample.ecuTimeUs - burst_.windowStartUs;
+        if (dtUs < BURST_WINDOW_US) continue;
+
+        t = burst_.offsetMs + sample.ecuTimeUs / 1000.0;
+        bool draw = visible && burstSeq_++ % stride_ == 0;
+        for (int i = 0; i < 4; ++i) {
+            float rpm = (burst_.ticks[i] / ticksSpin_->value()) * (60e6f / dtUs);
+            burst_.ticks[i] = 0;
+            AddPoint(currentPoints_[i], currentSeries_[i], t, rpm, draw);
+            if (i < static_cast<int>(speeds.size())) {
+                AddPoint(setpointPoints_[i], setpointSeries_[i], t, speeds[i], draw);
+            }
         }
-    } else {
-        // In manual mode, don't auto-update the axis range
-        // Just update the scroll bar to reflect new data availability
-        UpdateScrollBar();
+        burst_.windowStartUs = sample.ecuTimeUs;
+    }
+
+    if (t <= 0) return;
+    if (!visible) {
+        chartStale_ = true;
+        return;
     }
+    ScrollTo(t);
 }
 
 void DashboardPanel::UpdateScrollBar() {
+    if (!chart_) return;
     // Calculate the total time range
     qreal maxTime = 0;
     for (int i = 0; i < 4; ++i) {
-        if (!currentSeries_[i]->points().isEmpty()) {
-            QPointF lastPoint = currentSeries_[i]->points().last();
+        if (!currentPoints_[i].isEmpty()) {
+            QPointF lastPoint = currentPoints_[i].last();
             maxTime = qMax(maxTime, lastPoint.x());
         }
     }
@@ -258,14 +471,14 @@ void DashboardPanel::UpdateScrollBar() {
 }
 
 void DashboardPanel::SyncScrollBarToAxis() {
-    if (autoScrollCheck_->isChecked()) return; // Don't sync in auto-scroll mode
+    if (!chart_ || autoScrollCheck_->isChecked()) return; // Don't sync in auto-scroll mode
     
     // Sync scroll bar position to match current axis range
     qreal minTime = std::numeric_limits<qreal>::max();
     qreal maxTime = 0;
     for (int i = 0; i < 4; ++i) {
-        if (!currentSeries_[i]->points().isEmpty()) {
-            const auto& points = currentSeries_[i]->points();
+        if (!currentPoints_[i].isEmpty()) {
+            const auto& points = currentPoints_[i];
             for (const QPointF& point : points) {
                 minTime = qMin(minTime, point.x());
                 maxTime = qMax(maxTime, point.x());
@@ -291,6 +504,7 @@ void DashboardPanel::SyncScrollBarToAxis() {
 }
 
 void DashboardPanel::OnMotorSelectionChanged() {
+    if (!chart_) return;
     for (int i = 0; i < 4; ++i) {
         bool visible = motorChecks_[i]->isChecked();
         setpointSeries_[i]->setVisible(visible);
@@ -299,12 +513,15 @@ void DashboardPanel::OnMotorSelectionChanged() {
 }
 
 void DashboardPanel::OnAutoScrollChanged(int state) {
+    if (!chart_) return;
     if (state == Qt::Checked) {
         chart_->setAnimationOptions(QChart::NoAnimation); // Performance
         chartView_->setRubberBand(QChartView::NoRubberBand); // Disable manual scrolling when auto-scroll is on
         chartScrollBar_->hide(); // Hide scroll bar in auto-scroll mode
     } else {
-        chart_->setAnimationOptions(QChart::SeriesAnimations); // Re-enable animations
+        // Re-enable animations, unless painting is over its time budget
+        chart_->setAnimationOptions(renderQuality_->level() >= RenderQuality::NoAnimations
+                                        ? QChart::NoAnimation : QChart::SeriesAnimations);
         chartView_->setRubberBand(QChartView::HorizontalRubberBand); // Enable manual horizontal scrolling
         
         // When switching to manual mode, keep the current view
@@ -319,14 +536,14 @@ void DashboardPanel::OnTicksChanged(int val) {
 }
 
 void DashboardPanel::OnScrollBarChanged(int value) {
-    if (autoScrollCheck_->isChecked()) return; // Don't interfere with auto-scroll
+    if (!chart_ || autoScrollCheck_->isChecked()) return; // Don't interfere with auto-scroll
     
     // Calculate the total time range
     qreal minTime = std::numeric_limits<qreal>::max();
     qreal maxTime = 0;
     for (int i = 0; i < 4; ++i) {
-        if (!currentSeries_[i]->points().isEmpty()) {
-            const auto& points = currentSeries_[i]->points();
+        if (!currentPoints_[i].isEmpty()) {
+            const auto& points = currentPoints_[i];
             for (const QPointF& point : points) {
                 minTime = qMin(minTime, point.x());
                 maxTime = qMax(maxTime, point.x());
@@ -351,6 +568,7 @@ void DashboardPanel::OnScrollBarChanged(int value) {
 }
 
 void DashboardPanel::SetMaxRpm(int value) {
+    maxRpm_ = value;
     if (axisY_) {
         axisY_->setRange(-value, value);
     }
@@ -359,6 +577,7 @@ void DashboardPanel::SetMaxRpm(int value) {
 void DashboardPanel::OnTabChanged(int index) {
     // Check if Protocol Tester tab is selected (index 1)
     bool isProtocolTester = (index == 1);
-    protocolTab_->SetLoggingEnabled(isProtocolTester);
+    if (auto* lazy = qobject_cast<LazyTab*>(tabWidget_->widget(index))) lazy->EnsureContent();
+    if (protocolTab_) protocolTab_->SetLoggingEnabled(isProtocolTester);
     emit ProtocolTesterTabActivated(isProtocolTester);
 }
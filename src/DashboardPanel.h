@@ -8,13 +8,18 @@
 #include <QSpinBox>
 #include <QTabWidget>
 #include <QScrollBar>
+#include <functional>
 #include <vector>
+#include "MemoryBudget.h"
+#include "RenderQuality.h"
 
 class ECUConnector;
+struct BurstSample;
 class ProtocolTestPanel;
 class IMUPanel;
+class RenderGate;
 
-class ZoomableChartView : public QChartView {
+class ZoomableChartView : public TimedChartView {
     Q_OBJECT
 public:
     explicit ZoomableChartView(QWidget *parent = nullptr);
@@ -26,7 +31,25 @@ protected:
     void wheelEvent(QWheelEvent *event) override;
 };
 
-class DashboardPanel : public QWidget {
+// Tab page whose content is built by factory the first time it is shown,
+// so that start-up does not pay for tabs that are never opened
+class LazyTab : public QWidget {
+    Q_OBJECT
+public:
+    explicit LazyTab(std::function<QWidget*()> factory, QWidget *parent = nullptr);
+
+    QWidget* content() const { return content_; }
+    QWidget* EnsureContent();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private:
+    std::function<QWidget*()> factory_;
+    QWidget* content_ = nullptr;
+};
+
+class DashboardPanel : public QWidget, private MemoryBudget::Consumer {
     Q_OBJECT
 
 public:
@@ -38,39 +61,73 @@ public slots:
 signals:
     void ProtocolTesterTabActivated(bool activated);
 
+protected:
+    void showEvent(QShowEvent *event) override;
+
 private slots:
     void OnEncoderDataReceived(const std::vector<float>& encoders);
+    void OnBurstSamplesReceived(const std::vector<BurstSample>& samples);
     void OnMotorSelectionChanged();
     void OnAutoScrollChanged(int state);
     void OnTicksChanged(int val);
     void OnScrollBarChanged(int value);
     void OnTabChanged(int index);
+    // Redraws the stored points in one pass after the chart was hidden
+    void RenderChart();
+    void ApplyRenderQuality(int level);
 
 private:
     void SetupUi();
     void SetupChart();
+    bool IsChartDrawn() const;
+    // Stores a point, and draws it too when draw is set
+    void AddPoint(QList<QPointF>& points, QLineSeries* series, qreal t, qreal value, bool draw);
+    void ScrollTo(qreal t);
+    QList<QPointF> Decimate(const QList<QPointF>& points) const;
     void UpdateScrollBar();
     void SyncScrollBarToAxis();
+    // Under memory pressure the older half of the history is thinned to
+    // every other point and the store cap drops by the points removed
+    size_t MemoryUsage() const override;
+    size_t Shed(size_t bytes) override;
 
     ECUConnector* connector_;
     
     QTabWidget* tabWidget_;
     QWidget* chartTab_;
-    ProtocolTestPanel* protocolTab_;
-    IMUPanel* imuTab_;
+    // Built on first activation of their tab
+    ProtocolTestPanel* protocolTab_ = nullptr;
+    IMUPanel* imuTab_ = nullptr;
     
     QCheckBox* motorChecks_[4];
     QCheckBox* autoScrollCheck_;
     QSpinBox* ticksSpin_;
     
-    QChart* chart_;
+    // The chart and its series are created after the first frame is shown;
+    // until then data is not plotted
+    QChart* chart_ = nullptr;
     ZoomableChartView* chartView_;
     QScrollBar* chartScrollBar_;
-    QValueAxis* axisX_;
-    QValueAxis* axisY_;
+    QValueAxis* axisX_ = nullptr;
+    QValueAxis* axisY_ = nullptr;
+    int maxRpm_ = 100;
     
-    QLineSeries* setpointSeries_[4];
-    QLineSeries* currentSeries_[4];
+    QLineSeries* setpointSeries_[4] = {};
+    QLineSeries* currentSeries_[4] = {};
+    // The points of the series, kept up to date while the chart is not drawn
+    QList<QPointF> setpointPoints_[4];
+    QList<QPointF> currentPoints_[4];
+    RenderGate* chartGate_;
+    bool chartStale_ = false;
+    RenderQuality* renderQuality_;
+    // Draw every stride_-th sample; more than 1 when quality is reduced.
+    // Each source counts on its own so one cannot starve the others.
+    int stride_ = 1;
+    uint64_t setpointSeq_ = 0;
+    uint64_t encoderSeq_ = 0;
+    uint64_t burstSeq_ = 0;
+    // Points kept per store, lowered by Shed()
+    int maxPoints_ = MAX_POINTS;
     
     std::vector<float> lastEncoders_;
     qint64 startTime_;
@@ -83,5 +140,19 @@ private:
     };
     MotorData motorData_[4];
     
+    // Burst samples are aggregated into fixed windows of ECU time
+    struct BurstPlot {
+        bool anchored = false;
+        qreal offsetMs = 0;
+        uint64_t windowStartUs = 0;
+        float ticks[4] = {};
+    };
+    BurstPlot burst_;
+    
     static constexpr int TICKS_PER_REV_DEFAULT = 1328;
+    static constexpr int MAX_POINTS = 1000;
+    static constexpr int MIN_POINTS = 250;
+    static constexpr uint64_t BURST_WINDOW_US = 10000;
+
+    MemoryBudget::Registration memoryRegistration_;
 };
@@ -0,0 +1,11 @@
+#include "DriveMixer.h"
+
+#include <algorithm>
+
+std::vector<int> MixDifferentialDrive(double x, double y, int max_rpm) {
+  // Left motors: -y + x, right motors: -y - x (negate y because up on the
+  // stick should be forward)
+  int left = std::clamp(static_cast<int>((-y + x) * max_rpm), -max_rpm, max_rpm);
+  int right = std::clamp(static_cast<int>((-y - x) * max_rpm), -max_rpm, max_rpm);
+  return {left, left, right, right};
+}
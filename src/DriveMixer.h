@@ -0,0 +1,8 @@
+#pragma once
+
+#include <vector>
+
+// Differential drive: y is forward/back (negative forward, as on a stick),
+// x is turn. Returns the speeds of M1..M4 in RPM: M1 and M2 are the left
+// side, M3 and M4 the right side, each clamped to +-max_rpm.
+std::vector<int> MixDifferentialDrive(double x, double y, int max_rpm);
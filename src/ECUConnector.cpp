@@ -1,19 +1,48 @@
 #include "ECUConnector.h"
+#include "CompactCodec.h"
 #include <QDebug>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 
-ECUConnector::ECUConnector(QObject *parent) : QObject(parent) {
-    pollTimer_ = new QTimer(this);
-    connect(pollTimer_, &QTimer::timeout, this, &ECUConnector::ProcessIncomingData);
+ECUConnector::ECUConnector(QObject *parent) : ECUConnector(nullptr, parent) {
+}
+
+ECUConnector::ECUConnector(Scheduler *scheduler, QObject *parent) : QObject(parent) {
+    executor_ = scheduler ? new AsyncExecutor(scheduler, this) : new AsyncExecutor(this);
+    pollTimer_ = std::make_unique<RepeatingTimer>(executor_, [this]() { ProcessIncomingData(); });
+    burstTimer_ = std::make_unique<RepeatingTimer>(executor_, [this]() { RequestBurstRead(); });
+    syncTimer_ = std::make_unique<RepeatingTimer>(executor_, [this]() { SendTimeSync(); });
+    firmwareTimer_ = std::make_unique<RepeatingTimer>(executor_, [this]() { PollFirmwareUpload(); });
+    setpoints_ = std::make_unique<SetpointDispatcher>(
+        [this](const std::vector<int>& speeds) { SendSetpoint(speeds); });
+    SetSetpointRate(SetpointDispatcher::Config().max_rate_hz, std::chrono::milliseconds(0));
 }
 
 ECUConnector::~ECUConnector() {
+    StopTelemetryExport();
     Disconnect();
 }
 
-void ECUConnector::Connect(const QString &port, int baud) {
+void ECUConnector::Connect(const QString &port, int baud, IoReactor *reactor) {
+    std::unique_ptr<SerialTransport> transport;
     try {
-        transport_ = std::make_unique<SerialTransport>(port.toStdString(), baud);
+        transport = std::make_unique<SerialTransport>(port.toStdString(), baud);
+    } catch (const std::exception &e) {
+        emit ErrorOccurred(QString::fromStdString(e.what()));
+        emit ConnectionChanged(false);
+        return;
+    }
+    port_ = port;
+    Connect(std::move(transport), baud, reactor);
+}
+
+void ECUConnector::Connect(std::unique_ptr<SerialTransport> transport, int baud, IoReactor *reactor) {
+    try {
+        {
+            std::lock_guard<std::mutex> lock(setpointMutex_);
+            transport_ = std::move(transport);
+        }
         transport_->SetLogCallback([this](const std::vector<uint8_t>& data, bool isTx) {
             if (isTx) {
                 emit RawDataSent(data);
@@ -21,21 +50,56 @@ void ECUConnector::Connect(const QString &port, int baud) {
                 emit RawDataReceived(data);
             }
         });
-        transport_->Start();
-        pollTimer_->start(10); // Poll every 10ms
+        if (reactor) {
+            transport_->Start(reactor);
+        } else {
+            transport_->Start();
+        }
+        setpoints_->Start();
+        pollTimer_->Start(std::chrono::milliseconds(10));
+        apiVersion_ = 0;
+        baud_ = baud;
+        for (auto &state : streamState_) state = StreamState();
+        burst_ = BurstState();
+        clockSync_.Reset();
+        syncPending_ = false;
         emit ConnectionChanged(true);
+        // Capabilities (e.g. streaming) depend on the firmware's API version
+        GetApiVersion();
     } catch (const std::exception &e) {
+        port_.clear();
         emit ErrorOccurred(QString::fromStdString(e.what()));
         emit ConnectionChanged(false);
     }
 }
 
 void ECUConnector::Disconnect() {
+    FailAllPending("Disconnected");
+    CancelFirmwareUpload();
+    if (transport_ && requestedStreams_ && apiVersion_ >= protocol::kApiStreaming) {
+        transport_->Send({protocol::kSubscribe, 0, 0, 0});
+    }
+    if (transport_ && burst_.active) {
+        transport_->Send({protocol::kBurst, protocol::kBurstStop});
+    }
+    // The ECU switches back on receiving the request, so the acknowledgement
+    // is not waited for; transport_->Stop() below still writes it out
+    if (UsesCobsFraming()) {
+        transport_->SendFramingSwitch({protocol::kSetFraming, protocol::kFramingLegacy},
+                                      SerialTransport::Framing::kLegacy);
+    }
+    burst_.active = false;
+    burstTimer_->Stop();
+    syncTimer_->Stop();
+    // Before transport_ goes away; its thread may be sending a keepalive
+    setpoints_->Stop();
     if (transport_) {
+        std::lock_guard<std::mutex> lock(setpointMutex_);
         transport_->Stop();
         transport_.reset();
     }
-    pollTimer_->stop();
+    port_.clear();
+    pollTimer_->Stop();
     emit ConnectionChanged(false);
 }
 
@@ -43,11 +107,410 @@ bool ECUConnector::IsConnected() const {
     return transport_ && transport_->IsConnected();
 }
 
+void ECUConnector::RequestStreams(uint8_t streams, int rateHz) {
+    requestedStreams_ = rateHz > 0 ? streams : 0;
+    streamRateHz_ = rateHz;
+    ApplyStreams();
+}
+
+void ECUConnector::ApplyStreams() {
+    if (!IsConnected() || apiVersion_ < protocol::kApiStreaming) return;
+
+    // Command ID 0x07, Stream mask, Rate in Hz (2 bytes)
+    uint16_t rate = static_cast<uint16_t>(requestedStreams_ ? streamRateHz_ : 0);
+    std::vector<uint8_t> data;
+    data.push_back(protocol::kSubscribe);
+    data.push_back(requestedStreams_);
+    data.push_back((rate >> 8) & 0xFF);
+    data.push_back(rate & 0xFF);
+    transport_->Send(data);
+}
+
+bool ECUConnector::IsStreaming(uint8_t stream) const {
+    if (!(requestedStreams_ & stream)) return false;
+    const StreamState &state = streamState_[stream == protocol::kStreamEncoders ? 0 : 1];
+    if (!state.seen) return false;
+
+    // Treat the stream as lost after three missed periods (at least 300 ms)
+    auto staleAfter = std::chrono::milliseconds(std::max(300, 3000 / std::max(1, streamRateHz_)));
+    return executor_->Now() - state.lastRx < staleAfter;
+}
+
+void ECUConnector::HandleStreamFrame(const std::vector<uint8_t>& payload) {
+    // Payload: StreamID (1) + Sequence (1) + same fields as the polled response
+    bool isEncoders = payload[0] == protocol::kEncoderStream;
+    size_t fieldsSize = isEncoders ? protocol::kEncoderPayloadSize : protocol::kImuPayloadSize;
+    if (payload.size() < 2 + fieldsSize) return;
+
+    StreamState &state = streamState_[isEncoders ? 0 : 1];
+    uint8_t seq = payload[1];
+    if (state.seen && seq != state.nextSeq) {
+        int missed = static_cast<uint8_t>(seq - state.nextSeq);
+        state.gaps += missed;
+        emit StreamGapDetected(isEncoders ? protocol::kStreamEncoders : protocol::kStreamImu, missed);
+    }
+    state.seen = true;
+    state.nextSeq = seq + 1;
+    state.lastRx = executor_->Now();
+    if (payload.size() >= 2 + fieldsSize + protocol::kStreamTimestampSize && clockSync_.valid()) {
+        const uint8_t *ts = &payload[2 + fieldsSize];
+        uint32_t timeUs = (uint32_t(ts[0]) << 24) | (ts[1] << 16) | (ts[2] << 8) | ts[3];
+        sampleTime_ = EcuToHostTime(UnwrapEcuTime(timeUs, sampleTime_));
+    }
+
+    if (isEncoders) {
+        std::vector<float> values;
+        ReadEncoders(&payload[2], values);
+        emit EncoderValuesUpdated(values);
+        ExportSample(TelemetrySample::Kind::kEncoders, values.data(), 4);
+        TrackMotion(values.data(), sampleTime_);
+    } else {
+        ImuData data;
+        ReadImu(&payload[2], data);
+        emit ImuDataReceived(data);
+        ExportSample(TelemetrySample::Kind::kImu, data.ToArray().data(), 13);
+    }
+}
+
+void ECUConnector::SetCobsFraming(bool enabled) {
+    cobsFraming_ = enabled;
+    ApplyFraming();
+}
+
+bool ECUConnector::UsesCobsFraming() const {
+    return transport_ && transport_->tx_framing() == SerialTransport::Framing::kCobs;
+}
+
+void ECUConnector::ApplyFraming() {
+    if (!IsConnected() || apiVersion_ < protocol::kApiCobs) return;
+    if (cobsFraming_ == UsesCobsFraming()) return;
+
+    transport_->SendFramingSwitch(
+        {protocol::kSetFraming, cobsFraming_ ? protocol::kFramingCobs : protocol::kFramingLegacy},
+        cobsFraming_ ? SerialTransport::Framing::kCobs : SerialTransport::Framing::kLegacy);
+}
+
+void ECUConnector::RequestBurst(int rateHz) {
+    if (rateHz > 0 && rateHz < protocol::kBurstMinRateHz) {
+        emit ErrorOccurred(QString("Burst rate %1 Hz is below the minimum of %2 Hz")
+                               .arg(rateHz).arg(protocol::kBurstMinRateHz));
+        return;
+    }
+    burstRateHz_ = std::clamp(rateHz, 0, protocol::kBurstMaxRateHz);
+    ApplyBurst();
+}
+
+void ECUConnector::ApplyBurst() {
+    if (!IsConnected() || apiVersion_ < protocol::kApiBurst) return;
+
+    if (burstRateHz_ == 0) {
+        if (burst_.active) transport_->Send({protocol::kBurst, protocol::kBurstStop});
+        burst_.active = false;
+        burstTimer_->Stop();
+        return;
+    }
+    // Command ID 0x09, Start, Rate in Hz (2 bytes); reads begin on the ack
+    uint16_t rate = static_cast<uint16_t>(burstRateHz_);
+    std::vector<uint8_t> data;
+    data.push_back(protocol::kBurst);
+    data.push_back(protocol::kBurstStart);
+    data.push_back((rate >> 8) & 0xFF);
+    data.push_back(rate & 0xFF);
+    transport_->Send(data);
+}
+
+void ECUConnector::RequestBurstRead() {
+    if (!IsConnected() || !burst_.active) return;
+
+    // One read in flight; a response lost on the wire is retried after 250 ms
+    auto now = executor_->Now();
+    if (burst_.readPending && now - burst_.readSent < std::chrono::milliseconds(250)) return;
+    burst_.readPending = true;
+    burst_.readSent = now;
+    transport_->Send({protocol::kBurst, protocol::kBurstRead, protocol::kBurstMaxSamples});
+}
+
+void ECUConnector::HandleBurstResponse(const std::vector<uint8_t>& payload) {
+    if (payload.size() < 3) return;
+    uint8_t op = payload[1];
+
+    if (op == protocol::kBurstStart) {
+        if (payload[2] != 0) {
+            emit ErrorOccurred(QString("ECU rejected burst sampling at %1 Hz").arg(burstRateHz_));
+            return;
+        }
+        uint64_t lost = burst_.lost;
+        burst_ = BurstState();
+        burst_.lost = lost;
+        burst_.active = burstRateHz_ > 0;
+        // Read about twice per full batch so the ECU buffer never fills up
+        int batchMs = protocol::kBurstMaxSamples * 1000 / std::max(1, burstRateHz_);
+        burstTimer_->Start(std::chrono::milliseconds(std::clamp(batchMs / 2, 5, 100)));
+        return;
+    }
+    if (op != protocol::kBurstRead) return;
+
+    burst_.readPending = false;
+    BurstBatch batch;
+    if (!burst_.active || !DecodeBurst(payload, batch)) return;
+
+    bool overrun = batch.flags & protocol::kBurstOverrun;
+    size_t skip = 0;
+    if (burst_.haveIndex) {
+        int32_t diff = static_cast<int32_t>(batch.firstIndex - burst_.nextIndex);
+        if (diff > 0) {
+            burst_.lost += diff;
+            emit BurstGapDetected(static_cast<uint32_t>(diff), overrun);
+        } else if (diff < 0) {
+            // Already delivered (e.g. a retried read); drop the overlap
+            skip = std::min<size_t>(batch.samples.size(), static_cast<size_t>(-static_cast<int64_t>(diff)));
+        } else if (overrun) {
+            emit BurstGapDetected(0, true);
+        }
+    } else if (overrun) {
+        emit BurstGapDetected(0, true);
+    }
+    uint32_t endIndex = batch.firstIndex + static_cast<uint32_t>(batch.samples.size());
+    if (!burst_.haveIndex || static_cast<int32_t>(endIndex - burst_.nextIndex) > 0) {
+        burst_.nextIndex = endIndex;
+    }
+    burst_.haveIndex = true;
+
+    if (batch.samples.size() > skip) {
+        // The ECU clock is 32-bit microseconds and wraps about every 71 minutes
+        if (batch.firstTimeUs < burst_.lastTimeUs) burst_.timeBase += uint64_t(1) << 32;
+        burst_.lastTimeUs = batch.firstTimeUs;
+
+        std::vector<BurstSample> samples;
+        samples.reserve(batch.samples.size() - skip);
+        uint64_t firstTime = burst_.timeBase + batch.firstTimeUs;
+        for (size_t i = skip; i < batch.samples.size(); ++i) {
+            BurstSample sample;
+            sample.ecuTimeUs = firstTime + i * batch.periodUs;
+            if (clockSync_.valid()) {
+                sample.hostTime = EcuToHostTime(UnwrapEcuTime(
+                    static_cast<uint32_t>(sample.ecuTimeUs), sampleTime_));
+            }
+            for (int m = 0; m < 4; ++m) sample.deltas[m] = batch.samples[i][m];
+            samples.push_back(sample);
+        }
+        emit BurstSamplesReceived(samples);
+        // Burst samples have a host time only once the clocks are synchronised
+        if (clockSync_.valid()) {
+            for (const BurstSample &sample : samples) TrackMotion(sample.deltas, sample.hostTime);
+        }
+    }
+
+    // A full batch means more samples are waiting in the ECU
+    if (batch.samples.size() == protocol::kBurstMaxSamples) RequestBurstRead();
+}
+
+namespace {
+
+int64_t HostMicros(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+uint32_t ReadUint32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint64_t ReadUint64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+}  // namespace
+
+void ECUConnector::Ping(uint16_t seq, const std::vector<uint8_t>& data, int replyBytes) {
+    if (!IsConnected() || !SupportsPing()) return;
+
+    // Command ID 0x0C, Sequence (2 bytes), Reply length, Data
+    size_t length = std::min<size_t>(data.size(), protocol::kPingMaxData);
+    std::vector<uint8_t> request;
+    request.reserve(protocol::kPingRequestHeaderSize + length);
+    request.push_back(protocol::kPing);
+    request.push_back((seq >> 8) & 0xFF);
+    request.push_back(seq & 0xFF);
+    request.push_back(static_cast<uint8_t>(std::clamp(replyBytes, 0, protocol::kPingMaxData)));
+    request.insert(request.end(), data.begin(), data.begin() + length);
+    transport_->Send(request);
+}
+
+void ECUConnector::ReadEcuLog(uint32_t offset, int maxLength) {
+    if (!IsConnected() || !SupportsEcuLog()) return;
+
+    // Command ID 0x0F, Offset (4 bytes), Max length (2 bytes)
+    uint16_t length = static_cast<uint16_t>(std::clamp(maxLength, 0, 0xFFFF));
+    transport_->Send({protocol::kReadLog,
+                      static_cast<uint8_t>(offset >> 24), static_cast<uint8_t>(offset >> 16),
+                      static_cast<uint8_t>(offset >> 8), static_cast<uint8_t>(offset),
+                      static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)});
+}
+
+Segmenter::Stats ECUConnector::SegmentStats() {
+    return transport_ ? transport_->segment_stats() : Segmenter::Stats();
+}
+
+bool ECUConnector::UploadFirmware(const std::vector<uint8_t>& image, int blockSize) {
+    if (!IsConnected() || !SupportsFirmwareUpdate() || IsFirmwareUploading() || blockSize <= 0) {
+        return false;
+    }
+
+    FirmwareUpload::Config config;
+    config.block_size = static_cast<size_t>(blockSize);
+    config.timeout = FirmwareUpload::TimeoutFor(config.block_size, baud_);
+    auto upload = std::make_unique<FirmwareUpload>(config);
+    FirmwareUpload::Frames frames;
+    if (!upload->Start(image, executor_->Now(), frames)) return false;
+    firmware_ = std::move(upload);
+    SendFirmwareFrames(frames);
+    firmwareTimer_->Start(std::chrono::milliseconds(20));
+    emit FirmwareProgress(0, static_cast<qint64>(image.size()));
+    return true;
+}
+
+void ECUConnector::CancelFirmwareUpload() {
+    if (!IsFirmwareUploading()) return;
+    FirmwareUpload::Frames frames;
+    firmware_->Abort(frames);
+    if (IsConnected()) SendFirmwareFrames(frames);
+    firmwareTimer_->Stop();
+    emit FirmwareUploadFinished(false, "Firmware upload cancelled");
+}
+
+void ECUConnector::PollFirmwareUpload() {
+    if (!IsFirmwareUploading()) {
+        firmwareTimer_->Stop();
+        return;
+    }
+    FirmwareUpload::Frames frames;
+    firmware_->Poll(executor_->Now(), frames);
+    SendFirmwareFrames(frames);
+    if (firmware_->state() == FirmwareUpload::State::kFailed) {
+        firmwareTimer_->Stop();
+        emit FirmwareUploadFinished(false, QString::fromStdString(firmware_->error()));
+    }
+}
+
+void ECUConnector::HandleFirmwareResponse(const std::vector<uint8_t>& payload) {
+    if (!IsFirmwareUploading()) return;
+    size_t confirmed = firmware_->bytes_confirmed();
+    FirmwareUpload::Frames frames;
+    firmware_->OnResponse(payload, executor_->Now(), frames);
+    SendFirmwareFrames(frames);
+
+    if (firmware_->bytes_confirmed() != confirmed) {
+        emit FirmwareProgress(static_cast<qint64>(firmware_->bytes_confirmed()),
+                              static_cast<qint64>(firmware_->image_size()));
+    }
+    if (firmware_->state() == FirmwareUpload::State::kDone) {
+        firmwareTimer_->Stop();
+        emit FirmwareUploadFinished(true, "Firmware verified");
+    } else if (firmware_->state() == FirmwareUpload::State::kFailed) {
+        firmwareTimer_->Stop();
+        emit FirmwareUploadFinished(false, QString::fromStdString(firmware_->error()));
+    }
+}
+
+void ECUConnector::SendFirmwareFrames(FirmwareUpload::Frames& frames) {
+    // Blocks larger than a frame are segmented by the transport
+    for (auto &frame : frames) transport_->Send(std::move(frame));
+    frames.clear();
+}
+
+void ECUConnector::ApplyClockSync() {
+    if (!IsConnected() || apiVersion_ < protocol::kApiTimeSync) return;
+    SendTimeSync();
+    syncTimer_->Start(std::chrono::milliseconds(200));
+}
+
+void ECUConnector::SendTimeSync() {
+    if (!IsConnected()) return;
+    // A response that never came is simply replaced by the next exchange
+    syncPending_ = true;
+    syncSent_ = executor_->Now();
+    transport_->Send({protocol::kTimeSync, ++syncSeq_});
+}
+
+void ECUConnector::HandleTimeSync(const std::vector<uint8_t>& payload,
+                                  std::chrono::steady_clock::time_point rxTime) {
+    if (!syncPending_ || payload.size() < protocol::kTimeSyncResponseSize || payload[1] != syncSeq_) return;
+    syncPending_ = false;
+
+    clockSync_.AddExchange(HostMicros(syncSent_), static_cast<int64_t>(ReadUint64(&payload[2])),
+                           static_cast<int64_t>(ReadUint64(&payload[10])), HostMicros(rxTime));
+    // Exchange quickly until the filter has a few samples, then keep tracking
+    // drift at a low rate
+    if (clockSync_.exchanges() >= 8 && syncTimer_->interval() != std::chrono::seconds(1)) {
+        syncTimer_->Start(std::chrono::seconds(1));
+    }
+    emit ClockSyncUpdated();
+}
+
+std::chrono::steady_clock::time_point ECUConnector::EcuToHostTime(uint64_t ecuTimeUs) const {
+    return std::chrono::steady_clock::time_point(
+        std::chrono::microseconds(clockSync_.EcuToHost(static_cast<int64_t>(ecuTimeUs))));
+}
+
+uint64_t ECUConnector::UnwrapEcuTime(uint32_t lowUs, std::chrono::steady_clock::time_point rxTime) const {
+    int64_t expected = clockSync_.HostToEcu(HostMicros(rxTime));
+    return static_cast<uint64_t>(expected + static_cast<int32_t>(lowUs - static_cast<uint32_t>(expected)));
+}
+
+void ECUConnector::SetSampleTime(std::chrono::steady_clock::time_point rxTime) {
+    // Without an ECU timestamp the sample was taken about one link delay
+    // before it arrived
+    sampleTime_ = rxTime;
+    if (clockSync_.valid()) sampleTime_ -= std::chrono::microseconds(clockSync_.min_delay_us() / 2);
+}
+
+bool ECUConnector::StartTelemetryExport(const QString &host, int port, bool msgPack) {
+    StopTelemetryExport();
+    try {
+        exporter_ = std::make_unique<TelemetryExporter>(
+            host.toStdString(), static_cast<uint16_t>(port),
+            msgPack ? TelemetryExporter::Format::kMsgPack : TelemetryExporter::Format::kJson);
+        exporter_->Start();
+        return true;
+    } catch (const std::exception &e) {
+        exporter_.reset();
+        emit ErrorOccurred(QString::fromStdString(e.what()));
+        return false;
+    }
+}
+
+void ECUConnector::StopTelemetryExport() {
+    if (exporter_) {
+        exporter_->Stop();
+        exporter_.reset();
+    }
+}
+
+void ECUConnector::ExportSample(TelemetrySample::Kind kind, const float* values, int count) {
+    if (!exporter_) return;
+
+    TelemetrySample sample;
+    sample.kind = kind;
+    // Wall-clock time of the capture, not of the export
+    auto age = executor_->Now() - sampleTime_;
+    sample.timestamp = std::chrono::duration<double>(
+        (std::chrono::system_clock::now() - age).time_since_epoch()).count();
+    std::memcpy(sample.values, values, count * sizeof(float));
+    exporter_->Push(sample);
+}
+
 void ECUConnector::SetMotorSpeed(int motorId, int speed) {
     if (!IsConnected() || motorId < 0 || motorId > 3) return;
     
-    currentSpeeds_[motorId] = speed;
-    emit SpeedSet(currentSpeeds_);
+    std::vector<int> speeds;
+    {
+        std::lock_guard<std::mutex> lock(setpointMutex_);
+        currentSpeeds_[motorId] = speed;
+        speeds = currentSpeeds_;
+    }
+    emit SpeedSet(speeds);
 
     // Command ID 0x02, MotorID, Speed (4 bytes)
     std::vector<uint8_t> data;
@@ -65,23 +528,96 @@ void ECUConnector::SetMotorSpeed(int motorId, int speed) {
 
 void ECUConnector::SetAllMotorsSpeed(const std::vector<int>& speeds) {
     if (!IsConnected() || speeds.size() != 4) return;
-    
-    currentSpeeds_ = speeds;
-    emit SpeedSet(currentSpeeds_);
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex_);
+        latency_.OnSetpoint(speeds, executor_->Now());
+    }
+    setpoints_->SendNow(speeds);
+}
 
-    // Command ID 0x03, Speed1, Speed2, Speed3, Speed4
-    std::vector<uint8_t> data;
-    data.push_back(0x03);
-    
-    for (int speed : speeds) {
-        int32_t speedVal = speed * 100;
-        data.push_back((speedVal >> 24) & 0xFF);
-        data.push_back((speedVal >> 16) & 0xFF);
-        data.push_back((speedVal >> 8) & 0xFF);
-        data.push_back(speedVal & 0xFF);
+void ECUConnector::SubmitSetpoint(const std::vector<int>& speeds,
+                                  std::chrono::steady_clock::time_point inputTime) {
+    if (speeds.size() != 4) return;
+    if (inputTime == std::chrono::steady_clock::time_point()) inputTime = executor_->Now();
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex_);
+        latency_.OnSetpoint(speeds, inputTime);
     }
-    
-    transport_->Send(data);
+    setpoints_->Submit(speeds);
+}
+
+void ECUConnector::SetSetpointRate(int maxRateHz, std::chrono::milliseconds keepalive) {
+    SetpointDispatcher::Config config;
+    config.max_rate_hz = maxRateHz;
+    config.keepalive = keepalive;
+    setpoints_->SetConfig(config);
+}
+
+void ECUConnector::SendSetpoint(const std::vector<int>& speeds) {
+    {
+        std::lock_guard<std::mutex> lock(setpointMutex_);
+        if (!transport_ || !transport_->IsConnected()) return;
+        currentSpeeds_ = speeds;
+
+        // Command ID 0x03, Speed1, Speed2, Speed3, Speed4
+        std::vector<uint8_t> data;
+        data.push_back(0x03);
+        
+        for (int speed : speeds) {
+            int32_t speedVal = speed * 100;
+            data.push_back((speedVal >> 24) & 0xFF);
+            data.push_back((speedVal >> 16) & 0xFF);
+            data.push_back((speedVal >> 8) & 0xFF);
+            data.push_back(speedVal & 0xFF);
+        }
+        // SerialTransport::Send is thread-safe
+        transport_->Send(data);
+    }
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex_);
+        latency_.OnSent(speeds, executor_->Now());
+    }
+    // Always queued: this may run on the dispatcher or an input thread, and
+    // receivers must not re-enter the dispatcher
+    QMetaObject::invokeMethod(this, [this, speeds] { emit SpeedSet(speeds); }, Qt::QueuedConnection);
+}
+
+std::vector<int> ECUConnector::GetCurrentSpeeds() const {
+    std::lock_guard<std::mutex> lock(setpointMutex_);
+    return currentSpeeds_;
+}
+
+ControlLatency::Summary ECUConnector::ControlLatencySummary() const {
+    std::lock_guard<std::mutex> lock(latencyMutex_);
+    return latency_.Summarize();
+}
+
+std::vector<ControlLatency::Measurement> ECUConnector::ControlLatencyMeasurements() const {
+    std::lock_guard<std::mutex> lock(latencyMutex_);
+    const auto &measurements = latency_.measurements();
+    return {measurements.begin(), measurements.end()};
+}
+
+std::vector<size_t> ECUConnector::ControlLatencyHistogram(double bucketUs, size_t buckets) const {
+    std::lock_guard<std::mutex> lock(latencyMutex_);
+    return latency_.Histogram(bucketUs, buckets);
+}
+
+void ECUConnector::ResetControlLatency() {
+    std::lock_guard<std::mutex> lock(latencyMutex_);
+    latency_.Reset();
+}
+
+void ECUConnector::TrackMotion(const float *deltas, std::chrono::steady_clock::time_point captured) {
+    // The link share is only known once time_sync has measured the round trip
+    double linkUs = clockSync_.valid() ? clockSync_.min_delay_us() / 2.0 : 0;
+    ControlLatency::Measurement measurement;
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex_);
+        if (!latency_.OnEncoders(std::vector<float>(deltas, deltas + 4), captured, linkUs)) return;
+        measurement = latency_.measurements().back();
+    }
+    emit ControlLatencyMeasured(measurement);
 }
 
 void ECUConnector::GetAllEncoders() {
@@ -119,70 +655,342 @@ void ECUConnector::GetImu() {
     transport_->Send(data);
 }
 
+void ECUConnector::GetTelemetry(uint8_t fields) {
+    if (!IsConnected() || !SupportsTelemetry()) return;
+    // Command ID 0x08, Layout version, Field mask
+    std::vector<uint8_t> data;
+    data.push_back(protocol::kGetTelemetry);
+    data.push_back(protocol::kTelemetryLayout);
+    data.push_back(TelemetryRequestFields(fields));
+    transport_->Send(data);
+}
+
+uint8_t ECUConnector::TelemetryRequestFields(uint8_t fields) const {
+    if (!UsesCompactTelemetry()) return fields;
+    uint8_t wire = fields & protocol::kFieldStatus;
+    if (fields & protocol::kFieldEncoders) wire |= protocol::kFieldEncodersCompact;
+    if (fields & protocol::kFieldImu) wire |= protocol::kFieldImuCompact;
+    return wire;
+}
+
+bool ECUConnector::DecodeApiVersion(const std::vector<uint8_t>& payload, int& version) {
+    if (payload.size() < 2) return false;
+    version = payload[1];
+    return true;
+}
+
+bool ECUConnector::DecodeEncoder(const std::vector<uint8_t>& payload, float& value) {
+    // Payload: CmdID (1) + EncoderValue (4 bytes)
+    if (payload.size() < 5) return false;
+    int32_t val = (payload[1] << 24) | (payload[2] << 16) | 
+                  (payload[3] << 8) | payload[4];
+    value = static_cast<float>(val);
+    return true;
+}
+
+void ECUConnector::ReadEncoders(const uint8_t* p, std::vector<float>& values) {
+    values.clear();
+    for (int i = 0; i < 4; ++i) {
+        int offset = i * 4;
+        int32_t val = (p[offset] << 24) | (p[offset+1] << 16) | 
+                      (p[offset+2] << 8) | p[offset+3];
+        values.push_back(static_cast<float>(val));
+    }
+}
+
+void ECUConnector::ReadImu(const uint8_t* p, ImuData& data) {
+    float fields[13];
+    for (int i = 0; i < 13; ++i) {
+        int offset = i * 4;
+        uint32_t val = (static_cast<uint32_t>(p[offset+3]) << 24) |
+                       (static_cast<uint32_t>(p[offset+2]) << 16) |
+                       (static_cast<uint32_t>(p[offset+1]) << 8) |
+                       (static_cast<uint32_t>(p[offset]));
+        std::memcpy(&fields[i], &val, 4);
+    }
+    ImuFromFields(fields, data);
+}
+
+void ECUConnector::ImuFromFields(const float* f, ImuData& data) {
+    data.accel_x = f[1]; // Swapped: mapping hardware Y to application X
+    data.accel_y = f[0]; // Swapped: mapping hardware X to application Y
+    data.accel_z = f[2];
+    data.gyro_x = f[4];  // Swapped
+    data.gyro_y = f[3];  // Swapped
+    data.gyro_z = f[5];
+    data.mag_x = f[7];   // Swapped
+    data.mag_y = f[6];   // Swapped
+    data.mag_z = f[8];
+    data.quat_w = f[9];
+    data.quat_x = f[10]; // Native X
+    data.quat_y = f[11]; // Native Y
+    data.quat_z = f[12];
+}
+
+bool ECUConnector::DecodeAllEncoders(const std::vector<uint8_t>& payload, std::vector<float>& values) {
+    // Payload: CmdID (1) + 4 * 4 bytes
+    if (payload.size() < 1 + protocol::kEncoderPayloadSize) return false;
+    ReadEncoders(&payload[1], values);
+    return true;
+}
+
+bool ECUConnector::DecodeImu(const std::vector<uint8_t>& payload, ImuData& data) {
+    // Payload: CmdID (1) + 13 floats (4 bytes each) = 53 bytes
+    if (payload.size() < 1 + protocol::kImuPayloadSize) return false;
+    ReadImu(&payload[1], data);
+    return true;
+}
+
+bool ECUConnector::DecodeTelemetry(const std::vector<uint8_t>& payload, TelemetrySnapshot& snapshot) {
+    // Payload: CmdID (1) + Layout (1) + Fields (1) + selected blocks in bit order
+    if (payload.size() < 3) return false;
+    uint8_t layout = payload[1];
+    uint8_t fields = payload[2];
+    // A newer layout may add blocks we cannot size, so refuse it
+    if (layout == 0 || layout > protocol::kTelemetryLayout) return false;
+    uint8_t known = layout >= 2 ? protocol::kTelemetryFieldsV2 : protocol::kTelemetryFieldsV1;
+    if (fields & ~known) return false;
+
+    const uint8_t *p = payload.data() + 3;
+    const uint8_t *end = payload.data() + payload.size();
+    auto take = [&](size_t size) {
+        if (static_cast<size_t>(end - p) < size) return static_cast<const uint8_t*>(nullptr);
+        const uint8_t *block = p;
+        p += size;
+        return block;
+    };
+
+    snapshot.fields = fields & protocol::kTelemetryFieldsV1;
+    if (fields & protocol::kFieldEncoders) {
+        const uint8_t *block = take(protocol::kEncoderPayloadSize);
+        if (!block) return false;
+        ReadEncoders(block, snapshot.encoders);
+    }
+    if (fields & protocol::kFieldImu) {
+        const uint8_t *block = take(protocol::kImuPayloadSize);
+        if (!block) return false;
+        ReadImu(block, snapshot.imu);
+    }
+    if (fields & protocol::kFieldStatus) {
+        const uint8_t *block = take(protocol::kStatusPayloadSize);
+        if (!block) return false;
+        snapshot.status.ecuTimeMs = (static_cast<uint32_t>(block[0]) << 24) | (block[1] << 16) |
+                                    (block[2] << 8) | block[3];
+        snapshot.status.flags = block[4];
+    }
+    // Compact blocks are reported under their plain field bits
+    if (fields & protocol::kFieldEncodersCompact) {
+        int32_t deltas[4];
+        if (!compact::DecodeDeltas(p, end, deltas, 4)) return false;
+        snapshot.encoders.assign(deltas, deltas + 4);
+        snapshot.fields |= protocol::kFieldEncoders;
+    }
+    if (fields & protocol::kFieldImuCompact) {
+        float imu[compact::kImuFields];
+        if (!compact::DecodeImu(p, end, imu)) return false;
+        ImuFromFields(imu, snapshot.imu);
+        snapshot.fields |= protocol::kFieldImu;
+    }
+    return true;
+}
+
+bool ECUConnector::DecodeBurst(const std::vector<uint8_t>& payload, BurstBatch& batch) {
+    // Payload: CmdID (1) + Op (1) + Flags (1) + Index (4) + Time (4) + Period (2)
+    //          + Count (1) + Count * 4 * int16
+    if (payload.size() < protocol::kBurstHeaderSize || payload[1] != protocol::kBurstRead) return false;
+    auto readU32 = [&](int offset) {
+        return (static_cast<uint32_t>(payload[offset]) << 24) | (payload[offset+1] << 16) |
+               (payload[offset+2] << 8) | payload[offset+3];
+    };
+    batch.flags = payload[2];
+    batch.firstIndex = readU32(3);
+    batch.firstTimeUs = readU32(7);
+    batch.periodUs = static_cast<uint16_t>((payload[11] << 8) | payload[12]);
+    size_t count = payload[13];
+    if (payload.size() < protocol::kBurstHeaderSize + count * protocol::kBurstSampleSize) return false;
+
+    batch.samples.resize(count);
+    const uint8_t *p = payload.data() + protocol::kBurstHeaderSize;
+    for (size_t i = 0; i < count; ++i) {
+        for (int m = 0; m < 4; ++m, p += 2) {
+            batch.samples[i][m] = static_cast<int16_t>((p[0] << 8) | p[1]);
+        }
+    }
+    return true;
+}
+
+RequestAwaiter<std::vector<float>> ECUConnector::GetAllEncoders(std::chrono::milliseconds timeout) {
+    return {this, {0x05}, timeout, &ECUConnector::DecodeAllEncoders};
+}
+
+RequestAwaiter<float> ECUConnector::GetEncoder(int motorId, std::chrono::milliseconds timeout) {
+    std::vector<uint8_t> request;
+    if (motorId >= 0 && motorId <= 3) request = {0x04, static_cast<uint8_t>(motorId)};
+    return {this, request, timeout, &ECUConnector::DecodeEncoder};
+}
+
+RequestAwaiter<int> ECUConnector::GetApiVersion(std::chrono::milliseconds timeout) {
+    return {this, {0x01, 0x01}, timeout, &ECUConnector::DecodeApiVersion};
+}
+
+RequestAwaiter<ImuData> ECUConnector::GetImu(std::chrono::milliseconds timeout) {
+    return {this, {0x06}, timeout, &ECUConnector::DecodeImu};
+}
+
+RequestAwaiter<TelemetrySnapshot> ECUConnector::GetTelemetry(uint8_t fields, std::chrono::milliseconds timeout) {
+    // Older firmware would never answer; fail at once instead of timing out
+    std::vector<uint8_t> request;
+    if (SupportsTelemetry()) {
+        request = {protocol::kGetTelemetry, protocol::kTelemetryLayout, TelemetryRequestFields(fields)};
+    }
+    return {this, request, timeout, &ECUConnector::DecodeTelemetry};
+}
+
+bool SubmitPendingRequest(ECUConnector *connector, PendingRequest *request) {
+    if (request->request.empty()) {
+        request->Fail("Invalid request");
+        return false;
+    }
+    if (!connector->IsConnected()) {
+        request->Fail("Not connected");
+        return false;
+    }
+
+    connector->pending_[request->command].push_back(request);
+    request->timerId = connector->executor_->ScheduleAfter(
+        request->timeout, [connector, request]() {
+            auto &queue = connector->pending_[request->command];
+            queue.erase(std::remove(queue.begin(), queue.end(), request), queue.end());
+            request->Fail("Timeout");
+            connector->executor_->Post(request->handle);
+        });
+    connector->transport_->Send(request->request);
+    return true;
+}
+
+void ECUConnector::CompletePending(uint8_t cmdId, const std::vector<uint8_t>& payload,
+                                   std::chrono::steady_clock::time_point rxTime) {
+    auto it = pending_.find(cmdId);
+    if (it == pending_.end() || it->second.empty()) return;
+
+    PendingRequest *request = it->second.front();
+    it->second.pop_front();
+    executor_->Cancel(request->timerId);
+    request->Complete(payload, rxTime);
+    executor_->Post(request->handle);
+}
+
+void ECUConnector::FailAllPending(const QString& error) {
+    for (auto &[cmdId, queue] : pending_) {
+        for (PendingRequest *request : queue) {
+            executor_->Cancel(request->timerId);
+            request->Fail(error);
+            executor_->Post(request->handle);
+        }
+        queue.clear();
+    }
+}
+
 void ECUConnector::ProcessIncomingData() {
     if (!transport_) return;
+    if (!transport_->IsConnected()) {
+        // The port hung up, e.g. the adapter was unplugged
+        emit ErrorOccurred("Serial port closed");
+        Disconnect();
+        return;
+    }
+    // Segment retransmissions, for ports served by a reactor
+    transport_->Poll();
     
     std::vector<uint8_t> payload;
-    while (transport_->Read(payload)) {
+    std::chrono::steady_clock::time_point rxTime;
+    while (transport_ && transport_->Read(payload, rxTime)) {
         if (payload.empty()) continue;
         
         uint8_t cmdId = payload[0];
+        SetSampleTime(rxTime);
         if (cmdId == 0x01) { // GetApiVersion response
-            if (payload.size() >= 2) {
-                int version = payload[1];
+            int version;
+            if (DecodeApiVersion(payload, version)) {
+                apiVersion_ = version;
+                // First, so the requests below already go out in the new framing
+                ApplyFraming();
+                ApplyStreams();
+                ApplyBurst();
+                ApplyClockSync();
                 emit ApiVersionReceived(version);
             }
         } else if (cmdId == 0x04) { // GetEncoder response
-            // Payload: CmdID (1) + EncoderValue (4 bytes)
-            if (payload.size() >= 5 && lastRequestedEncoderMotor_ >= 0) {
-                int32_t val = (payload[1] << 24) | (payload[2] << 16) | 
-                              (payload[3] << 8) | payload[4];
-                emit EncoderValueUpdated(lastRequestedEncoderMotor_, static_cast<float>(val));
+            float value;
+            if (lastRequestedEncoderMotor_ >= 0 && DecodeEncoder(payload, value)) {
+                emit EncoderValueUpdated(lastRequestedEncoderMotor_, value);
                 lastRequestedEncoderMotor_ = -1; // Reset
             }
         } else if (cmdId == 0x05) { // GetAllEncoders response
-            // Payload: CmdID (1) + 4 * 4 bytes
-            if (payload.size() >= 17) {
-                std::vector<float> values;
-                for (int i = 0; i < 4; ++i) {
-                    int offset = 1 + i * 4;
-                    int32_t val = (payload[offset] << 24) | (payload[offset+1] << 16) | 
-                                  (payload[offset+2] << 8) | payload[offset+3];
-                    values.push_back(static_cast<float>(val));
-                }
+            std::vector<float> values;
+            if (DecodeAllEncoders(payload, values)) {
                 emit EncoderValuesUpdated(values);
+                ExportSample(TelemetrySample::Kind::kEncoders, values.data(), 4);
+                TrackMotion(values.data(), sampleTime_);
             }
         } else if (cmdId == 0x06) { // GetImu response
-            // Payload: CmdID (1) + 13 floats (4 bytes each) = 53 bytes
-            if (payload.size() >= 53) {
-                ImuData data;
-                auto readFloat = [&](int offset) {
-                    uint32_t val = (static_cast<uint32_t>(payload[offset+3]) << 24) |
-                                   (static_cast<uint32_t>(payload[offset+2]) << 16) |
-                                   (static_cast<uint32_t>(payload[offset+1]) << 8) |
-                                   (static_cast<uint32_t>(payload[offset]));
-                    float f;
-                    std::memcpy(&f, &val, 4);
-                    return f;
-                };
-
-                data.accel_x = readFloat(5); // Swapped: mapping hardware Y to application X
-                data.accel_y = readFloat(1); // Swapped: mapping hardware X to application Y
-                data.accel_z = readFloat(9);
-                data.gyro_x = readFloat(17); // Swapped
-                data.gyro_y = readFloat(13); // Swapped
-                data.gyro_z = readFloat(21);
-                data.mag_x = readFloat(29);  // Swapped
-                data.mag_y = readFloat(25);  // Swapped
-                data.mag_z = readFloat(33);
-                data.quat_w = readFloat(37);
-                data.quat_x = readFloat(41); // Native X
-                data.quat_y = readFloat(45); // Native Y
-                data.quat_z = readFloat(49);
-                
+            ImuData data;
+            if (DecodeImu(payload, data)) {
                 emit ImuDataReceived(data);
+                ExportSample(TelemetrySample::Kind::kImu, data.ToArray().data(), 13);
+            }
+        } else if (cmdId == protocol::kGetTelemetry) {
+            TelemetrySnapshot snapshot;
+            if (DecodeTelemetry(payload, snapshot)) {
+                if ((snapshot.fields & protocol::kFieldStatus) && clockSync_.valid()) {
+                    // All blocks were sampled at the status time (milliseconds, wraps)
+                    int64_t expectedMs = clockSync_.HostToEcu(HostMicros(rxTime)) / 1000;
+                    int64_t ecuMs = expectedMs + static_cast<int32_t>(
+                        snapshot.status.ecuTimeMs - static_cast<uint32_t>(expectedMs));
+                    sampleTime_ = EcuToHostTime(static_cast<uint64_t>(ecuMs) * 1000);
+                }
+                if (snapshot.fields & protocol::kFieldEncoders) {
+                    emit EncoderValuesUpdated(snapshot.encoders);
+                    ExportSample(TelemetrySample::Kind::kEncoders, snapshot.encoders.data(), 4);
+                    TrackMotion(snapshot.encoders.data(), sampleTime_);
+                }
+                if (snapshot.fields & protocol::kFieldImu) {
+                    emit ImuDataReceived(snapshot.imu);
+                    ExportSample(TelemetrySample::Kind::kImu, snapshot.imu.ToArray().data(), 13);
+                }
+                if (snapshot.fields & protocol::kFieldStatus) {
+                    emit StatusReceived(snapshot.status);
+                }
+            }
+        } else if (cmdId == protocol::kBurst) {
+            HandleBurstResponse(payload);
+        } else if (cmdId == protocol::kPing) {
+            if (payload.size() >= protocol::kPingResponseHeaderSize) {
+                uint16_t seq = (payload[1] << 8) | payload[2];
+                emit PingReceived(seq, static_cast<int>(payload.size()) - protocol::kPingResponseHeaderSize, rxTime);
             }
+        } else if (cmdId == protocol::kReadLog) {
+            if (payload.size() >= protocol::kReadLogResponseHeaderSize) {
+                uint32_t offset = ReadUint32(&payload[1]);
+                uint32_t total = ReadUint32(&payload[5]);
+                QByteArray text(reinterpret_cast<const char *>(payload.data()) + protocol::kReadLogResponseHeaderSize,
+                                static_cast<int>(payload.size()) - protocol::kReadLogResponseHeaderSize);
+                emit EcuLogReceived(offset, total, text);
+            }
+        } else if (cmdId == protocol::kFirmware) {
+            HandleFirmwareResponse(payload);
+        } else if (cmdId == protocol::kTimeSync) {
+            HandleTimeSync(payload, rxTime);
+        } else if (cmdId == protocol::kSetFraming) {
+            // The transport already switched on success
+            if (payload.size() >= 2 && payload[1] != 0) {
+                emit ErrorOccurred("ECU rejected the framing change");
+            }
+        } else if (cmdId == protocol::kEncoderStream || cmdId == protocol::kImuStream) {
+            HandleStreamFrame(payload);
         }
         // Handle other responses if needed
+
+        CompletePending(cmdId, payload, rxTime);
     }
 }
@@ -1,27 +1,89 @@
 #pragma once
 
+#include <QByteArray>
 #include <QObject>
-#include <QTimer>
+#include <array>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
+#include "ClockSync.h"
+#include "ControlLatency.h"
+#include "EcuAsync.h"
+#include "FirmwareUpload.h"
+#include "Protocol.h"
 #include "SerialTransport.h"
+#include "SetpointDispatcher.h"
+#include "TelemetryExporter.h"
+
+class IoReactor;
 
 struct ImuData {
     float accel_x, accel_y, accel_z;
     float gyro_x, gyro_y, gyro_z;
     float mag_x, mag_y, mag_z;
     float quat_w, quat_x, quat_y, quat_z;
+
+    // All 13 fields in wire order, for code that handles them as channels
+    std::array<float, 13> ToArray() const {
+        return {accel_x, accel_y, accel_z, gyro_x, gyro_y, gyro_z,
+                mag_x, mag_y, mag_z, quat_w, quat_x, quat_y, quat_z};
+    }
+};
+
+struct EcuStatus {
+    uint32_t ecuTimeMs = 0;
+    uint8_t flags = 0;
+};
+
+// One get_telemetry response: every selected block was sampled by the ECU at
+// the same instant. fields holds the protocol::kField* bits actually present.
+struct TelemetrySnapshot {
+    uint8_t fields = 0;
+    std::vector<float> encoders;
+    ImuData imu{};
+    EcuStatus status;
+};
+
+// One encoder sample of an ECU-buffered burst, timestamped by the ECU clock
+struct BurstSample {
+    uint64_t ecuTimeUs = 0;  // Unwrapped ECU time in microseconds
+    float deltas[4] = {};    // Ticks since the previous sample
+    // Capture time on the host clock; unset until the clocks are synchronised
+    std::chrono::steady_clock::time_point hostTime{};
+};
+
+// Decoded burst read response
+struct BurstBatch {
+    uint8_t flags = 0;
+    uint32_t firstIndex = 0;
+    uint32_t firstTimeUs = 0;
+    uint16_t periodUs = 0;
+    std::vector<std::array<int16_t, 4>> samples;
 };
 
 class ECUConnector : public QObject {
     Q_OBJECT
 public:
     explicit ECUConnector(QObject *parent = nullptr);
+    // Polling, timeouts and timestamps run on scheduler, e.g. a
+    // VirtualScheduler driven by a test harness, instead of the wall clock;
+    // every call is then made on the scheduler's thread
+    explicit ECUConnector(Scheduler *scheduler, QObject *parent = nullptr);
     ~ECUConnector();
 
-    void Connect(const QString &port, int baud);
+    // With a reactor the port shares its I/O thread with other connectors
+    void Connect(const QString &port, int baud, IoReactor *reactor = nullptr);
+    // Takes over a transport that is not started yet, e.g. one without a
+    // port over a simulated link
+    void Connect(std::unique_ptr<SerialTransport> transport, int baud, IoReactor *reactor = nullptr);
     void Disconnect();
     bool IsConnected() const;
+    // Serial port of the current connection; empty when disconnected or on a
+    // link without a port
+    QString Port() const { return port_; }
 
     void SetMotorSpeed(int motorId, int speed);
     void SetAllMotorsSpeed(const std::vector<int>& speeds);
@@ -29,8 +91,122 @@ public:
     void GetAllEncoders();
     void GetApiVersion();
     void GetImu();
+    // Combined request (API version protocol::kApiTelemetry and later)
+    void GetTelemetry(uint8_t fields = protocol::kTelemetryFieldsV1);
+
+    // Awaitable requests for coroutine test logic, e.g.
+    //   AsyncResult<std::vector<float>> r = co_await conn.GetAllEncoders(100ms);
+    // The connector must outlive every coroutine awaiting on it.
+    RequestAwaiter<std::vector<float>> GetAllEncoders(std::chrono::milliseconds timeout);
+    RequestAwaiter<float> GetEncoder(int motorId, std::chrono::milliseconds timeout);
+    RequestAwaiter<int> GetApiVersion(std::chrono::milliseconds timeout);
+    RequestAwaiter<ImuData> GetImu(std::chrono::milliseconds timeout);
+    RequestAwaiter<TelemetrySnapshot> GetTelemetry(uint8_t fields, std::chrono::milliseconds timeout);
+    AsyncExecutor::DelayAwaiter Delay(std::chrono::milliseconds delay) { return executor_->Delay(delay); }
+    AsyncExecutor* Executor() const { return executor_; }
+
+    static bool DecodeApiVersion(const std::vector<uint8_t>& payload, int& version);
+    static bool DecodeEncoder(const std::vector<uint8_t>& payload, float& value);
+    static bool DecodeAllEncoders(const std::vector<uint8_t>& payload, std::vector<float>& values);
+    static bool DecodeImu(const std::vector<uint8_t>& payload, ImuData& data);
+    static bool DecodeTelemetry(const std::vector<uint8_t>& payload, TelemetrySnapshot& snapshot);
+    static bool DecodeBurst(const std::vector<uint8_t>& payload, BurstBatch& batch);
     
-    std::vector<int> GetCurrentSpeeds() const { return currentSpeeds_; }
+    // Input-driven setpoint: sent with set_all_motors_speed as soon as the
+    // rate limit allows, on the calling thread when it is due. Unlike the
+    // other requests it may be called from any thread, e.g. an input thread
+    // that should not wait for the GUI event loop. SetAllMotorsSpeed()
+    // sends at once regardless of the limit.
+    // inputTime is when the input behind the setpoint happened (e.g. the
+    // gamepad event timestamp), for the control latency measurement; now
+    // if unset.
+    void SubmitSetpoint(const std::vector<int>& speeds,
+                        std::chrono::steady_clock::time_point inputTime = {});
+    // At most maxRateHz setpoints per second; the last one is repeated
+    // after keepalive without changes (0 disables, the default)
+    void SetSetpointRate(int maxRateHz, std::chrono::milliseconds keepalive);
+    SetpointDispatcher::Stats SetpointStats() const { return setpoints_->stats(); }
+    std::vector<int> GetCurrentSpeeds() const;
+
+    // Input-to-motion latency of the setpoints sent since the last reset,
+    // percentiles over the most recent measurements; each completed
+    // measurement is also emitted as ControlLatencyMeasured
+    ControlLatency::Summary ControlLatencySummary() const;
+    std::vector<ControlLatency::Measurement> ControlLatencyMeasurements() const;
+    std::vector<size_t> ControlLatencyHistogram(double bucketUs, size_t buckets) const;
+    void ResetControlLatency();
+
+    // API version reported by the ECU, 0 until the first get_api_version response
+    int ApiVersion() const { return apiVersion_; }
+    bool SupportsTelemetry() const { return apiVersion_ >= protocol::kApiTelemetry; }
+    // get_telemetry requests the compact encodings (fixed-point IMU, varint
+    // encoder deltas) when the ECU supports them; enabled by default
+    void SetCompactTelemetry(bool enabled) { compactTelemetry_ = enabled; }
+    bool UsesCompactTelemetry() const { return compactTelemetry_ && apiVersion_ >= protocol::kApiCompact; }
+    // Switches the link to COBS framing with set_framing once the ECU reports
+    // protocol::kApiCobs; disabled by default. Disconnect() switches back so
+    // the next session starts in legacy framing.
+    void SetCobsFraming(bool enabled);
+    bool UsesCobsFraming() const;
+
+    // Asks the ECU to push the selected streams (protocol::kStream* bits) at
+    // rateHz instead of being polled; 0 unsubscribes. Applied as soon as the
+    // API version is known. Firmware older than protocol::kApiStreaming never
+    // streams, so IsStreaming() stays false and callers keep polling.
+    void RequestStreams(uint8_t streams, int rateHz);
+    // True while frames of the stream arrive on time
+    bool IsStreaming(uint8_t stream) const;
+    uint64_t StreamGaps() const { return streamState_[0].gaps + streamState_[1].gaps; }
+
+    // Asks the ECU to sample the encoders at rateHz into its own buffer and
+    // drains it in batches, emitting BurstSamplesReceived; 0 stops. Rates
+    // below protocol::kBurstMinRateHz are rejected with ErrorOccurred. Like
+    // RequestStreams it is applied once the API version is known and needs
+    // protocol::kApiBurst.
+    void RequestBurst(int rateHz);
+    // True once the ECU acknowledged the burst start
+    bool IsBurstActive() const { return burst_.active; }
+    uint64_t BurstLostSamples() const { return burst_.lost; }
+
+    // Once the ECU reports protocol::kApiTimeSync, time_sync exchanges run in
+    // the background and map ECU capture times onto the host clock
+    bool HasClockSync() const { return clockSync_.valid(); }
+    const ClockSync& GetClockSync() const { return clockSync_; }
+    std::chrono::steady_clock::time_point EcuToHostTime(uint64_t ecuTimeUs) const;
+    // Capture time of the sample being emitted by EncoderValuesUpdated or
+    // ImuDataReceived: its ECU timestamp on the host clock when available,
+    // otherwise the receive time less the one-way link delay
+    std::chrono::steady_clock::time_point SampleTime() const { return sampleTime_; }
+
+    // Echo request (protocol::kApiPing) for link latency measurements: the
+    // ECU returns data cut or padded to replyBytes; answered by PingReceived
+    void Ping(uint16_t seq, const std::vector<uint8_t>& data, int replyBytes);
+    bool SupportsPing() const { return apiVersion_ >= protocol::kApiPing; }
+    // Baud rate of the open port
+    int Baud() const { return baud_; }
+
+    // Reads up to maxLength bytes of the ECU event log from offset (bytes
+    // since ECU start-up; protocol::kApiSegmentation). Answered by
+    // EcuLogReceived; responses larger than one frame arrive segmented.
+    void ReadEcuLog(uint32_t offset, int maxLength = 0xFFFF);
+    bool SupportsEcuLog() const { return apiVersion_ >= protocol::kApiSegmentation; }
+    // Segmentation counters of the open port
+    Segmenter::Stats SegmentStats();
+
+    // Writes a firmware image to the ECU (protocol::kApiFirmware), several
+    // blocks in flight at a time; progress is reported by FirmwareProgress
+    // and the outcome by FirmwareUploadFinished once the ECU has checked the
+    // image hash. False if an upload is running or the image is unusable.
+    bool UploadFirmware(const std::vector<uint8_t>& image, int blockSize = 4096);
+    void CancelFirmwareUpload();
+    bool IsFirmwareUploading() const { return firmware_ && firmware_->active(); }
+    bool SupportsFirmwareUpdate() const { return apiVersion_ >= protocol::kApiFirmware; }
+    size_t FirmwareBlocksResent() const { return firmware_ ? firmware_->blocks_resent() : 0; }
+
+    // UDP telemetry export (PlotJuggler-compatible JSON or MessagePack)
+    bool StartTelemetryExport(const QString &host, int port, bool msgPack);
+    void StopTelemetryExport();
+    bool IsTelemetryExportActive() const { return exporter_ != nullptr; }
 
 signals:
     void ConnectionChanged(bool connected);
@@ -40,15 +216,113 @@ signals:
     void ApiVersionReceived(int version);
     void SpeedSet(const std::vector<int>& speeds);
     void ImuDataReceived(const ImuData& data);
+    void StatusReceived(const EcuStatus& status);
     void RawDataSent(const std::vector<uint8_t>& data);
     void RawDataReceived(const std::vector<uint8_t>& data);
+    void StreamGapDetected(uint8_t stream, int missedFrames);
+    // Consecutive samples in ECU time order; batches never overlap
+    void BurstSamplesReceived(const std::vector<BurstSample>& samples);
+    // Samples lost between batches; overrun means the ECU buffer overflowed
+    void BurstGapDetected(uint32_t missedSamples, bool overrun);
+    void ClockSyncUpdated();
+    void PingReceived(uint16_t seq, int replyBytes, std::chrono::steady_clock::time_point rxTime);
+    // offset may be past the requested one when older lines were dropped;
+    // total is the log size so far, so more remains while offset + size < total
+    void EcuLogReceived(uint32_t offset, uint32_t total, const QByteArray &text);
+    // Image bytes the ECU has programmed and verified
+    void FirmwareProgress(qint64 confirmed, qint64 total);
+    void FirmwareUploadFinished(bool ok, const QString &message);
+    void ControlLatencyMeasured(const ControlLatency::Measurement &measurement);
 
 private slots:
     void ProcessIncomingData();
 
 private:
+    friend bool SubmitPendingRequest(ECUConnector *connector, PendingRequest *request);
+
+    static void ReadEncoders(const uint8_t* p, std::vector<float>& values);
+    static void ReadImu(const uint8_t* p, ImuData& data);
+    static void ImuFromFields(const float* fields, ImuData& data);
+    uint8_t TelemetryRequestFields(uint8_t fields) const;
+
+    void ExportSample(TelemetrySample::Kind kind, const float* values, int count);
+    void ApplyFraming();
+    void ApplyStreams();
+    void HandleStreamFrame(const std::vector<uint8_t>& payload);
+    void ApplyBurst();
+    void RequestBurstRead();
+    void HandleBurstResponse(const std::vector<uint8_t>& payload);
+    void ApplyClockSync();
+    void SendTimeSync();
+    void PollFirmwareUpload();
+    void HandleFirmwareResponse(const std::vector<uint8_t>& payload);
+    void SendFirmwareFrames(FirmwareUpload::Frames& frames);
+    // Called by setpoints_, on any thread
+    void SendSetpoint(const std::vector<int>& speeds);
+    void HandleTimeSync(const std::vector<uint8_t>& payload,
+                        std::chrono::steady_clock::time_point rxTime);
+    // Full ECU time in microseconds from its low 32 bits, taking the nearest
+    // candidate to the ECU time at rxTime
+    uint64_t UnwrapEcuTime(uint32_t lowUs, std::chrono::steady_clock::time_point rxTime) const;
+    void SetSampleTime(std::chrono::steady_clock::time_point rxTime);
+    // Encoder deltas captured at captured, checked for the commanded motion
+    void TrackMotion(const float *deltas, std::chrono::steady_clock::time_point captured);
+    void CompletePending(uint8_t cmdId, const std::vector<uint8_t>& payload,
+                         std::chrono::steady_clock::time_point rxTime);
+    void FailAllPending(const QString& error);
+
     std::unique_ptr<SerialTransport> transport_;
-    QTimer *pollTimer_;
+    QString port_;
+    std::unique_ptr<TelemetryExporter> exporter_;
+    AsyncExecutor *executor_;
+    // On executor_, so they follow an injected scheduler
+    std::unique_ptr<RepeatingTimer> pollTimer_;
+    std::unique_ptr<RepeatingTimer> burstTimer_;
+    std::unique_ptr<RepeatingTimer> syncTimer_;
+    std::unique_ptr<RepeatingTimer> firmwareTimer_;
+    std::unordered_map<uint8_t, std::deque<PendingRequest*>> pending_;
+    // Guards currentSpeeds_ and transport_ against setpoints sent from
+    // other threads
+    mutable std::mutex setpointMutex_;
+    std::unique_ptr<SetpointDispatcher> setpoints_;
+    // Fed from input, dispatcher and GUI threads
+    mutable std::mutex latencyMutex_;
+    ControlLatency latency_;
     std::vector<int> currentSpeeds_{0, 0, 0, 0};
     int lastRequestedEncoderMotor_{-1};
+
+    int apiVersion_ = 0;
+    int baud_ = 0;
+    bool compactTelemetry_ = true;
+    bool cobsFraming_ = false;
+    uint8_t requestedStreams_ = 0;
+    int streamRateHz_ = 0;
+    struct StreamState {
+        bool seen = false;
+        uint8_t nextSeq = 0;
+        std::chrono::steady_clock::time_point lastRx;
+        uint64_t gaps = 0;
+    };
+    StreamState streamState_[2]; // Encoders, IMU
+
+    int burstRateHz_ = 0;
+    struct BurstState {
+        bool active = false;
+        bool readPending = false;
+        std::chrono::steady_clock::time_point readSent;
+        bool haveIndex = false;
+        uint32_t nextIndex = 0;
+        uint64_t timeBase = 0;
+        uint32_t lastTimeUs = 0;
+        uint64_t lost = 0;
+    };
+    BurstState burst_;
+
+    std::unique_ptr<FirmwareUpload> firmware_;
+
+    ClockSync clockSync_;
+    uint8_t syncSeq_ = 0;
+    bool syncPending_ = false;
+    std::chrono::steady_clock::time_point syncSent_;
+    std::chrono::steady_clock::time_point sampleTime_;
 };
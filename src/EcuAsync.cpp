@@ -0,0 +1,76 @@
+#include "EcuAsync.h"
+
+#include <QMetaObject>
+
+AsyncExecutor::AsyncExecutor(QObject *parent) : QObject(parent) {
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    timer_->setTimerType(Qt::PreciseTimer);
+    connect(timer_, &QTimer::timeout, this, &AsyncExecutor::OnTimer);
+}
+
+AsyncExecutor::AsyncExecutor(Scheduler *clock, QObject *parent) : AsyncExecutor(parent) {
+    clock_ = clock;
+}
+
+Scheduler::TimerId AsyncExecutor::ScheduleAt(Clock::time_point deadline, std::function<void()> callback) {
+    if (clock_) return clock_->ScheduleAt(deadline, std::move(callback));
+    uint64_t id = nextId_++;
+    timers_.emplace(std::make_pair(deadline, id), std::move(callback));
+    deadlines_.emplace(id, deadline);
+    ArmTimer();
+    return id;
+}
+
+void AsyncExecutor::Cancel(TimerId id) {
+    if (clock_) {
+        clock_->Cancel(id);
+        return;
+    }
+    auto it = deadlines_.find(id);
+    if (it == deadlines_.end()) return;
+    timers_.erase(std::make_pair(it->second, id));
+    deadlines_.erase(it);
+    ArmTimer();
+}
+
+void AsyncExecutor::Post(std::coroutine_handle<> handle) {
+    if (clock_) {
+        clock_->ScheduleAt(clock_->Now(), [handle]() { handle.resume(); });
+        return;
+    }
+    ready_.push_back(handle);
+    if (!drainScheduled_) {
+        drainScheduled_ = true;
+        QMetaObject::invokeMethod(this, &AsyncExecutor::DrainReady, Qt::QueuedConnection);
+    }
+}
+
+void AsyncExecutor::ArmTimer() {
+    if (timers_.empty()) {
+        timer_->stop();
+        return;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers_.begin()->first.first - Now());
+    timer_->start(static_cast<int>(std::max<int64_t>(0, wait.count())));
+}
+
+void AsyncExecutor::OnTimer() {
+    Clock::time_point now = Now();
+    // One timer serves every deadline: fire all that are due, then re-arm
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        auto node = timers_.extract(timers_.begin());
+        deadlines_.erase(node.key().second);
+        node.mapped()();
+    }
+    ArmTimer();
+}
+
+void AsyncExecutor::DrainReady() {
+    drainScheduled_ = false;
+    std::deque<std::coroutine_handle<>> ready;
+    ready.swap(ready_);
+    for (auto handle : ready) {
+        handle.resume();
+    }
+}
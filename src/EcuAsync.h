@@ -0,0 +1,239 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Scheduler.h"
+
+class ECUConnector;
+
+// Result of an awaited request: the decoded value and the host time the
+// response frame was received, or an error (timeout, disconnect, bad frame).
+template <typename T>
+struct AsyncResult {
+    bool ok = false;
+    T value{};
+    std::chrono::steady_clock::time_point timestamp;
+    QString error;
+
+    explicit operator bool() const { return ok; }
+};
+
+// Single-threaded executor for coroutines driven by the Qt event loop: one
+// timer for all pending deadlines and a ready queue of coroutines to resume.
+// It is the wall-clock Scheduler of everything timed on the GUI thread.
+// Given a clock, e.g. a VirtualScheduler, it reads time from it and runs
+// timers and resumptions on it instead, without the event loop.
+class AsyncExecutor : public QObject, public Scheduler {
+    Q_OBJECT
+public:
+    explicit AsyncExecutor(QObject *parent = nullptr);
+    explicit AsyncExecutor(Scheduler *clock, QObject *parent = nullptr);
+
+    Clock::time_point Now() const override { return clock_ ? clock_->Now() : Clock::now(); }
+    TimerId ScheduleAt(Clock::time_point deadline, std::function<void()> callback) override;
+    void Cancel(TimerId id) override;
+    // Resumes the coroutine from the event loop, never from the caller's stack
+    void Post(std::coroutine_handle<> handle);
+
+    size_t PendingTimers() const { return timers_.size(); }
+
+    struct DelayAwaiter {
+        AsyncExecutor *executor;
+        Clock::duration delay;
+
+        bool await_ready() const noexcept { return delay <= Clock::duration::zero(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor->ScheduleAt(executor->Now() + delay, [ex = executor, handle]() { ex->Post(handle); });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    DelayAwaiter Delay(Clock::duration delay) { return {this, delay}; }
+
+private:
+    void ArmTimer();
+    void OnTimer();
+    void DrainReady();
+
+    Scheduler *clock_ = nullptr;
+    QTimer *timer_;
+    uint64_t nextId_ = 1;
+    std::map<std::pair<Clock::time_point, uint64_t>, std::function<void()>> timers_;
+    std::unordered_map<uint64_t, Clock::time_point> deadlines_;
+    std::deque<std::coroutine_handle<>> ready_;
+    bool drainScheduled_ = false;
+};
+
+// Request registered with ECUConnector while its coroutine is suspended.
+// Protocol responses carry no request id, so the first response with the
+// matching command id received after the request was sent completes it.
+struct PendingRequest {
+    ECUConnector *connector = nullptr;
+    std::vector<uint8_t> request;
+    uint8_t command = 0;
+    std::chrono::milliseconds timeout{0};
+    std::coroutine_handle<> handle;
+    uint64_t timerId = 0;
+
+    virtual ~PendingRequest() = default;
+    virtual void Complete(const std::vector<uint8_t> &payload, std::chrono::steady_clock::time_point rxTime) = 0;
+    virtual void Fail(const QString &error) = 0;
+};
+
+// Sends the request and registers it. Returns false (after calling Fail) if
+// the request could not be sent, in which case the coroutine continues at once.
+bool SubmitPendingRequest(ECUConnector *connector, PendingRequest *request);
+
+template <typename T>
+class [[nodiscard]] RequestAwaiter : public PendingRequest {
+public:
+    using Decoder = bool (*)(const std::vector<uint8_t> &, T &);
+
+    RequestAwaiter(ECUConnector *conn, std::vector<uint8_t> frame, std::chrono::milliseconds timeoutMs,
+                   Decoder decoder)
+        : decoder_(decoder) {
+        connector = conn;
+        command = frame.empty() ? 0 : frame[0];
+        request = std::move(frame);
+        timeout = timeoutMs;
+    }
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+        handle = h;
+        return SubmitPendingRequest(connector, this);
+    }
+    AsyncResult<T> await_resume() { return std::move(result_); }
+
+    void Complete(const std::vector<uint8_t> &payload, std::chrono::steady_clock::time_point rxTime) override {
+        result_.timestamp = rxTime;
+        result_.ok = decoder_(payload, result_.value);
+        if (!result_.ok) result_.error = "Malformed response";
+    }
+    void Fail(const QString &error) override {
+        result_.ok = false;
+        result_.error = error;
+    }
+
+private:
+    Decoder decoder_;
+    AsyncResult<T> result_;
+};
+
+// Coroutine type for sequential test logic. Lazily started: either co_await
+// it from another Task, or call Start() to run it detached.
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename Promise>
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+        auto &promise = h.promise();
+        if (promise.continuation) return promise.continuation;
+        if (promise.detached) h.destroy();
+        return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+    bool detached = false;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    void unhandled_exception() {
+        // Nobody can observe the exception of a detached task
+        if (detached) std::terminate();
+        error = std::current_exception();
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+class Task {
+public:
+    struct promise_type : detail::PromiseBase {
+        std::optional<T> value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        detail::FinalAwaiter<promise_type> final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = std::move(v); }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+    T await_resume() {
+        auto &promise = handle_.promise();
+        if (promise.error) std::rethrow_exception(promise.error);
+        return std::move(*promise.value);
+    }
+
+    void Start() && {
+        auto h = std::exchange(handle_, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : detail::PromiseBase {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        detail::FinalAwaiter<promise_type> final_suspend() noexcept { return {}; }
+        void return_void() const noexcept {}
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+    void await_resume() {
+        if (handle_.promise().error) std::rethrow_exception(handle_.promise().error);
+    }
+
+    void Start() && {
+        auto h = std::exchange(handle_, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
@@ -0,0 +1,524 @@
+#include "EcuSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Checksums.h"
+#include "CompactCodec.h"
+
+namespace {
+
+// Rover geometry used to derive the yaw rate from wheel speeds
+constexpr double kWheelCircumferenceM = 0.2;
+constexpr double kTrackWidthM = 0.3;
+constexpr double kGravity = 9.81;
+
+void AppendInt32(std::vector<uint8_t>& out, int32_t v) {
+  out.push_back((v >> 24) & 0xFF);
+  out.push_back((v >> 16) & 0xFF);
+  out.push_back((v >> 8) & 0xFF);
+  out.push_back(v & 0xFF);
+}
+
+void AppendFloatLe(std::vector<uint8_t>& out, float f) {
+  uint32_t v;
+  std::memcpy(&v, &f, 4);
+  out.push_back(v & 0xFF);
+  out.push_back((v >> 8) & 0xFF);
+  out.push_back((v >> 16) & 0xFF);
+  out.push_back((v >> 24) & 0xFF);
+}
+
+void AppendUint64(std::vector<uint8_t>& out, uint64_t v) {
+  for (int shift = 56; shift >= 0; shift -= 8) out.push_back((v >> shift) & 0xFF);
+}
+
+int32_t ReadInt32(const uint8_t* p) {
+  return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+}  // namespace
+
+EcuSimulator::EcuSimulator(const Config& config, Clock::time_point start)
+    : config_(config), start_(start) {
+  Log(start_, "boot api=" + std::to_string(config_.api_version) +
+                  " ticks_per_rev=" + std::to_string(config_.ticks_per_rev));
+  for (int i = 0; i < 4; ++i) {
+    Log(start_, "selftest motor" + std::to_string(i) + " driver ok encoder ok");
+  }
+  Log(start_, "selftest imu ok gyro_bias=0.000 accel_bias=0.000");
+}
+
+void EcuSimulator::HandleRequest(const std::vector<uint8_t>& request,
+                                 Clock::time_point now, Frames& out) {
+  if (request.empty()) return;
+  Integrate(now);
+  last_request_ = now;
+
+  std::vector<uint8_t> response;
+  response.push_back(request[0]);
+
+  switch (request[0]) {
+    case protocol::kGetApiVersion:
+      response.push_back(static_cast<uint8_t>(config_.api_version));
+      break;
+    case protocol::kSetMotorSpeed:
+      if (request.size() < 6 || request[1] > 3) {
+        response.push_back(1);
+        break;
+      }
+      setpoint_rpm_[request[1]] = ReadInt32(&request[2]) / 100.0;
+      if (failsafe_) Log(now, "failsafe cleared");
+      failsafe_ = false;
+      response.push_back(0);
+      break;
+    case protocol::kSetAllMotorsSpeed:
+      if (request.size() < 17) {
+        response.push_back(1);
+        break;
+      }
+      for (int i = 0; i < 4; ++i) {
+        setpoint_rpm_[i] = ReadInt32(&request[1 + i * 4]) / 100.0;
+      }
+      if (failsafe_) Log(now, "failsafe cleared");
+      failsafe_ = false;
+      response.push_back(0);
+      break;
+    case protocol::kGetEncoder:
+      if (request.size() < 2 || request[1] > 3) return;
+      AppendInt32(response, TakeTicks(request[1]));
+      break;
+    case protocol::kGetAllEncoders:
+      AppendEncoders(response);
+      break;
+    case protocol::kGetImu:
+      AppendImu(response);
+      break;
+    case protocol::kSubscribe: {
+      // Older firmware does not know the command and stays silent
+      if (config_.api_version < protocol::kApiStreaming) return;
+      if (request.size() < 4) {
+        response.push_back(1);
+        break;
+      }
+      int rate_hz = (request[2] << 8) | request[3];
+      streams_ = rate_hz > 0 ? request[1] : 0;
+      if (streams_) {
+        stream_period_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / rate_hz));
+        next_stream_ = now;
+      }
+      Log(now, "subscribe streams=" + std::to_string(streams_) +
+                   " rate_hz=" + std::to_string(rate_hz));
+      response.push_back(0);
+      break;
+    }
+    case protocol::kGetTelemetry:
+      if (config_.api_version < protocol::kApiTelemetry || request.size() < 3) return;
+      AppendTelemetry(request, now, response);
+      break;
+    case protocol::kBurst:
+      if (config_.api_version < protocol::kApiBurst) return;
+      HandleBurst(request, now, response);
+      break;
+    case protocol::kTimeSync:
+      if (config_.api_version < protocol::kApiTimeSync || request.size() < 2) return;
+      // Echo the sequence number; the model answers in the same instant it
+      // receives, so both timestamps are equal
+      response.push_back(request[1]);
+      AppendUint64(response, EcuMicros(now));
+      AppendUint64(response, EcuMicros(now));
+      break;
+    case protocol::kPing: {
+      if (config_.api_version < protocol::kApiPing ||
+          request.size() < protocol::kPingRequestHeaderSize) {
+        return;
+      }
+      // Echo the data, cut or padded with 0x55 to the requested length
+      size_t reply = std::min<size_t>(request[3], protocol::kPingMaxData);
+      response.push_back(request[1]);
+      response.push_back(request[2]);
+      for (size_t i = 0; i < reply; ++i) {
+        size_t src = protocol::kPingRequestHeaderSize + i;
+        response.push_back(src < request.size() ? request[src] : 0x55);
+      }
+      break;
+    }
+    case protocol::kSetFraming:
+      if (config_.api_version < protocol::kApiCobs) return;
+      if (request.size() < 2 || request[1] > protocol::kFramingCobs) {
+        response.push_back(1);
+        break;
+      }
+      cobs_ = request[1] == protocol::kFramingCobs;
+      Log(now, cobs_ ? "framing cobs" : "framing legacy");
+      response.push_back(0);
+      break;
+    case protocol::kReadLog:
+      if (config_.api_version < protocol::kApiSegmentation ||
+          request.size() < protocol::kReadLogRequestSize) {
+        return;
+      }
+      HandleReadLog(request, response);
+      break;
+    case protocol::kFirmware:
+      if (config_.api_version < protocol::kApiFirmware || request.size() < 2) return;
+      HandleFirmware(request, now, response);
+      break;
+    default:
+      return;
+  }
+  out.push_back(std::move(response));
+}
+
+void EcuSimulator::Advance(Clock::time_point now, Frames& out) {
+  Integrate(now);
+
+  // Failsafe: a host that went silent gets no more streams and stopped motors.
+  // The framing stays as negotiated, the host may only have been idle
+  if (last_request_ != Clock::time_point{} && now - last_request_ > kLinkTimeout) {
+    if (!failsafe_) Log(now, "failsafe link timeout");
+    streams_ = 0;
+    burst_rate_hz_ = 0;
+    for (double& sp : setpoint_rpm_) sp = 0;
+    failsafe_ = true;
+  }
+
+  if (!streams_ || now < next_stream_) return;
+
+  if (streams_ & protocol::kStreamEncoders) {
+    std::vector<uint8_t> frame{protocol::kEncoderStream, stream_seq_[0]++};
+    AppendEncoders(frame);
+    AppendTimestamp(frame, now);
+    out.push_back(std::move(frame));
+  }
+  if (streams_ & protocol::kStreamImu) {
+    std::vector<uint8_t> frame{protocol::kImuStream, stream_seq_[1]++};
+    AppendImu(frame);
+    AppendTimestamp(frame, now);
+    out.push_back(std::move(frame));
+  }
+
+  next_stream_ += stream_period_;
+  // Do not burst to catch up after a stall, keep the nominal rate instead
+  if (next_stream_ <= now) next_stream_ = now + stream_period_;
+}
+
+uint64_t EcuSimulator::EcuMicros(Clock::time_point t) const {
+  double us = std::chrono::duration<double, std::micro>(t - start_).count();
+  return static_cast<uint64_t>(us * (1.0 + config_.clock_drift_ppm * 1e-6));
+}
+
+void EcuSimulator::Integrate(Clock::time_point now) {
+  if (last_update_ == Clock::time_point{}) {
+    last_update_ = now;
+    return;
+  }
+  // Step exactly to every burst sample instant so samples are not smeared
+  // across the host loop period
+  while (burst_rate_hz_ && next_burst_sample_ <= now) {
+    StepTo(next_burst_sample_);
+    TakeBurstSample(next_burst_sample_);
+    next_burst_sample_ += burst_period_;
+  }
+  StepTo(now);
+}
+
+void EcuSimulator::StepTo(Clock::time_point t) {
+  double dt = std::chrono::duration<double>(t - last_update_).count();
+  if (dt <= 0) return;
+  last_update_ = t;
+
+  double alpha = 1.0 - std::exp(-dt / config_.time_constant_s);
+  for (int i = 0; i < 4; ++i) {
+    double previous = rpm_[i];
+    rpm_[i] += (setpoint_rpm_[i] - rpm_[i]) * alpha;
+    double ticks = 0.5 * (previous + rpm_[i]) / 60.0 * config_.ticks_per_rev * dt;
+    ticks_[i] += ticks;
+    burst_ticks_[i] += ticks;
+  }
+
+  // Differential drive: M1, M2 left side, M3, M4 right side
+  double left = (rpm_[0] + rpm_[1]) / 2.0 / 60.0 * kWheelCircumferenceM;
+  double right = (rpm_[2] + rpm_[3]) / 2.0 / 60.0 * kWheelCircumferenceM;
+  yaw_rate_ = (right - left) / kTrackWidthM;
+  yaw_ = std::remainder(yaw_ + yaw_rate_ * dt, 2.0 * M_PI);
+}
+
+void EcuSimulator::TakeBurstSample(Clock::time_point t) {
+  BurstSample sample;
+  sample.index = burst_index_++;
+  sample.time_us = static_cast<uint32_t>(EcuMicros(t));
+  for (int i = 0; i < 4; ++i) {
+    double whole = std::trunc(burst_ticks_[i]);
+    burst_ticks_[i] -= whole;
+    sample.deltas[i] = static_cast<int16_t>(std::clamp(whole, -32768.0, 32767.0));
+  }
+  burst_buffer_.push_back(sample);
+  if (burst_buffer_.size() > config_.burst_buffer_samples) {
+    burst_buffer_.pop_front();
+    burst_overrun_ = true;
+  }
+}
+
+void EcuSimulator::HandleBurst(const std::vector<uint8_t>& request,
+                               Clock::time_point now,
+                               std::vector<uint8_t>& out) {
+  uint8_t op = request.size() > 1 ? request[1] : 0xFF;
+  out.push_back(op);
+
+  if (op == protocol::kBurstStart) {
+    int rate_hz = request.size() >= 4 ? (request[2] << 8) | request[3] : 0;
+    if (rate_hz < protocol::kBurstMinRateHz || rate_hz > protocol::kBurstMaxRateHz) {
+      out.push_back(1);
+      return;
+    }
+    burst_rate_hz_ = rate_hz;
+    Log(now, "burst start rate_hz=" + std::to_string(rate_hz));
+    burst_period_ = std::chrono::microseconds(1000000 / rate_hz);
+    next_burst_sample_ = now + burst_period_;
+    burst_buffer_.clear();
+    burst_overrun_ = false;
+    for (double& ticks : burst_ticks_) ticks = 0;
+    out.push_back(0);
+  } else if (op == protocol::kBurstStop) {
+    if (burst_rate_hz_) Log(now, "burst stop");
+    burst_rate_hz_ = 0;
+    burst_buffer_.clear();
+    out.push_back(0);
+  } else if (op == protocol::kBurstRead) {
+    size_t count = request.size() > 2 ? request[2] : protocol::kBurstMaxSamples;
+    count = std::min({count, static_cast<size_t>(protocol::kBurstMaxSamples),
+                      burst_buffer_.size()});
+    const BurstSample* first = count ? &burst_buffer_.front() : nullptr;
+
+    out.push_back(burst_overrun_ ? protocol::kBurstOverrun : 0);
+    AppendInt32(out, static_cast<int32_t>(first ? first->index : burst_index_));
+    AppendInt32(out, static_cast<int32_t>(first ? first->time_us : 0));
+    uint16_t period_us = static_cast<uint16_t>(burst_period_.count());
+    out.push_back(period_us >> 8);
+    out.push_back(period_us & 0xFF);
+    out.push_back(static_cast<uint8_t>(count));
+    for (size_t n = 0; n < count; ++n) {
+      const BurstSample& sample = burst_buffer_.front();
+      for (int16_t d : sample.deltas) {
+        out.push_back(static_cast<uint8_t>((d >> 8) & 0xFF));
+        out.push_back(static_cast<uint8_t>(d & 0xFF));
+      }
+      burst_buffer_.pop_front();
+    }
+    burst_overrun_ = false;
+  } else {
+    out.push_back(1);
+  }
+}
+
+void EcuSimulator::HandleReadLog(const std::vector<uint8_t>& request,
+                                 std::vector<uint8_t>& out) const {
+  uint32_t total = log_dropped_ + static_cast<uint32_t>(log_.size());
+  uint32_t offset = static_cast<uint32_t>(ReadInt32(&request[1]));
+  size_t max_length = (request[5] << 8) | request[6];
+  // Lines already dropped are skipped; the response says where it starts
+  offset = std::clamp(offset, log_dropped_, total);
+  size_t length = std::min<size_t>(max_length, total - offset);
+
+  AppendInt32(out, static_cast<int32_t>(offset));
+  AppendInt32(out, static_cast<int32_t>(total));
+  auto first = log_.begin() + (offset - log_dropped_);
+  out.insert(out.end(), first, first + length);
+}
+
+void EcuSimulator::HandleFirmware(const std::vector<uint8_t>& request,
+                                  Clock::time_point now,
+                                  std::vector<uint8_t>& out) {
+  uint8_t op = request[1];
+  out.push_back(op);
+
+  if (op == protocol::kFirmwareBegin) {
+    size_t size = request.size() >= 8 ? static_cast<uint32_t>(ReadInt32(&request[2])) : 0;
+    size_t block_size = request.size() >= 8 ? (request[6] << 8) | request[7] : 0;
+    if (size == 0 || size > config_.flash_size || block_size == 0 ||
+        block_size > static_cast<size_t>(protocol::kFirmwareMaxBlockSize) ||
+        (size + block_size - 1) / block_size > 0xFFFF) {
+      out.push_back(protocol::kFirmwareRejected);
+      return;
+    }
+    // Erase
+    flashing_ = true;
+    flash_.assign(size, 0xFF);
+    flash_block_size_ = block_size;
+    flash_blocks_.assign((size + block_size - 1) / block_size, false);
+    flash_prefix_ = 0;
+    Log(now, "firmware begin size=" + std::to_string(size) +
+                 " block=" + std::to_string(block_size));
+    out.push_back(protocol::kFirmwareOk);
+  } else if (op == protocol::kFirmwareWrite) {
+    auto reply = [&](uint8_t status) {
+      out.push_back(status);
+      out.push_back(static_cast<uint8_t>(flash_prefix_ >> 8));
+      out.push_back(static_cast<uint8_t>(flash_prefix_));
+    };
+    if (request.size() < protocol::kFirmwareWriteHeaderSize) {
+      out.push_back(0);
+      out.push_back(0);
+      reply(protocol::kFirmwareRejected);
+      return;
+    }
+    size_t index = (request[2] << 8) | request[3];
+    out.push_back(request[2]);
+    out.push_back(request[3]);
+    const uint8_t* data = request.data() + protocol::kFirmwareWriteHeaderSize;
+    size_t len = request.size() - protocol::kFirmwareWriteHeaderSize;
+    size_t offset = index * flash_block_size_;
+    if (!flashing_ || index >= flash_blocks_.size() ||
+        len != std::min(flash_block_size_, flash_.size() - offset)) {
+      reply(protocol::kFirmwareRejected);
+      return;
+    }
+
+    // A block sent again because its answer was lost is already in flash
+    uint32_t crc = static_cast<uint32_t>(ReadInt32(&request[4]));
+    if (flash_blocks_[index] && Crc32(flash_.data() + offset, len) == crc) {
+      reply(protocol::kFirmwareOk);
+      return;
+    }
+    std::copy(data, data + len, flash_.begin() + offset);
+    if (std::uniform_real_distribution<double>(0, 1)(flash_rng_) <
+        config_.flash_error_rate) {
+      flash_[offset + len / 2] ^= 0x10;  // A bit that did not program
+    }
+    // Read back and compare, as the bootloader does
+    bool ok = Crc32(flash_.data() + offset, len) == crc;
+    flash_blocks_[index] = ok;
+    if (!ok) flash_prefix_ = std::min(flash_prefix_, index);
+    while (flash_prefix_ < flash_blocks_.size() && flash_blocks_[flash_prefix_]) {
+      ++flash_prefix_;
+    }
+    reply(ok ? protocol::kFirmwareOk : protocol::kFirmwareCrcError);
+  } else if (op == protocol::kFirmwareFinish) {
+    // A finish repeated because its answer was lost finds the image
+    // already committed and reports on it again
+    if (flash_blocks_.empty() || request.size() < 2u + protocol::kFirmwareHashSize) {
+      out.push_back(protocol::kFirmwareRejected);
+      return;
+    }
+    if (std::find(flash_blocks_.begin(), flash_blocks_.end(), false) !=
+        flash_blocks_.end()) {
+      out.push_back(protocol::kFirmwareIncomplete);
+      return;
+    }
+    Sha256::Digest hash = Sha256::Hash(flash_.data(), flash_.size());
+    bool match = std::equal(hash.begin(), hash.end(), request.begin() + 2);
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%02x%02x%02x%02x%02x%02x%02x%02x", hash[0],
+             hash[1], hash[2], hash[3], hash[4], hash[5], hash[6], hash[7]);
+    if (flashing_) {
+      Log(now, std::string(match ? "firmware verified" : "firmware hash mismatch") +
+                   " sha256=" + hex + "...");
+    }
+    // A verified image is committed; a mismatch keeps the session so the
+    // host may rewrite blocks
+    if (match) flashing_ = false;
+    out.push_back(match ? protocol::kFirmwareOk : protocol::kFirmwareHashError);
+    out.insert(out.end(), hash.begin(), hash.end());
+  } else if (op == protocol::kFirmwareAbort) {
+    if (flashing_) Log(now, "firmware aborted");
+    flashing_ = false;
+    flash_blocks_.clear();
+    out.push_back(protocol::kFirmwareOk);
+  } else {
+    out.push_back(protocol::kFirmwareRejected);
+  }
+}
+
+void EcuSimulator::Log(Clock::time_point now, const std::string& text) {
+  char stamp[24];
+  snprintf(stamp, sizeof(stamp), "%10.3f ",
+           static_cast<double>(EcuMicros(now)) / 1e6);
+  log_ += stamp;
+  log_ += text;
+  log_ += '\n';
+
+  if (log_.size() <= config_.log_capacity) return;
+  size_t cut = log_.find('\n', log_.size() - config_.log_capacity);
+  cut = cut == std::string::npos ? log_.size() : cut + 1;
+  log_.erase(0, cut);
+  log_dropped_ += static_cast<uint32_t>(cut);
+}
+
+int32_t EcuSimulator::TakeTicks(int motor) {
+  // Encoders report deltas since the last read; keep the fractional part
+  double whole = std::trunc(ticks_[motor]);
+  ticks_[motor] -= whole;
+  return static_cast<int32_t>(whole);
+}
+
+void EcuSimulator::AppendEncoders(std::vector<uint8_t>& out) {
+  for (int i = 0; i < 4; ++i) {
+    AppendInt32(out, TakeTicks(i));
+  }
+}
+
+void EcuSimulator::ImuFields(float* fields) const {
+  float mag_x = static_cast<float>(20.0 * std::cos(yaw_));
+  float mag_y = static_cast<float>(-20.0 * std::sin(yaw_));
+
+  // Hardware field order; the host swaps X and Y of accel, gyro and mag
+  const float values[13] = {
+      0.0f, 0.0f, static_cast<float>(kGravity),
+      0.0f, 0.0f, static_cast<float>(yaw_rate_),
+      mag_y, mag_x, -40.0f,
+      static_cast<float>(std::cos(yaw_ / 2)), 0.0f, 0.0f,
+      static_cast<float>(std::sin(yaw_ / 2)),
+  };
+  std::copy(values, values + 13, fields);
+}
+
+void EcuSimulator::AppendImu(std::vector<uint8_t>& out) const {
+  float fields[13];
+  ImuFields(fields);
+  for (float f : fields) AppendFloatLe(out, f);
+}
+
+void EcuSimulator::AppendTimestamp(std::vector<uint8_t>& out,
+                                   Clock::time_point now) const {
+  if (config_.api_version < protocol::kApiTimeSync) return;
+  AppendInt32(out, static_cast<int32_t>(EcuMicros(now)));
+}
+
+void EcuSimulator::AppendStatus(std::vector<uint8_t>& out,
+                                Clock::time_point now) const {
+  AppendInt32(out, static_cast<int32_t>(EcuMicros(now) / 1000));
+  out.push_back(failsafe_ ? protocol::kStatusFailsafe : 0);
+}
+
+void EcuSimulator::AppendTelemetry(const std::vector<uint8_t>& request,
+                                   Clock::time_point now,
+                                   std::vector<uint8_t>& out) {
+  // Answer in the older of the two layouts, with the fields it defines
+  uint8_t own_layout = config_.api_version >= protocol::kApiCompact ? 2 : 1;
+  uint8_t layout = std::min(request[1], own_layout);
+  uint8_t fields = request[2] & (layout >= 2 ? protocol::kTelemetryFieldsV2
+                                             : protocol::kTelemetryFieldsV1);
+  if (fields & protocol::kFieldEncodersCompact) fields &= ~protocol::kFieldEncoders;
+  if (fields & protocol::kFieldImuCompact) fields &= ~protocol::kFieldImu;
+  out.push_back(layout);
+  out.push_back(fields);
+
+  // All blocks come from the same model state, so the snapshot is atomic
+  if (fields & protocol::kFieldEncoders) AppendEncoders(out);
+  if (fields & protocol::kFieldImu) AppendImu(out);
+  if (fields & protocol::kFieldStatus) AppendStatus(out, now);
+  if (fields & protocol::kFieldEncodersCompact) {
+    int32_t deltas[4];
+    for (int i = 0; i < 4; ++i) deltas[i] = TakeTicks(i);
+    compact::EncodeDeltas(deltas, 4, out);
+  }
+  if (fields & protocol::kFieldImuCompact) {
+    float imu[compact::kImuFields];
+    ImuFields(imu);
+    compact::EncodeImu(imu, compact::kDefaultImuExponents, out);
+  }
+}
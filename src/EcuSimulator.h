@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Protocol.h"
+
+// Protocol-level model of the chassis controller: four first-order motors
+// with encoders and a synthetic IMU. Transport-agnostic; ecu_sim serves it
+// on a pty so the PTS can be exercised without hardware.
+class EcuSimulator {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Frames = std::vector<std::vector<uint8_t>>;
+
+  struct Config {
+    int api_version = protocol::kApiLatest;
+    int ticks_per_rev = 1328;
+    double time_constant_s = 0.15;
+    size_t burst_buffer_samples = 512;
+    // Rate error of the ECU clock, to exercise the host's drift estimation
+    double clock_drift_ppm = 0;
+    // Event log served by read_log; the oldest lines are dropped beyond this
+    size_t log_capacity = 16 * 1024;
+    // Largest image the firmware command accepts
+    size_t flash_size = 1024 * 1024;
+    // Share of blocks whose programming fails verification, to exercise
+    // the host's retransmission
+    double flash_error_rate = 0;
+  };
+
+  // start is the ECU's power-on time on the host clock, which may be a
+  // virtual one
+  explicit EcuSimulator(const Config& config, Clock::time_point start = Clock::now());
+
+  // Handles one request payload; appends the response payloads to out.
+  void HandleRequest(const std::vector<uint8_t>& request, Clock::time_point now,
+                     Frames& out);
+  // Advances the motor model to now; appends any stream frames that are due.
+  void Advance(Clock::time_point now, Frames& out);
+
+  // Framing negotiated with set_framing. The transport switches its receive
+  // side before sending the acknowledgement and its send side after it.
+  bool UsesCobs() const { return cobs_; }
+
+ private:
+  static constexpr auto kLinkTimeout = std::chrono::seconds(2);
+
+  struct BurstSample {
+    uint32_t index;
+    uint32_t time_us;
+    int16_t deltas[4];
+  };
+
+  // ECU clock in microseconds since start-up
+  uint64_t EcuMicros(Clock::time_point t) const;
+  void Integrate(Clock::time_point now);
+  void StepTo(Clock::time_point t);
+  void TakeBurstSample(Clock::time_point t);
+  void HandleBurst(const std::vector<uint8_t>& request, Clock::time_point now,
+                   std::vector<uint8_t>& out);
+  void HandleReadLog(const std::vector<uint8_t>& request,
+                     std::vector<uint8_t>& out) const;
+  void HandleFirmware(const std::vector<uint8_t>& request, Clock::time_point now,
+                      std::vector<uint8_t>& out);
+  void Log(Clock::time_point now, const std::string& text);
+  void AppendEncoders(std::vector<uint8_t>& out);
+  void ImuFields(float* fields) const;
+  void AppendImu(std::vector<uint8_t>& out) const;
+  void AppendTimestamp(std::vector<uint8_t>& out, Clock::time_point now) const;
+  void AppendStatus(std::vector<uint8_t>& out, Clock::time_point now) const;
+  void AppendTelemetry(const std::vector<uint8_t>& request, Clock::time_point now,
+                       std::vector<uint8_t>& out);
+  int32_t TakeTicks(int motor);
+
+  Config config_;
+  Clock::time_point start_;
+  Clock::time_point last_update_{};
+  Clock::time_point last_request_{};
+
+  double setpoint_rpm_[4] = {};
+  double rpm_[4] = {};
+  double ticks_[4] = {};  // Accumulated since the last encoder read
+  double yaw_ = 0;
+  double yaw_rate_ = 0;
+  bool failsafe_ = false;
+  bool cobs_ = false;
+
+  uint8_t streams_ = 0;
+  Clock::duration stream_period_{};
+  Clock::time_point next_stream_{};
+  uint8_t stream_seq_[2] = {};
+
+  // Burst sampling runs on its own tick accumulator so it does not disturb
+  // the polled encoder deltas
+  int burst_rate_hz_ = 0;
+  std::chrono::microseconds burst_period_{};
+  Clock::time_point next_burst_sample_{};
+  uint32_t burst_index_ = 0;
+  double burst_ticks_[4] = {};
+  std::deque<BurstSample> burst_buffer_;
+  bool burst_overrun_ = false;
+
+  // Log offsets count from start-up, so a host can resume where it stopped
+  // even after old lines have been dropped
+  std::string log_;
+  uint32_t log_dropped_ = 0;
+
+  // Firmware update session: the image as programmed so far
+  bool flashing_ = false;
+  std::vector<uint8_t> flash_;
+  size_t flash_block_size_ = 0;
+  std::vector<bool> flash_blocks_;
+  size_t flash_prefix_ = 0;  // Leading blocks all programmed
+  std::mt19937 flash_rng_{7};
+};
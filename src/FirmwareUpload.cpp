@@ -0,0 +1,203 @@
+#include "FirmwareUpload.h"
+
+#include <algorithm>
+
+#include "Protocol.h"
+
+namespace {
+
+void PutBe16(std::vector<uint8_t>& out, uint32_t v) {
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+void PutBe32(std::vector<uint8_t>& out, uint32_t v) {
+  PutBe16(out, v >> 16);
+  PutBe16(out, v & 0xFFFF);
+}
+
+}  // namespace
+
+FirmwareUpload::FirmwareUpload() : FirmwareUpload(Config()) {}
+
+FirmwareUpload::FirmwareUpload(const Config& config) : config_(config) {
+  config_.window = std::max<size_t>(config_.window, 1);
+}
+
+FirmwareUpload::Clock::duration FirmwareUpload::TimeoutFor(size_t block_size,
+                                                          int baud) {
+  if (baud <= 0) return Config().timeout;
+  auto block_time = std::chrono::microseconds(
+      static_cast<int64_t>(block_size) * 10 * 1000000 / baud);
+  return std::chrono::milliseconds(500) + 3 * block_time;
+}
+
+bool FirmwareUpload::Start(std::vector<uint8_t> image, Clock::time_point now,
+                           Frames& out) {
+  size_t block_size = config_.block_size;
+  if (image.empty() || block_size == 0 ||
+      block_size > static_cast<size_t>(protocol::kFirmwareMaxBlockSize) ||
+      (image.size() + block_size - 1) / block_size > 0xFFFF) {
+    return false;
+  }
+
+  image_ = std::move(image);
+  hash_ = Sha256::Hash(image_.data(), image_.size());
+  blocks_.assign((image_.size() + block_size - 1) / block_size, Block());
+  next_block_ = 0;
+  outstanding_ = 0;
+  programmed_ = 0;
+  bytes_confirmed_ = 0;
+  blocks_resent_ = 0;
+  control_retries_ = 0;
+  error_.clear();
+
+  state_ = State::kBeginning;
+  SendControl(now, out);
+  return true;
+}
+
+bool FirmwareUpload::OnResponse(const std::vector<uint8_t>& payload,
+                                Clock::time_point now, Frames& out) {
+  if (payload.size() < 3 || payload[0] != protocol::kFirmware) return false;
+  uint8_t op = payload[1];
+
+  if (op == protocol::kFirmwareBegin && state_ == State::kBeginning) {
+    if (payload[2] != protocol::kFirmwareOk) {
+      Fail("ECU rejected an image of " + std::to_string(image_.size()) +
+           " bytes in blocks of " + std::to_string(config_.block_size));
+      return true;
+    }
+    state_ = State::kWriting;
+    last_progress_ = now;
+    FillWindow(now, out);
+  } else if (op == protocol::kFirmwareWrite && state_ == State::kWriting) {
+    if (payload.size() < protocol::kFirmwareWriteResponseSize) return true;
+    size_t index = (payload[2] << 8) | payload[3];
+    uint8_t status = payload[4];
+    size_t programmed = std::min<size_t>((payload[5] << 8) | payload[6], next_block_);
+    if (index >= blocks_.size() || !blocks_[index].sent) return true;
+    last_progress_ = now;
+    if (status == protocol::kFirmwareCrcError && !blocks_[index].confirmed) {
+      Resend(index, now, out);
+    } else if (status != protocol::kFirmwareOk &&
+               status != protocol::kFirmwareCrcError) {
+      Fail("ECU rejected block " + std::to_string(index));
+      return true;
+    }
+    if (state_ != State::kWriting) return true;
+    // The count of leading blocks programmed also confirms blocks whose own
+    // answer was lost
+    if (status == protocol::kFirmwareOk) Confirm(index);
+    for (; programmed_ < programmed; ++programmed_) Confirm(programmed_);
+    if (bytes_confirmed_ == image_.size()) {
+      state_ = State::kFinishing;
+      control_retries_ = 0;
+      SendControl(now, out);
+    } else {
+      FillWindow(now, out);
+    }
+  } else if (op == protocol::kFirmwareFinish && state_ == State::kFinishing) {
+    uint8_t status = payload[2];
+    bool hash_match = payload.size() >= 3u + protocol::kFirmwareHashSize &&
+                      std::equal(hash_.begin(), hash_.end(), payload.begin() + 3);
+    if (status == protocol::kFirmwareOk && hash_match) {
+      state_ = State::kDone;
+    } else if (status == protocol::kFirmwareIncomplete) {
+      Fail("ECU reports blocks missing");
+    } else {
+      Fail("image hash mismatch");
+    }
+  }
+  return true;
+}
+
+void FirmwareUpload::Poll(Clock::time_point now, Frames& out) {
+  if (state_ == State::kBeginning || state_ == State::kFinishing) {
+    if (now - control_sent_ < config_.timeout) return;
+    if (control_retries_++ >= config_.max_retries) {
+      Fail(state_ == State::kBeginning ? "no answer to begin" : "no answer to finish");
+      return;
+    }
+    SendControl(now, out);
+  } else if (state_ == State::kWriting) {
+    for (size_t i = 0; i < next_block_ && state_ == State::kWriting; ++i) {
+      const Block& block = blocks_[i];
+      if (block.confirmed ||
+          now - std::max(block.sent_at, last_progress_) < config_.timeout) {
+        continue;
+      }
+      Resend(i, now, out);
+    }
+  }
+}
+
+void FirmwareUpload::Abort(Frames& out) {
+  if (!active()) return;
+  out.push_back({protocol::kFirmware, protocol::kFirmwareAbort});
+  Fail("aborted");
+}
+
+void FirmwareUpload::FillWindow(Clock::time_point now, Frames& out) {
+  while (outstanding_ < config_.window && next_block_ < blocks_.size()) {
+    ++outstanding_;
+    SendBlock(next_block_++, now, out);
+  }
+}
+
+void FirmwareUpload::SendBlock(size_t index, Clock::time_point now,
+                               Frames& out) {
+  size_t offset = index * config_.block_size;
+  size_t len = std::min(config_.block_size, image_.size() - offset);
+  const uint8_t* data = image_.data() + offset;
+
+  std::vector<uint8_t> request;
+  request.reserve(protocol::kFirmwareWriteHeaderSize + len);
+  request.push_back(protocol::kFirmware);
+  request.push_back(protocol::kFirmwareWrite);
+  PutBe16(request, static_cast<uint32_t>(index));
+  PutBe32(request, Crc32(data, len));
+  request.insert(request.end(), data, data + len);
+  out.push_back(std::move(request));
+
+  blocks_[index].sent = true;
+  blocks_[index].sent_at = now;
+}
+
+void FirmwareUpload::SendControl(Clock::time_point now, Frames& out) {
+  std::vector<uint8_t> request{protocol::kFirmware};
+  if (state_ == State::kBeginning) {
+    request.push_back(protocol::kFirmwareBegin);
+    PutBe32(request, static_cast<uint32_t>(image_.size()));
+    PutBe16(request, static_cast<uint32_t>(config_.block_size));
+  } else {
+    request.push_back(protocol::kFirmwareFinish);
+    request.insert(request.end(), hash_.begin(), hash_.end());
+  }
+  out.push_back(std::move(request));
+  control_sent_ = now;
+}
+
+void FirmwareUpload::Confirm(size_t index) {
+  if (blocks_[index].confirmed) return;
+  blocks_[index].confirmed = true;
+  --outstanding_;
+  bytes_confirmed_ += std::min(config_.block_size,
+                               image_.size() - index * config_.block_size);
+}
+
+void FirmwareUpload::Resend(size_t index, Clock::time_point now, Frames& out) {
+  Block& block = blocks_[index];
+  if (block.retries++ >= config_.max_retries) {
+    Fail("block " + std::to_string(index) + " failed " +
+         std::to_string(block.retries) + " times");
+    return;
+  }
+  ++blocks_resent_;
+  SendBlock(index, now, out);
+}
+
+void FirmwareUpload::Fail(const std::string& error) {
+  state_ = State::kFailed;
+  error_ = error;
+}
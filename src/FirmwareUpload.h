@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Checksums.h"
+
+// Host side of the firmware command (see doc/protocol.md): streams an image
+// as blocks with a CRC-32 each, keeping several blocks outstanding so the
+// ECU programs one while the next is still on the line. Blocks the ECU
+// fails to program are sent again on their own; the upload ends with the
+// ECU checking the image against its SHA-256.
+//
+// Blocks larger than a frame travel segmented (see Segmenter), which
+// already retransmits frames lost on the line. Transport-agnostic and not
+// thread-safe: the caller sends the requests appended to out, feeds in the
+// responses and calls Poll() regularly.
+class FirmwareUpload {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Frames = std::vector<std::vector<uint8_t>>;
+
+  struct Config {
+    size_t block_size = 4096;
+    size_t window = 4;    // Blocks sent but not yet confirmed
+    int max_retries = 3;  // Per block, and for begin and finish
+    // Resend what is outstanding after this long without a response; must
+    // cover a block's time on the line plus programming
+    Clock::duration timeout = std::chrono::seconds(1);
+  };
+
+  enum class State { kIdle, kBeginning, kWriting, kFinishing, kDone, kFailed };
+
+  FirmwareUpload();
+  explicit FirmwareUpload(const Config& config);
+
+  // Timeout for blocks of block_size at baud: a few block times plus slack
+  // for the adapter and programming
+  static Clock::duration TimeoutFor(size_t block_size, int baud);
+
+  // Appends the begin request; false if the image is empty, the block size
+  // is out of range or the image needs more than 65535 blocks
+  bool Start(std::vector<uint8_t> image, Clock::time_point now, Frames& out);
+  // Consumes firmware responses, returns false for any other payload
+  bool OnResponse(const std::vector<uint8_t>& payload, Clock::time_point now,
+                  Frames& out);
+  void Poll(Clock::time_point now, Frames& out);
+  // Tells the ECU to discard the partial image
+  void Abort(Frames& out);
+
+  State state() const { return state_; }
+  bool active() const {
+    return state_ == State::kBeginning || state_ == State::kWriting ||
+           state_ == State::kFinishing;
+  }
+  size_t image_size() const { return image_.size(); }
+  // Image bytes the ECU has programmed and verified
+  size_t bytes_confirmed() const { return bytes_confirmed_; }
+  size_t blocks_resent() const { return blocks_resent_; }
+  const Sha256::Digest& image_hash() const { return hash_; }
+  // Why the upload failed
+  const std::string& error() const { return error_; }
+
+ private:
+  struct Block {
+    bool sent = false;
+    bool confirmed = false;
+    Clock::time_point sent_at;
+    int retries = 0;
+  };
+
+  void FillWindow(Clock::time_point now, Frames& out);
+  void SendBlock(size_t index, Clock::time_point now, Frames& out);
+  void SendControl(Clock::time_point now, Frames& out);
+  void Confirm(size_t index);
+  void Resend(size_t index, Clock::time_point now, Frames& out);
+  void Fail(const std::string& error);
+
+  Config config_;
+  State state_ = State::kIdle;
+  std::vector<uint8_t> image_;
+  Sha256::Digest hash_{};
+  std::vector<Block> blocks_;
+  size_t next_block_ = 0;
+  size_t outstanding_ = 0;
+  size_t programmed_ = 0;  // Leading blocks the ECU reported programmed
+  size_t bytes_confirmed_ = 0;
+  size_t blocks_resent_ = 0;
+  // Begin and finish: when last sent and how often
+  Clock::time_point control_sent_;
+  int control_retries_ = 0;
+  // Blocks queue behind each other on the line, so timeouts run from the
+  // later of their transmission and the last response
+  Clock::time_point last_progress_;
+  std::string error_;
+};
@@ -0,0 +1,313 @@
+#include "FleetPanel.h"
+#include "ECUConnector.h"
+#include "IoReactor.h"
+#include "RenderGate.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QPainterPath>
+#include <QScrollArea>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+QColor AlarmColor(UnitMonitor::Alarm alarm) {
+    switch (alarm) {
+    case UnitMonitor::Alarm::kOk: return QColor(0, 160, 0);
+    case UnitMonitor::Alarm::kGaps: return QColor(230, 180, 0);
+    case UnitMonitor::Alarm::kErrors: return QColor(230, 110, 0);
+    case UnitMonitor::Alarm::kStale: return QColor(210, 0, 0);
+    case UnitMonitor::Alarm::kDisconnected: return Qt::gray;
+    }
+    return Qt::gray;
+}
+
+QString AlarmText(UnitMonitor::Alarm alarm) {
+    switch (alarm) {
+    case UnitMonitor::Alarm::kOk: return "OK";
+    case UnitMonitor::Alarm::kGaps: return "Gaps";
+    case UnitMonitor::Alarm::kErrors: return "Errors";
+    case UnitMonitor::Alarm::kStale: return "No data";
+    case UnitMonitor::Alarm::kDisconnected: return "Disconnected";
+    }
+    return QString();
+}
+
+}  // namespace
+
+// --- FleetTile ---
+
+FleetTile::FleetTile(const QString &name, QWidget *parent)
+    : QWidget(parent), name_(name) {
+    setMinimumSize(220, 130);
+    setToolTip(name);
+}
+
+void FleetTile::SetName(const QString &name) {
+    name_ = name;
+    setToolTip(name);
+    update();
+}
+
+void FleetTile::SetSnapshot(UnitMonitor::Snapshot snapshot) {
+    snapshot_ = std::move(snapshot);
+    QString tip = name_;
+    if (!snapshot_.last_error.empty()) tip += "\nLast error: " + QString::fromStdString(snapshot_.last_error);
+    setToolTip(tip);
+    update();
+}
+
+void FleetTile::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    QColor alarmColor = AlarmColor(snapshot_.alarm);
+    painter.fillRect(rect(), palette().base());
+    painter.fillRect(QRect(0, 0, 6, height()), alarmColor);
+    painter.setPen(palette().mid().color());
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+
+    QRect text = rect().adjusted(12, 4, -6, 0);
+    QFont bold = font();
+    bold.setBold(true);
+    painter.setFont(bold);
+    painter.setPen(palette().text().color());
+    painter.drawText(text, Qt::AlignLeft | Qt::AlignTop, name_);
+    painter.setPen(alarmColor);
+    painter.drawText(text, Qt::AlignRight | Qt::AlignTop, AlarmText(snapshot_.alarm));
+    painter.setFont(font());
+    painter.setPen(palette().text().color());
+    int lineHeight = fontMetrics().height();
+    painter.drawText(text.adjusted(0, lineHeight, 0, 0), Qt::AlignLeft | Qt::AlignTop,
+                     QString("%1 Hz  gaps %2  errors %3")
+                         .arg(snapshot_.sample_rate_hz, 0, 'f', 0)
+                         .arg(qulonglong(snapshot_.gaps))
+                         .arg(qulonglong(snapshot_.errors)));
+
+    // RPM sparklines, all motors on one scale
+    QRectF plot = QRectF(rect()).adjusted(12, 2 * lineHeight + 10, -6, -lineHeight - 6);
+    float peak = 1;
+    for (const auto &rpm : snapshot_.rpm) {
+        for (float v : rpm) {
+            if (!std::isnan(v)) peak = std::max(peak, std::fabs(v));
+        }
+    }
+    painter.setPen(palette().midlight().color());
+    painter.drawLine(QPointF(plot.left(), plot.center().y()), QPointF(plot.right(), plot.center().y()));
+    const QColor colors[] = {Qt::red, Qt::blue, QColor(0, 160, 0), QColor("orange")};
+    QString latest;
+    for (int m = 0; m < 4; ++m) {
+        const std::vector<float> &rpm = snapshot_.rpm[m];
+        if (rpm.size() < 2) continue;
+        qreal dx = plot.width() / (rpm.size() - 1);
+        QPainterPath path;
+        bool penDown = false;
+        for (size_t i = 0; i < rpm.size(); ++i) {
+            // Buckets without samples break the line
+            if (std::isnan(rpm[i])) {
+                penDown = false;
+                continue;
+            }
+            QPointF point(plot.left() + i * dx, plot.center().y() - rpm[i] / peak * plot.height() / 2);
+            if (penDown) {
+                path.lineTo(point);
+            } else {
+                path.moveTo(point);
+                penDown = true;
+            }
+        }
+        painter.setPen(QPen(colors[m], 1));
+        painter.drawPath(path);
+        latest += QString(" %1").arg(std::isnan(rpm.back()) ? 0.0 : rpm.back(), 0, 'f', 0);
+    }
+    painter.setPen(palette().text().color());
+    painter.drawText(rect().adjusted(12, 0, -6, -4), Qt::AlignLeft | Qt::AlignBottom,
+                     QString("RPM%1  (±%2)").arg(latest).arg(peak, 0, 'f', 0));
+}
+
+// --- FleetPanel ---
+
+FleetPanel::FleetPanel(ECUConnector *dashboardConnector, QWidget *parent) : QWidget(parent) {
+    SetupUi();
+
+    // Not polled or subscribed here, so the dashboard's traffic is unchanged;
+    // the tile shows whatever encoder data the dashboard already receives
+    auto dashboard = std::make_unique<Unit>();
+    Unit *u = dashboard.get();
+    u->connector = dashboardConnector;
+    u->owned = false;
+    u->tile = new FleetTile("Dashboard");
+    tileLayout_->addWidget(u->tile, 0, 0);
+    Watch(u);
+    auto follow = [u] {
+        u->port = u->connector->Port();
+        u->tile->SetName(u->port.isEmpty() ? QString("Dashboard") : QString("%1 (dashboard)").arg(u->port));
+    };
+    connect(u->connector, &ECUConnector::ConnectionChanged, this, follow);
+    // The tab is built on first use, possibly long after the dashboard connected
+    follow();
+    u->monitor.SetConnected(u->connector->IsConnected(), std::chrono::steady_clock::now());
+    units_.push_back(std::move(dashboard));
+
+    pollTimer_ = new QTimer(this);
+    connect(pollTimer_, &QTimer::timeout, this, &FleetPanel::OnPollTimeout);
+    refreshTimer_ = new QTimer(this);
+    connect(refreshTimer_, &QTimer::timeout, this, &FleetPanel::RefreshTiles);
+    refreshTimer_->start(1000 / kRefreshHz);
+    renderGate_ = new RenderGate(this);
+    connect(renderGate_, &RenderGate::Opened, this, &FleetPanel::RefreshTiles);
+}
+
+FleetPanel::~FleetPanel() {
+    DisconnectAll();
+}
+
+void FleetPanel::SetupUi() {
+    auto *mainLayout = new QVBoxLayout(this);
+
+    auto *controlsLayout = new QHBoxLayout();
+    controlsLayout->addWidget(new QLabel("Ports:"));
+    portsEdit_ = new QLineEdit("/dev/ttyUSB0,/dev/ttyUSB1");
+    portsEdit_->setToolTip("Comma-separated serial ports, one per rover");
+    controlsLayout->addWidget(portsEdit_, 1);
+    controlsLayout->addWidget(new QLabel("Baud:"));
+    baudSpin_ = new QSpinBox();
+    baudSpin_->setRange(9600, 4000000);
+    baudSpin_->setValue(115200);
+    controlsLayout->addWidget(baudSpin_);
+    controlsLayout->addWidget(new QLabel("Rate (Hz):"));
+    rateSpin_ = new QSpinBox();
+    rateSpin_->setToolTip("Encoder stream rate, or poll rate for firmware without streaming");
+    rateSpin_->setRange(1, 100);
+    rateSpin_->setValue(20);
+    controlsLayout->addWidget(rateSpin_);
+    controlsLayout->addWidget(new QLabel("Ticks/Rev:"));
+    ticksSpin_ = new QSpinBox();
+    ticksSpin_->setRange(1, 10000);
+    ticksSpin_->setValue(1328);
+    controlsLayout->addWidget(ticksSpin_);
+    connectButton_ = new QPushButton("Connect All");
+    connect(connectButton_, &QPushButton::clicked, this, &FleetPanel::OnConnectClicked);
+    controlsLayout->addWidget(connectButton_);
+    mainLayout->addLayout(controlsLayout);
+    skippedLabel_ = new QLabel();
+    skippedLabel_->hide();
+    mainLayout->addWidget(skippedLabel_);
+
+    auto *scrollArea = new QScrollArea();
+    scrollArea->setWidgetResizable(true);
+    scrollArea->setFrameShape(QFrame::NoFrame);
+    auto *tiles = new QWidget();
+    tileLayout_ = new QGridLayout(tiles);
+    tileLayout_->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+    scrollArea->setWidget(tiles);
+    mainLayout->addWidget(scrollArea, 1);
+}
+
+void FleetPanel::OnConnectClicked() {
+    if (!reactor_) {
+        ConnectAll();
+    } else {
+        DisconnectAll();
+    }
+}
+
+void FleetPanel::ConnectAll() {
+    QStringList ports = portsEdit_->text().split(',', Qt::SkipEmptyParts);
+    if (ports.isEmpty()) return;
+    reactor_ = std::make_unique<IoReactor>();
+    reactor_->Start();
+
+    UnitMonitor::Config config;
+    config.ticks_per_rev = ticksSpin_->value();
+    int rateHz = rateSpin_->value();
+    QStringList skipped;
+    for (const QString &entry : ports) {
+        QString port = entry.trimmed();
+        // A port is only opened once; the dashboard's has its own tile. Ports
+        // open in other programs are refused by the transport's lock.
+        bool taken = false;
+        for (const auto &unit : units_) taken = taken || unit->port == port;
+        if (taken) {
+            skipped << port;
+            continue;
+        }
+        auto unit = std::make_unique<Unit>();
+        Unit *u = unit.get();
+        u->port = port;
+        u->monitor = UnitMonitor(config);
+        u->connector = new ECUConnector(this);
+        u->tile = new FleetTile(u->port);
+        int index = static_cast<int>(units_.size());
+        tileLayout_->addWidget(u->tile, index / kColumns, index % kColumns);
+        Watch(u);
+        u->connector->Connect(u->port, baudSpin_->value(), reactor_.get());
+        // Applied once the API version is known; older firmware is polled
+        u->connector->RequestStreams(protocol::kStreamEncoders, rateHz);
+        units_.push_back(std::move(unit));
+    }
+    pollTimer_->start(1000 / rateHz);
+    skippedLabel_->setText("Already open, not connected again: " + skipped.join(", "));
+    skippedLabel_->setVisible(!skipped.isEmpty());
+    connectButton_->setText("Disconnect All");
+    portsEdit_->setEnabled(false);
+    RefreshTiles();
+}
+
+void FleetPanel::DisconnectAll() {
+    pollTimer_->stop();
+    // Close the ports while the reactor still exists; the dashboard's unit stays
+    for (auto it = units_.begin(); it != units_.end();) {
+        Unit *unit = it->get();
+        if (!unit->owned) {
+            ++it;
+            continue;
+        }
+        unit->connector->Disconnect();
+        delete unit->connector;
+        delete unit->tile;
+        it = units_.erase(it);
+    }
+    reactor_.reset();
+    skippedLabel_->hide();
+    connectButton_->setText("Connect All");
+    portsEdit_->setEnabled(true);
+}
+
+void FleetPanel::Watch(Unit *u) {
+    // The same telemetry paths as the dashboard, condensed per unit
+    connect(u->connector, &ECUConnector::ConnectionChanged, this, [u](bool connected) {
+        u->monitor.SetConnected(connected, std::chrono::steady_clock::now());
+    });
+    connect(u->connector, &ECUConnector::EncoderValuesUpdated, this, [u](const std::vector<float> &values) {
+        if (values.size() >= 4) u->monitor.OnEncoders(values.data(), u->connector->SampleTime());
+    });
+    connect(u->connector, &ECUConnector::StreamGapDetected, this, [u](uint8_t, int missed) {
+        u->monitor.OnGap(missed, std::chrono::steady_clock::now());
+    });
+    connect(u->connector, &ECUConnector::ErrorOccurred, this, [u](const QString &message) {
+        u->monitor.OnError(message.toStdString(), std::chrono::steady_clock::now());
+    });
+}
+
+void FleetPanel::OnPollTimeout() {
+    for (auto &unit : units_) {
+        ECUConnector *connector = unit->connector;
+        if (!unit->owned || !connector->IsConnected() || connector->IsStreaming(protocol::kStreamEncoders)) continue;
+        if (connector->SupportsTelemetry()) {
+            connector->GetTelemetry(protocol::kFieldEncoders);
+        } else {
+            connector->GetAllEncoders();
+        }
+    }
+}
+
+void FleetPanel::RefreshTiles() {
+    // Hidden tab or minimised window: the monitors keep counting, the tiles wait
+    if (!renderGate_->IsOpen()) return;
+    auto now = std::chrono::steady_clock::now();
+    for (auto &unit : units_) {
+        unit->tile->SetSnapshot(unit->monitor.TakeSnapshot(now));
+    }
+}
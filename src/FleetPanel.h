@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QWidget>
+#include <QGridLayout>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+#include <memory>
+#include <vector>
+#include "UnitMonitor.h"
+
+class ECUConnector;
+class QLabel;
+class IoReactor;
+class RenderGate;
+
+// One rover in the fleet overview: name, alarm colour, link figures and a
+// sparkline of each motor's RPM, painted from a UnitMonitor snapshot
+class FleetTile : public QWidget {
+    Q_OBJECT
+public:
+    explicit FleetTile(const QString &name, QWidget *parent = nullptr);
+
+    void SetName(const QString &name);
+    void SetSnapshot(UnitMonitor::Snapshot snapshot);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QString name_;
+    UnitMonitor::Snapshot snapshot_;
+};
+
+// Compact grid with one tile per ECU, for watching many units under test at
+// once. Every listed unit has its own connector on a shared I/O thread and
+// streams (or is polled for) its encoders; the tiles only show decimated
+// history and are refreshed a few times per second, so a tile costs a
+// fraction of a full dashboard. The unit the dashboard is connected to gets
+// the first tile, fed from the dashboard's connector and never opened twice.
+class FleetPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit FleetPanel(ECUConnector *dashboardConnector, QWidget *parent = nullptr);
+    ~FleetPanel();
+
+private slots:
+    void OnConnectClicked();
+    void OnPollTimeout();
+    void RefreshTiles();
+
+private:
+    struct Unit {
+        QString port;
+        ECUConnector *connector = nullptr;
+        // False for the dashboard's connector, which the panel only watches
+        bool owned = true;
+        UnitMonitor monitor;
+        FleetTile *tile = nullptr;
+    };
+
+    void SetupUi();
+    void Watch(Unit *unit);
+    void ConnectAll();
+    void DisconnectAll();
+
+    QLineEdit *portsEdit_;
+    QSpinBox *baudSpin_;
+    QSpinBox *rateSpin_;
+    QSpinBox *ticksSpin_;
+    QPushButton *connectButton_;
+    QLabel *skippedLabel_;
+    QGridLayout *tileLayout_;
+    QTimer *pollTimer_;
+    QTimer *refreshTimer_;
+    RenderGate *renderGate_;
+
+    std::unique_ptr<IoReactor> reactor_;
+    // The dashboard's unit first, then the ones connected here
+    std::vector<std::unique_ptr<Unit>> units_;
+
+    static constexpr int kColumns = 4;
+    static constexpr int kRefreshHz = 4;
+};
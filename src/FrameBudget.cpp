@@ -0,0 +1,43 @@
+#include "FrameBudget.h"
+
+#include <algorithm>
+
+FrameBudget::FrameBudget(const Config& config)
+    : config_(config), restore_hold_(config.restore_hold) {}
+
+bool FrameBudget::AddFrame(Clock::duration paint, Clock::time_point now) {
+  double ms = std::chrono::duration<double, std::milli>(paint).count();
+  average_ms_ = average_ms_ < 0 ? ms : average_ms_ + config_.smoothing * (ms - average_ms_);
+  double budget_ms =
+      std::chrono::duration<double, std::milli>(config_.budget).count();
+
+  if (average_ms_ > budget_ms) {
+    headroom_ = false;
+    if (level_ >= config_.max_level || now - last_change_ < config_.degrade_hold) {
+      return false;
+    }
+    // Restored too early: back off before trying again
+    if (last_change_was_restore_ && now - last_change_ < restore_hold_) {
+      restore_hold_ = std::min(restore_hold_ * 2, config_.max_restore_hold);
+    }
+    ++level_;
+    last_change_ = now;
+    last_change_was_restore_ = false;
+    return true;
+  }
+
+  if (average_ms_ >= budget_ms / 2 || level_ == 0) {
+    headroom_ = false;
+    return false;
+  }
+  if (!headroom_) {
+    headroom_ = true;
+    headroom_since_ = now;
+  }
+  if (now - headroom_since_ < restore_hold_) return false;
+  --level_;
+  last_change_ = now;
+  last_change_was_restore_ = true;
+  headroom_since_ = now;
+  return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+
+// Trades render quality for frame time. Fed with the paint time of every
+// chart frame, it steps the quality level down (0 = full quality, higher =
+// cheaper) while the smoothed paint time is over budget, and back up after
+// a sustained stretch of headroom. A level that was restored and had to be
+// dropped again soon after waits twice as long before the next restore, so
+// quality does not oscillate on a machine that is just at the limit.
+// RenderQuality owns it on the GUI thread and feeds it the paint time each
+// TimedChartView measures, stamped with steady_clock::now() as the paint ends.
+class FrameBudget {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Config {
+    Clock::duration budget = std::chrono::milliseconds(8);  // Per frame
+    int max_level = 3;
+    double smoothing = 0.2;  // Weight of the newest frame in the average
+    // Least time between two steps down, so a step can take effect first
+    Clock::duration degrade_hold = std::chrono::milliseconds(500);
+    // Time under half the budget before a step up
+    Clock::duration restore_hold = std::chrono::seconds(3);
+    Clock::duration max_restore_hold = std::chrono::seconds(60);
+  };
+
+  FrameBudget() = default;
+  explicit FrameBudget(const Config& config);
+
+  // True when the frame changed level()
+  bool AddFrame(Clock::duration paint, Clock::time_point now);
+
+  int level() const { return level_; }
+  double average_ms() const { return average_ms_; }
+
+ private:
+  Config config_;
+  int level_ = 0;
+  double average_ms_ = -1;  // < 0 until the first frame
+  Clock::time_point last_change_;
+  bool last_change_was_restore_ = false;
+  bool headroom_ = false;
+  Clock::time_point headroom_since_;
+  Clock::duration restore_hold_ = config_.restore_hold;
+};
@@ -0,0 +1,250 @@
+#include "FrameCodec.h"
+
+#include <array>
+#include <cstring>
+
+namespace {
+
+// CRC-16/MODBUS (reflected polynomial 0xA001), one table lookup per byte
+constexpr std::array<uint16_t, 256> MakeCrcTable() {
+  std::array<uint16_t, 256> table{};
+  for (int n = 0; n < 256; ++n) {
+    uint16_t crc = n;
+    for (int i = 0; i < 8; ++i) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    table[n] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint16_t, 256> kCrcTable = MakeCrcTable();
+
+}  // namespace
+
+FrameCodec::FrameCodec() : legacy_buffer_(65536) {
+  cobs_frame_.reserve(kMaxCobsFrame + 1);
+}
+
+bool FrameCodec::Encode(Framing framing, const uint8_t* payload, size_t len,
+                        std::vector<uint8_t>& out) {
+  if (len == 0 || len > kMaxPayload) return false;
+
+  if (framing == Framing::kLegacy) {
+    size_t start = out.size();
+    out.push_back(0xAA);
+    out.push_back(static_cast<uint8_t>(len + 3));
+    out.insert(out.end(), payload, payload + len);
+    uint16_t crc = Crc16(&out[start + 1], len + 1);
+    out.push_back(crc & 0xFF);
+    out.push_back((crc >> 8) & 0xFF);
+    return true;
+  }
+
+  uint16_t crc = Crc16(payload, len);
+  const uint8_t crc_bytes[2] = {static_cast<uint8_t>(crc & 0xFF),
+                                static_cast<uint8_t>((crc >> 8) & 0xFF)};
+
+  // Single pass: each block starts with a code byte holding the distance to
+  // the next zero, patched once the block ends
+  size_t start = out.size();
+  out.resize(start + len + 2 + 2 + 1);
+  uint8_t* dst = out.data() + start;
+  uint8_t* code = dst++;
+  uint8_t run = 1;
+  auto put = [&](uint8_t byte) {
+    if (byte == 0) {
+      *code = run;
+      code = dst++;
+      run = 1;
+      return;
+    }
+    *dst++ = byte;
+    if (++run == 0xFF) {
+      *code = run;
+      code = dst++;
+      run = 1;
+    }
+  };
+  for (size_t i = 0; i < len; ++i) put(payload[i]);
+  put(crc_bytes[0]);
+  put(crc_bytes[1]);
+  *code = run;
+  *dst++ = 0x00;
+  out.resize(dst - out.data());
+  return true;
+}
+
+uint16_t FrameCodec::Crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t pos = 0; pos < len; pos++) {
+    crc = (crc >> 8) ^ kCrcTable[(crc ^ data[pos]) & 0xFF];
+  }
+  return crc;
+}
+
+void FrameCodec::SetFraming(Framing framing) {
+  framing_ = framing;
+  // From a handler, Feed() hands the unparsed bytes over to the new framing
+  if (feeding_) return;
+  legacy_buffer_.Clear();
+  cobs_frame_.clear();
+  cobs_discard_ = false;
+}
+
+void FrameCodec::Feed(const uint8_t* data, size_t len,
+                      const FrameHandler& handler) {
+  bool outer = !feeding_;
+  feeding_ = true;
+  if (framing_ == Framing::kLegacy) {
+    FeedLegacy(data, len, handler);
+  } else {
+    FeedCobs(data, len, handler);
+  }
+  if (outer) feeding_ = false;
+}
+
+void FrameCodec::FeedLegacy(const uint8_t* data, size_t len,
+                            const FrameHandler& handler) {
+  legacy_buffer_.Push(data, len);
+
+  while (legacy_buffer_.Size() >= 2) {
+    if (legacy_buffer_.Peek(0) != 0xAA) {
+      legacy_buffer_.Pop(1);
+      continue;
+    }
+
+    uint8_t len_byte = legacy_buffer_.Peek(1);
+    if (len_byte < 3) {
+      legacy_buffer_.Pop(1);
+      continue;
+    }
+
+    size_t total_len = 1 + len_byte;
+
+    if (legacy_buffer_.Size() < total_len) {
+      break;
+    }
+
+    std::vector<uint8_t> frame(total_len);
+    for (size_t i = 0; i < total_len; ++i) {
+      frame[i] = legacy_buffer_.Peek(i);
+    }
+
+    uint16_t received_crc = frame[total_len - 2] | (frame[total_len - 1] << 8);
+    uint16_t calculated_crc = Crc16(&frame[1], len_byte - 2);
+
+    if (received_crc == calculated_crc) {
+      std::vector<uint8_t> payload;
+      if (len_byte > 3) {
+        payload.assign(frame.begin() + 2, frame.end() - 2);
+      }
+      legacy_buffer_.Pop(total_len);
+      handler(payload, frame.data(), frame.size());
+
+      if (framing_ != Framing::kLegacy) {
+        // Switched by the handler: the rest is already in the new framing
+        std::vector<uint8_t> rest(legacy_buffer_.Size());
+        for (size_t i = 0; i < rest.size(); ++i) rest[i] = legacy_buffer_.Peek(i);
+        legacy_buffer_.Clear();
+        Feed(rest.data(), rest.size(), handler);
+        return;
+      }
+    } else {
+      ++crc_errors_;
+      legacy_buffer_.Pop(1);
+    }
+  }
+}
+
+void FrameCodec::FeedCobs(const uint8_t* data, size_t len,
+                          const FrameHandler& handler) {
+  const uint8_t* end = data + len;
+  while (data < end) {
+    // Copy whole runs up to the next delimiter instead of byte by byte
+    const uint8_t* zero =
+        static_cast<const uint8_t*>(std::memchr(data, 0, end - data));
+    const uint8_t* run_end = zero ? zero : end;
+    size_t run = run_end - data;
+    if (!cobs_discard_) {
+      if (cobs_frame_.size() + run > kMaxCobsFrame) {
+        cobs_discard_ = true;
+        cobs_frame_.clear();
+      } else {
+        cobs_frame_.insert(cobs_frame_.end(), data, run_end);
+      }
+    }
+    if (!zero) return;
+
+    data = zero + 1;
+    if (!cobs_discard_ && !cobs_frame_.empty()) DecodeCobsFrame(handler);
+    cobs_frame_.clear();
+    cobs_discard_ = false;
+
+    if (framing_ != Framing::kCobs) {
+      Feed(data, end - data, handler);
+      return;
+    }
+  }
+}
+
+void FrameCodec::DecodeCobsFrame(const FrameHandler& handler) {
+  const uint8_t* src = cobs_frame_.data();
+  size_t n = cobs_frame_.size();
+  // Code byte, at least one payload byte and the CRC
+  if (n < 4) {
+    ++crc_errors_;
+    return;
+  }
+  // Decoded output is never longer than the encoded frame
+  std::vector<uint8_t> payload(n);
+  size_t decoded = 0;
+
+  // Without 0xFF codes every code byte after the first stands for a zero, so
+  // the frame decodes as one copy plus a walk over the code bytes. Telemetry
+  // has short runs, where a copy per run costs a mispredicted branch each.
+  std::memcpy(payload.data(), src + 1, n - 1);
+  size_t pos = 0;
+  while (pos < n && src[pos] != 0xFF) {
+    if (src[pos] == 0) break;
+    if (pos > 0) payload[pos - 1] = 0;
+    pos += src[pos];
+  }
+  if (pos == n) {
+    decoded = n - 1;
+  } else if (pos < n && src[pos] == 0xFF) {
+    // Runs of 254 non-zero bytes: decode block by block
+    const uint8_t* p = src;
+    const uint8_t* end = src + n;
+    uint8_t* dst = payload.data();
+    while (p < end) {
+      uint8_t code = *p++;
+      size_t run = code - 1;
+      if (code == 0 || run > static_cast<size_t>(end - p)) {
+        ++crc_errors_;
+        return;
+      }
+      std::memcpy(dst, p, run);
+      dst += run;
+      p += run;
+      // A code below 0xFF stands for a zero, except at the very end
+      if (code != 0xFF && p < end) *dst++ = 0;
+    }
+    decoded = dst - payload.data();
+  }
+
+  if (decoded < 3) {
+    ++crc_errors_;
+    return;
+  }
+  size_t payload_len = decoded - 2;
+  uint16_t received_crc = payload[payload_len] | (payload[payload_len + 1] << 8);
+  if (received_crc != Crc16(payload.data(), payload_len)) {
+    ++crc_errors_;
+    return;
+  }
+
+  payload.resize(payload_len);
+  cobs_frame_.push_back(0x00);  // Report the frame with its delimiter
+  handler(payload, cobs_frame_.data(), cobs_frame_.size());
+}
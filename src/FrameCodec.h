@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CircularBuffer.h"
+
+// Frame encoding and incremental decoding for the serial link.
+//
+// kLegacy: [0xAA] [Length] [Payload...] [CRC_L] [CRC_H]; Length counts
+//          itself, the payload and the CRC, which covers Length and payload.
+// kCobs:   COBS([Payload...] [CRC_L] [CRC_H]) [0x00]; the CRC covers the
+//          payload. Zero bytes only occur as delimiters, so a corrupted frame
+//          never costs more than itself.
+class FrameCodec {
+ public:
+  enum class Framing { kLegacy, kCobs };
+
+  // Largest payload either framing carries (limited by the legacy length byte)
+  static constexpr size_t kMaxPayload = 252;
+
+  // Receives each valid frame: its payload (may be moved from) and the raw
+  // frame bytes as received. May call SetFraming() to switch mid-stream.
+  using FrameHandler = std::function<void(std::vector<uint8_t>& payload,
+                                          const uint8_t* frame, size_t len)>;
+
+  FrameCodec();
+
+  // Appends the encoded frame to out; false if the payload is empty or
+  // larger than kMaxPayload
+  static bool Encode(Framing framing, const uint8_t* payload, size_t len,
+                     std::vector<uint8_t>& out);
+  static uint16_t Crc16(const uint8_t* data, size_t len);
+
+  // Drops any partially received frame; from inside a handler the bytes
+  // after the current frame are decoded in the new framing instead
+  void SetFraming(Framing framing);
+  Framing framing() const { return framing_; }
+
+  void Feed(const uint8_t* data, size_t len, const FrameHandler& handler);
+
+  uint64_t crc_errors() const { return crc_errors_; }
+
+ private:
+  // Encoded payload + CRC + COBS overhead
+  static constexpr size_t kMaxCobsFrame = kMaxPayload + 2 + 2;
+
+  void FeedLegacy(const uint8_t* data, size_t len, const FrameHandler& handler);
+  void FeedCobs(const uint8_t* data, size_t len, const FrameHandler& handler);
+  void DecodeCobsFrame(const FrameHandler& handler);
+
+  Framing framing_ = Framing::kLegacy;
+  CircularBuffer legacy_buffer_;
+  std::vector<uint8_t> cobs_frame_;  // Encoded bytes since the last delimiter
+  bool cobs_discard_ = false;        // Oversized frame, skip to the delimiter
+  bool feeding_ = false;
+  uint64_t crc_errors_ = 0;
+};
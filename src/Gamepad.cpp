@@ -0,0 +1,200 @@
+#include "Gamepad.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+
+namespace {
+
+constexpr int kAxisCodes[2] = {ABS_X, ABS_Y};
+
+bool TestBit(const unsigned long* bits, int bit) {
+  constexpr int kBitsPerLong = 8 * sizeof(unsigned long);
+  return bits[bit / kBitsPerLong] & (1UL << (bit % kBitsPerLong));
+}
+
+bool HasStick(int fd) {
+  unsigned long abs_bits[ABS_MAX / (8 * sizeof(unsigned long)) + 1] = {};
+  if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) < 0) return false;
+  return TestBit(abs_bits, ABS_X) && TestBit(abs_bits, ABS_Y);
+}
+
+bool HasPadButtons(int fd) {
+  unsigned long key_bits[KEY_MAX / (8 * sizeof(unsigned long)) + 1] = {};
+  if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) < 0) return false;
+  return TestBit(key_bits, BTN_GAMEPAD) || TestBit(key_bits, BTN_JOYSTICK);
+}
+
+}  // namespace
+
+Gamepad::Gamepad(const std::string& device, const Config& config)
+    : config_(config), name_(device) {
+  fd_ = open(device.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd_ < 0) {
+    throw std::runtime_error("Error opening " + device);
+  }
+  if (!HasStick(fd_)) {
+    close(fd_);
+    throw std::runtime_error(device + " has no X/Y axes");
+  }
+  char name[128] = {};
+  if (ioctl(fd_, EVIOCGNAME(sizeof(name) - 1), name) > 0) name_ = name;
+  // Event timestamps on the monotonic clock, the base of steady_clock, so
+  // input latency can be measured from the moment the kernel saw the event
+  int clock = CLOCK_MONOTONIC;
+  ioctl(fd_, EVIOCSCLOCKID, &clock);
+  ReadAxes();
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    if (wake_fd_ >= 0) close(wake_fd_);
+    close(fd_);
+    throw std::runtime_error("Error creating epoll instance");
+  }
+  for (int fd : {fd_, wake_fd_}) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+}
+
+Gamepad::~Gamepad() {
+  Stop();
+  close(wake_fd_);
+  close(epoll_fd_);
+  close(fd_);
+}
+
+void Gamepad::Start(Callback callback) {
+  if (running_) return;
+  callback_ = std::move(callback);
+  running_ = true;
+  read_thread_ = std::thread(&Gamepad::ReadLoop, this);
+}
+
+void Gamepad::Stop() {
+  running_ = false;
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // The counter is already non-zero, the thread wakes up anyway
+  }
+  if (read_thread_.joinable()) read_thread_.join();
+}
+
+std::vector<std::string> Gamepad::FindDevices() {
+  std::vector<std::string> devices;
+  DIR* dir = opendir("/dev/input");
+  if (!dir) return devices;
+  while (dirent* entry = readdir(dir)) {
+    std::string file = entry->d_name;
+    if (file.rfind("event", 0) != 0) continue;
+    std::string path = "/dev/input/" + file;
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) continue;
+    if (HasStick(fd) && HasPadButtons(fd)) devices.push_back(path);
+    close(fd);
+  }
+  closedir(dir);
+  std::sort(devices.begin(), devices.end());
+  return devices;
+}
+
+double Gamepad::Shape(double value, double deadzone, double expo) {
+  double magnitude = std::fabs(value);
+  if (magnitude <= deadzone) return 0;
+  double s = std::min(1.0, (magnitude - deadzone) / (1 - deadzone));
+  s = (1 - expo) * s + expo * s * s * s;
+  return std::copysign(s, value);
+}
+
+void Gamepad::ReadLoop() {
+  epoll_event events[2];
+  while (running_) {
+    // No timeout: Stop() wakes the thread through wake_fd_
+    int n = epoll_wait(epoll_fd_, events, 2, -1);
+    if (n < 0 && errno != EINTR) break;
+    for (int i = 0; i < n && running_; ++i) {
+      if (events[i].data.fd != fd_) continue;
+      if (!ReadEvents()) {
+        // Unplugged: report a centred stick so the rover stops
+        State state;
+        state.time = std::chrono::steady_clock::now();
+        state.connected = false;
+        callback_(state);
+        running_ = false;
+      }
+    }
+  }
+}
+
+bool Gamepad::ReadEvents() {
+  input_event events[64];
+  while (true) {
+    ssize_t n = read(fd_, events, sizeof(events));
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    if (n == 0) return false;
+
+    for (size_t i = 0; i < n / sizeof(input_event); ++i) {
+      const input_event& ev = events[i];
+      if (ev.type == EV_ABS && !dropped_) {
+        for (int a = 0; a < 2; ++a) {
+          if (ev.code == kAxisCodes[a]) axes_[a].raw = ev.value;
+        }
+      } else if (ev.type == EV_SYN && ev.code == SYN_DROPPED) {
+        // The kernel buffer overflowed: ignore the rest of the report and
+        // read the current axis values instead
+        dropped_ = true;
+      } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+        if (dropped_) {
+          ReadAxes();
+          dropped_ = false;
+        }
+        Report(std::chrono::steady_clock::time_point(
+            std::chrono::seconds(ev.input_event_sec) +
+            std::chrono::microseconds(ev.input_event_usec)));
+      }
+    }
+  }
+}
+
+void Gamepad::ReadAxes() {
+  for (int a = 0; a < 2; ++a) {
+    input_absinfo info{};
+    if (ioctl(fd_, EVIOCGABS(kAxisCodes[a]), &info) < 0) continue;
+    if (info.maximum > info.minimum) {
+      axes_[a].min = info.minimum;
+      axes_[a].max = info.maximum;
+    }
+    axes_[a].raw = info.value;
+  }
+}
+
+double Gamepad::Normalize(const Axis& axis) const {
+  double centre = (axis.min + static_cast<double>(axis.max)) / 2;
+  double half = (axis.max - static_cast<double>(axis.min)) / 2;
+  return std::clamp((axis.raw - centre) / half, -1.0, 1.0);
+}
+
+void Gamepad::Report(std::chrono::steady_clock::time_point time) {
+  State state;
+  state.x = Shape(Normalize(axes_[0]), config_.deadzone, config_.expo);
+  state.y = Shape(Normalize(axes_[1]), config_.deadzone, config_.expo);
+  state.time = time;
+  // Button and trigger reports leave the stick where it was
+  if (state.x == last_.x && state.y == last_.y) return;
+  last_ = state;
+  callback_(state);
+}
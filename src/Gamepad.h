@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads a physical gamepad through Linux evdev (/dev/input/event*) on a
+// dedicated thread that sleeps in epoll until the device reports, so stick
+// movements are handled without going through the GUI event loop. The left
+// stick is shaped with a deadzone and an expo curve before it is reported.
+class Gamepad {
+ public:
+  struct Config {
+    double deadzone = 0.08;  // Share of the stick travel treated as centre
+    double expo = 0.3;       // 0 linear, 1 cubic: finer control near centre
+  };
+
+  // Stick position after shaping, -1 to 1 with y negative forward like
+  // VirtualJoystick. time is the kernel's event timestamp on the
+  // steady_clock time base.
+  struct State {
+    double x = 0;
+    double y = 0;
+    std::chrono::steady_clock::time_point time;
+    bool connected = true;  // False once when the device goes away
+  };
+
+  using Callback = std::function<void(const State&)>;
+
+  // Opens the event device; throws std::runtime_error if it cannot be
+  // opened or has no X/Y axes
+  Gamepad(const std::string& device, const Config& config);
+  ~Gamepad();
+
+  // callback runs on the input thread for every report that moves the
+  // shaped stick, and with a centred, disconnected state if the device is
+  // unplugged
+  void Start(Callback callback);
+  void Stop();
+
+  const std::string& name() const { return name_; }
+
+  // Event devices with X/Y axes and gamepad or joystick buttons
+  static std::vector<std::string> FindDevices();
+  // Deadzone removed and the rest rescaled to the full range, then expo
+  static double Shape(double value, double deadzone, double expo);
+
+ private:
+  struct Axis {
+    int min = -32768;
+    int max = 32767;
+    int raw = 0;
+  };
+
+  void ReadLoop();
+  // False when the device is gone
+  bool ReadEvents();
+  void ReadAxes();
+  double Normalize(const Axis& axis) const;
+  void Report(std::chrono::steady_clock::time_point time);
+
+  Config config_;
+  std::string name_;
+  int fd_ = -1;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  Axis axes_[2];  // X, Y
+  bool dropped_ = false;
+  State last_;
+  Callback callback_;
+  std::atomic<bool> running_{false};
+  std::thread read_thread_;
+};
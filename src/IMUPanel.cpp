@@ -1,18 +1,24 @@
 #include "IMUPanel.h"
+#include "RenderGate.h"
+#include "RenderQuality.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
+#include <QGridLayout>
+#include <QLabel>
 #include <QPainter>
-#include <QDateTime>
+#include <QScreen>
+#include <chrono>
 #include <cmath>
-#include <QtCharts/QChart>
-#include <QtCharts/QValueAxis>
 #include <algorithm>
+#include <limits>
 #include <QScrollArea>
 
-IMUPanel::IMUPanel(ECUConnector* connector, QWidget *parent)
-    : QWidget(parent), connector_(connector) {
-    startTime_ = QDateTime::currentMSecsSinceEpoch();
+IMUPanel::IMUPanel(ECUConnector* connector, RenderQuality* quality, QWidget *parent)
+    : QWidget(parent), connector_(connector), renderQuality_(quality) {
+    startTime_ = connector_->Executor()->Now();
     SetupUi();
+    renderGate_ = new RenderGate(this);
+    connect(renderGate_, &RenderGate::Opened, this, &IMUPanel::Render);
     
     connect(connector_, &ECUConnector::ImuDataReceived, this, &IMUPanel::OnImuDataReceived);
 }
@@ -33,74 +39,70 @@ void IMUPanel::SetupUi() {
     topLayout->addWidget(horizon_);
     mainLayout->addLayout(topLayout);
 
-    SetupCharts();
-    mainLayout->addWidget(chartViewX_);
-    mainLayout->addWidget(chartViewY_);
-    mainLayout->addWidget(chartViewZ_);
+    strip_ = new StripChart(renderQuality_);
+    
+    // One row of channel toggles per sensor, in ImuData order
+    struct Group {
+        const char* name;
+        const char* unit;
+        QStringList axes;
+    };
+    const Group groups[] = {
+        {"accel", "m/s²", {"x", "y", "z"}},
+        {"gyro", "rad/s", {"x", "y", "z"}},
+        {"mag", "µT", {"x", "y", "z"}},
+        {"quat", "", {"w", "x", "y", "z"}},
+    };
+    const QColor axisColors[] = {Qt::red, QColor(0, 160, 0), Qt::blue, Qt::darkMagenta};
+    auto* channelLayout = new QGridLayout();
+    int channel = 0;
+    for (int g = 0; g < 4; ++g) {
+        channelLayout->addWidget(new QLabel(QString(groups[g].name) + ":"), g, 0);
+        for (int a = 0; a < groups[g].axes.size(); ++a) {
+            // Quaternion components are coloured like the axes they belong to
+            QColor color = groups[g].axes.size() == 4 ? axisColors[(a + 3) % 4] : axisColors[a];
+            QString name = QString("%1_%2").arg(groups[g].name, groups[g].axes[a]);
+            strip_->AddChannel(name, groups[g].unit, color);
+            channelChecks_[channel] = new QCheckBox(groups[g].axes[a]);
+            channelChecks_[channel]->setChecked(true);
+            connect(channelChecks_[channel], &QCheckBox::toggled, this, [this, channel](bool visible) {
+                strip_->SetChannelVisible(channel, visible);
+            });
+            channelLayout->addWidget(channelChecks_[channel], g, a + 1);
+            ++channel;
+        }
+    }
+    channelLayout->setColumnStretch(5, 1);
+    mainLayout->addLayout(channelLayout);
+    mainLayout->addWidget(strip_, 1);
     
     scrollArea->setWidget(contentWidget);
     outerLayout->addWidget(scrollArea);
 }
 
-void IMUPanel::SetupCharts() {
-    seriesX_ = new QLineSeries();
-    seriesY_ = new QLineSeries();
-    seriesZ_ = new QLineSeries();
-
-    chartViewX_ = CreateChart("Acceleration X", seriesX_, Qt::red);
-    chartViewY_ = CreateChart("Acceleration Y", seriesY_, Qt::green);
-    chartViewZ_ = CreateChart("Acceleration Z", seriesZ_, Qt::blue);
-}
-
-QChartView* IMUPanel::CreateChart(const QString& title, QLineSeries* series, QColor color) {
-    auto* chart = new QChart();
-    chart->addSeries(series);
-    chart->setTitle(title);
-    chart->legend()->hide();
-
-    QPen pen(color);
-    pen.setWidth(2);
-    series->setPen(pen);
-
-    auto* axisX = new QValueAxis();
-    axisX->setTitleText("Time (s)");
-    chart->addAxis(axisX, Qt::AlignBottom);
-    series->attachAxis(axisX);
+void IMUPanel::OnImuDataReceived(const ImuData& data) {
+    qreal currentTime = std::chrono::duration<double>(connector_->Executor()->Now() - startTime_).count();
+    strip_->AddSample(currentTime, data.ToArray().data());
+    lastImu_ = data;
 
-    auto* axisY = new QValueAxis();
-    axisY->setTitleText("m/s²");
-    chart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisY);
-    axisY->setRange(-15.0, 15.0); // Increased range to accommodate gravity (9.8 m/s²)
+    // Hidden tab or minimised window: keep the data, leave the widgets alone
+    if (!renderGate_->IsOpen()) {
+        stale_ = true;
+        return;
+    }
 
-    auto* chartView = new QChartView(chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
-    chartView->setMinimumHeight(120);
-    return chartView;
+    strip_->ScheduleRepaint();
+    ShowOrientation(data);
 }
 
-void IMUPanel::OnImuDataReceived(const ImuData& data) {
-    qreal currentTime = (QDateTime::currentMSecsSinceEpoch() - startTime_) / 1000.0;
-    
-    seriesX_->append(currentTime, data.accel_x);
-    seriesY_->append(currentTime, data.accel_y);
-    seriesZ_->append(currentTime, data.accel_z);
-
-    // Keep only last 100 points
-    if (seriesX_->count() > 100) {
-        seriesX_->remove(0);
-        seriesY_->remove(0);
-        seriesZ_->remove(0);
-    }
-
-    // Update X axis range
-    auto* axisX = static_cast<QValueAxis*>(chartViewX_->chart()->axes(Qt::Horizontal).first());
-    if (seriesX_->count() > 0) {
-        axisX->setRange(seriesX_->points().first().x(), seriesX_->points().last().x());
-        static_cast<QValueAxis*>(chartViewY_->chart()->axes(Qt::Horizontal).first())->setRange(axisX->min(), axisX->max());
-        static_cast<QValueAxis*>(chartViewZ_->chart()->axes(Qt::Horizontal).first())->setRange(axisX->min(), axisX->max());
-    }
+void IMUPanel::Render() {
+    if (!stale_) return;
+    stale_ = false;
+    strip_->ScheduleRepaint();
+    ShowOrientation(lastImu_);
+}
 
+void IMUPanel::ShowOrientation(const ImuData& data) {
     // Quaternion to Euler
     float w = data.quat_w;
     float x = data.quat_x;
@@ -116,72 +118,365 @@ void IMUPanel::OnImuDataReceived(const ImuData& data) {
     horizon_->setOrientation(pitch * 180.0f / M_PI, roll * 180.0f / M_PI);
 }
 
+// --- InstrumentWidget ---
+
+InstrumentWidget::InstrumentWidget(QWidget* parent) : QWidget(parent) {
+    setMinimumSize(150, 150);
+    repaintTimer_ = new QTimer(this);
+    repaintTimer_->setSingleShot(true);
+    connect(repaintTimer_, &QTimer::timeout, this, [this] {
+        lastRepaint_.start();
+        update();
+    });
+}
+
+void InstrumentWidget::ScheduleRepaint() {
+    if (repaintTimer_->isActive()) return;
+    QScreen* display = screen();
+    qreal refreshHz = display && display->refreshRate() > 0 ? display->refreshRate() : 60;
+    qint64 intervalMs = qMax<qint64>(1, qRound(1000 / refreshHz));
+    qint64 sinceMs = lastRepaint_.isValid() ? lastRepaint_.elapsed() : intervalMs;
+    if (sinceMs >= intervalMs) {
+        lastRepaint_.start();
+        update();
+    } else {
+        // Samples arriving before then only update the values
+        repaintTimer_->start(intervalMs - sinceMs);
+    }
+}
+
+bool InstrumentWidget::LayersValid() const {
+    return layerSize_ == size() && layerDpr_ == devicePixelRatioF();
+}
+
+void InstrumentWidget::LayersBuilt() {
+    layerSize_ = size();
+    layerDpr_ = devicePixelRatioF();
+}
+
+QPixmap InstrumentWidget::CreateLayer(QSize size) const {
+    qreal dpr = devicePixelRatioF();
+    QPixmap layer(size * dpr);
+    layer.setDevicePixelRatio(dpr);
+    layer.fill(Qt::transparent);
+    return layer;
+}
+
+void InstrumentWidget::changeEvent(QEvent* event) {
+    if (event->type() == QEvent::PaletteChange || event->type() == QEvent::StyleChange) {
+        InvalidateLayers();
+    }
+    QWidget::changeEvent(event);
+}
+
+void InstrumentWidget::resizeEvent(QResizeEvent* event) {
+    InvalidateLayers();
+    QWidget::resizeEvent(event);
+}
+
 // --- CompassWidget ---
 
-void CompassWidget::paintEvent(QPaintEvent* event) {
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    
-    int size = qMin(width(), height()) - 20;
-    painter.translate(width()/2, height()/2);
-    
-    // Draw circle
-    painter.setPen(QPen(Qt::black, 2));
-    painter.drawEllipse(-size/2, -size/2, size, size);
-    
+void CompassWidget::BuildLayers() {
+    int size = DialSize();
+
+    dial_ = CreateLayer(this->size());
+    QPainter dial(&dial_);
+    dial.setRenderHint(QPainter::Antialiasing);
+    dial.translate(width()/2, height()/2);
+    dial.setPen(QPen(Qt::black, 2));
+    dial.drawEllipse(-size/2, -size/2, size, size);
+
+    // Centred on the rotation axis
+    rose_ = CreateLayer(QSize(size, size));
+    QPainter rose(&rose_);
+    rose.setRenderHint(QPainter::Antialiasing);
+    rose.translate(size/2, size/2);
+    rose.setPen(QPen(Qt::black, 2));
+
     // Draw North marker
-    painter.rotate(-yaw_);
-    painter.setBrush(Qt::red);
+    rose.setBrush(Qt::red);
     QPolygon northArrow;
     northArrow << QPoint(0, -size/2) << QPoint(-10, -size/2 + 20) << QPoint(10, -size/2 + 20);
-    painter.drawPolygon(northArrow);
+    rose.drawPolygon(northArrow);
     
-    painter.setBrush(Qt::blue);
+    rose.setBrush(Qt::blue);
     QPolygon southArrow;
     southArrow << QPoint(0, size/2) << QPoint(-10, size/2 - 20) << QPoint(10, size/2 - 20);
-    painter.drawPolygon(southArrow);
+    rose.drawPolygon(southArrow);
 
-    painter.setPen(Qt::black);
-    painter.drawText(-10, -size/2 + 35, "N");
-    painter.drawText(-10, size/2 - 25, "S");
+    rose.setPen(Qt::black);
+    rose.drawText(-10, -size/2 + 35, "N");
+    rose.drawText(-10, size/2 - 25, "S");
+
+    LayersBuilt();
+}
+
+void CompassWidget::paintEvent(QPaintEvent* event) {
+    if (!LayersValid()) BuildLayers();
+    int size = DialSize();
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, dial_);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.translate(width()/2, height()/2);
+    painter.rotate(-yaw_);
+    painter.drawPixmap(-size/2, -size/2, rose_);
 }
 
 // --- HorizonWidget ---
 
+void HorizonWidget::BuildLayers() {
+    int size = DialSize();
+
+    // Tall enough to cover the dial at any roll and the full pitch range;
+    // the horizon is in the middle
+    ball_ = CreateLayer(QSize(2 * size, 4 * size));
+    QPainter ball(&ball_);
+    ball.setPen(Qt::NoPen);
+    ball.setBrush(QColor(135, 206, 235));  // Sky (Blue)
+    ball.drawRect(0, 0, 2 * size, 2 * size);
+    ball.setBrush(QColor(139, 69, 19));  // Ground (Brown)
+    ball.drawRect(0, 2 * size, 2 * size, 2 * size);
+    ball.setPen(QPen(Qt::white, 2));
+    ball.drawLine(size/2, 2 * size, 3 * size/2, 2 * size);
+
+    // Everything outside the dial is covered with the background, so the
+    // ball needs no clipping per frame
+    bezel_ = CreateLayer(this->size());
+    QPainter bezel(&bezel_);
+    bezel.setRenderHint(QPainter::Antialiasing);
+    bezel.fillRect(rect(), palette().window());
+    bezel.translate(width()/2, height()/2);
+    bezel.setCompositionMode(QPainter::CompositionMode_Clear);
+    bezel.setPen(Qt::NoPen);
+    bezel.setBrush(Qt::black);
+    bezel.drawEllipse(-size/2, -size/2, size, size);
+    bezel.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    // Aircraft symbol (static)
+    bezel.setPen(QPen(Qt::yellow, 3));
+    bezel.drawLine(-20, 0, -5, 0);
+    bezel.drawLine(5, 0, 20, 0);
+    bezel.drawLine(0, 0, 0, 5);
+
+    LayersBuilt();
+}
+
 void HorizonWidget::paintEvent(QPaintEvent* event) {
+    if (!LayersValid()) BuildLayers();
+    int size = DialSize();
+
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    
-    int size = qMin(width(), height()) - 20;
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
     painter.translate(width()/2, height()/2);
-    
-    // Clip to circle
-    QPainterPath path;
-    path.addEllipse(-size/2, -size/2, size, size);
-    painter.setClipPath(path);
-
     painter.rotate(-roll_);
-    
     // Pitch offset (simple approximation)
-    int pitchOffset = static_cast<int>(pitch_ * (size / 90.0f));
-    
-    // Draw Sky (Blue)
-    painter.setBrush(QColor(135, 206, 235));
-    painter.drawRect(-size, -size - pitchOffset, size*2, size + pitchOffset);
-    
-    // Draw Ground (Brown)
-    painter.setBrush(QColor(139, 69, 19));
-    painter.drawRect(-size, -pitchOffset, size*2, size + pitchOffset);
-    
-    // Draw Horizon line
-    painter.setPen(QPen(Qt::white, 2));
-    painter.drawLine(-size/2, -pitchOffset, size/2, -pitchOffset);
-    
-    // Aircraft symbol (static)
-    painter.resetTransform();
-    painter.translate(width()/2, height()/2);
-    painter.setPen(QPen(Qt::yellow, 3));
-    painter.drawLine(-20, 0, -5, 0);
-    painter.drawLine(5, 0, 20, 0);
-    painter.drawLine(0, 0, 0, 5);
+    qreal pitchOffset = qBound<qreal>(-1.5 * size, pitch_ * (size / 90.0f), 1.5 * size);
+    painter.drawPixmap(QPointF(-size, -2 * size - pitchOffset), ball_);
+    painter.restore();
+    painter.drawPixmap(0, 0, bezel_);
+}
+
+// --- StripChart ---
+
+namespace {
+
+constexpr int kLabelWidth = 120;
+constexpr int kAxisHeight = 20;
+constexpr int kMinLaneHeight = 36;
+
+}  // namespace
+
+StripChart::StripChart(RenderQuality* quality, QWidget* parent)
+    : InstrumentWidget(parent), quality_(quality) {
+    setMinimumHeight(13 * kMinLaneHeight + kAxisHeight + 4);
+    memoryRegistration_ = MemoryBudget::Global().Register("IMU strip chart", this);
+}
+
+int StripChart::AddChannel(const QString& name, const QString& unit, const QColor& color) {
+    channels_.append({name, unit, color, true});
+    values_.emplace_back();
+    InvalidateLayers();
+    return channels_.size() - 1;
+}
+
+void StripChart::SetChannelVisible(int channel, bool visible) {
+    channels_[channel].visible = visible;
+    InvalidateLayers();
+    update();
+}
+
+void StripChart::SetTimeWindow(qreal seconds) {
+    window_ = seconds;
+    InvalidateLayers();
+    update();
+}
+
+void StripChart::AddSample(qreal time, const float* values) {
+    times_.push_back(time);
+    for (size_t c = 0; c < values_.size(); ++c) values_[c].push_back(values[c]);
+    while (times_.front() < time - window_) {
+        times_.pop_front();
+        for (auto& column : values_) column.pop_front();
+    }
+    if (times_.size() > maxSamples_) Thin();
+}
+
+void StripChart::Thin() {
+    auto thin = [](auto& samples) {
+        size_t kept = 0;
+        for (size_t i = 0; i < samples.size(); i += 2) samples[kept++] = samples[i];
+        samples.resize(kept);
+        samples.shrink_to_fit();
+    };
+    thin(times_);
+    for (auto& column : values_) thin(column);
+}
+
+size_t StripChart::MemoryUsage() const {
+    return times_.size() * (sizeof(qreal) + values_.size() * sizeof(float));
+}
+
+size_t StripChart::Shed(size_t) {
+    // Two samples per pixel column are all a lane draws
+    size_t floor = 2 * static_cast<size_t>(std::max(PlotRect().width(), 1));
+    if (times_.size() <= floor) return 0;
+    size_t before = MemoryUsage();
+    maxSamples_ = std::max(floor, times_.size() / 2);
+    Thin();
+    return before - MemoryUsage();
+}
+
+QRect StripChart::PlotRect() const {
+    return rect().adjusted(kLabelWidth, 4, -8, -kAxisHeight);
+}
+
+QVector<int> StripChart::VisibleChannels() const {
+    QVector<int> visible;
+    for (int c = 0; c < channels_.size(); ++c) {
+        if (channels_[c].visible) visible.append(c);
+    }
+    return visible;
+}
+
+void StripChart::BuildLayers() {
+    frame_ = CreateLayer(size());
+    QPainter painter(&frame_);
+    painter.fillRect(rect(), palette().base());
+    QRect plot = PlotRect();
+    QVector<int> visible = VisibleChannels();
+    if (visible.isEmpty()) {
+        painter.setPen(palette().text().color());
+        painter.drawText(rect(), Qt::AlignCenter, "No channels selected");
+        LayersBuilt();
+        return;
+    }
+
+    // Shared time axis, relative to the newest sample
+    const int kTicks = 5;
+    for (int i = 0; i <= kTicks; ++i) {
+        qreal x = plot.left() + plot.width() * i / qreal(kTicks);
+        painter.setPen(palette().midlight().color());
+        painter.drawLine(QPointF(x, plot.top()), QPointF(x, plot.bottom()));
+        painter.setPen(palette().text().color());
+        qreal seconds = -window_ * (kTicks - i) / kTicks;
+        painter.drawText(QRectF(x - 40, plot.bottom() + 2, 80, kAxisHeight - 2), Qt::AlignHCenter | Qt::AlignTop,
+                         QString("%1 s").arg(seconds, 0, 'g', 3));
+    }
+
+    qreal laneHeight = plot.height() / qreal(visible.size());
+    QFont nameFont = font();
+    nameFont.setBold(true);
+    for (int k = 0; k < visible.size(); ++k) {
+        const Channel& channel = channels_[visible[k]];
+        QRectF lane(0, plot.top() + k * laneHeight, width(), laneHeight);
+        painter.setPen(palette().mid().color());
+        painter.drawLine(QPointF(plot.left(), lane.bottom()), QPointF(plot.right(), lane.bottom()));
+        painter.setPen(channel.color);
+        painter.setFont(nameFont);
+        painter.drawText(lane.adjusted(4, 0, 0, 0), Qt::AlignLeft | Qt::AlignVCenter, channel.name);
+    }
+    LayersBuilt();
+}
+
+void StripChart::paintEvent(QPaintEvent* event) {
+    QElapsedTimer timer;
+    timer.start();
+    if (!LayersValid()) BuildLayers();
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, frame_);
+    QVector<int> visible = VisibleChannels();
+    if (times_.empty() || visible.isEmpty()) return;
+
+    bool antialiasing = !quality_ || quality_->level() < RenderQuality::NoAntialiasing;
+    painter.setRenderHint(QPainter::Antialiasing, antialiasing);
+    QRect plot = PlotRect();
+    qreal laneHeight = plot.height() / qreal(visible.size());
+    qreal start = times_.back() - window_;
+    qreal xScale = plot.width() / window_;
+    QFont smallFont = font();
+    smallFont.setPointSizeF(smallFont.pointSizeF() * 0.85);
+    painter.setFont(smallFont);
+
+    for (int k = 0; k < visible.size(); ++k) {
+        const Channel& channel = channels_[visible[k]];
+        const std::deque<float>& values = values_[visible[k]];
+        QRectF lane(plot.left(), plot.top() + k * laneHeight, plot.width(), laneHeight);
+
+        // Each lane scales to its own range over the window
+        auto [lowest, highest] = std::minmax_element(values.begin(), values.end());
+        qreal low = *lowest;
+        qreal high = *highest;
+        if (high - low < 1e-6) {
+            low -= 1;
+            high += 1;
+        }
+        qreal pad = (high - low) * 0.1;
+        qreal yScale = (laneHeight - 4) / (high - low + 2 * pad);
+        auto y = [&](qreal value) { return lane.bottom() - 2 - (value - low + pad) * yScale; };
+
+        // Samples in the same pixel column collapse to their extremes, in
+        // the order they occurred
+        polyline_.clear();
+        int column = std::numeric_limits<int>::min();
+        float first = 0, last = 0, min = 0, max = 0;
+        auto flush = [&] {
+            if (column == std::numeric_limits<int>::min()) return;
+            qreal x = plot.left() + column;
+            if (min == max) {
+                polyline_.append(QPointF(x, y(min)));
+            } else {
+                bool rising = first <= last;
+                polyline_.append(QPointF(x, y(rising ? min : max)));
+                polyline_.append(QPointF(x, y(rising ? max : min)));
+            }
+        };
+        for (size_t i = 0; i < values.size(); ++i) {
+            int c = static_cast<int>((times_[i] - start) * xScale);
+            float v = values[i];
+            if (c != column) {
+                flush();
+                column = c;
+                first = min = max = v;
+            }
+            min = std::min(min, v);
+            max = std::max(max, v);
+            last = v;
+        }
+        flush();
+        painter.setPen(QPen(channel.color, 1.5));
+        painter.drawPolyline(polyline_.constData(), polyline_.size());
+
+        // Range at the lane edges, latest value at its top left
+        painter.setPen(palette().text().color());
+        QRectF labels(0, lane.top(), kLabelWidth - 6, lane.height());
+        painter.drawText(labels, Qt::AlignRight | Qt::AlignTop, QString::number(high, 'g', 4));
+        painter.drawText(labels, Qt::AlignRight | Qt::AlignBottom, QString::number(low, 'g', 4));
+        painter.setPen(channel.color);
+        painter.drawText(lane.adjusted(4, 1, 0, 0), Qt::AlignLeft | Qt::AlignTop,
+                         QString("%1 %2").arg(values.back(), 0, 'f', 3).arg(channel.unit).trimmed());
+    }
+    if (quality_) quality_->AddFrame(timer.nsecsElapsed());
 }
@@ -1,66 +1,161 @@
 #pragma once
 
 #include <QWidget>
-#include <QtCharts/QChartView>
-#include <QtCharts/QLineSeries>
-#include <QtCharts/QValueAxis>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QPixmap>
+#include <QTimer>
+#include <QVector>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <vector>
 #include "ECUConnector.h"
+#include "MemoryBudget.h"
 
 class CompassWidget;
 class HorizonWidget;
+class StripChart;
+class RenderGate;
+class RenderQuality;
 
 class IMUPanel : public QWidget {
     Q_OBJECT
 public:
-    explicit IMUPanel(ECUConnector* connector, QWidget *parent = nullptr);
+    IMUPanel(ECUConnector* connector, RenderQuality* quality, QWidget *parent = nullptr);
 
 private slots:
     void OnImuDataReceived(const ImuData& data);
+    // Redraws the stored window in one pass after the panel was hidden
+    void Render();
 
 private:
     void SetupUi();
-    void SetupCharts();
-    QChartView* CreateChart(const QString& title, QLineSeries* series, QColor color);
+    void ShowOrientation(const ImuData& data);
 
     ECUConnector* connector_;
+    RenderQuality* renderQuality_;
     
     CompassWidget* compass_;
     HorizonWidget* horizon_;
-
-    QLineSeries* seriesX_;
-    QLineSeries* seriesY_;
-    QLineSeries* seriesZ_;
-    QChartView* chartViewX_;
-    QChartView* chartViewY_;
-    QChartView* chartViewZ_;
-    QValueAxis* axisX_;
+    // All 13 ImuData fields, in declaration order
+    StripChart* strip_;
+    QCheckBox* channelChecks_[13];
+    
+    // Samples are stored while the panel is hidden and drawn only when seen
+    RenderGate* renderGate_;
+    ImuData lastImu_{};
+    bool stale_ = false;
     
-    qint64 startTime_ = 0;
+    // On the connector's clock
+    std::chrono::steady_clock::time_point startTime_;
 };
 
-class CompassWidget : public QWidget {
+// Base of the IMU panel's live views. Artwork that does not move is rendered
+// once into pixmaps at the screen's device pixel ratio and only blitted per
+// frame; the pixmaps are rebuilt when the size, pixel ratio or palette
+// changes. Repaints are limited to the display refresh rate.
+class InstrumentWidget : public QWidget {
     Q_OBJECT
 public:
-    explicit CompassWidget(QWidget* parent = nullptr) : QWidget(parent) {
-        setMinimumSize(150, 150);
-    }
-    void setYaw(float yaw) { yaw_ = yaw; update(); }
+    explicit InstrumentWidget(QWidget* parent = nullptr);
+
+    void ScheduleRepaint();
+
+protected:
+    // Whether the cached layers still match the widget; if not, the caller
+    // rebuilds them and calls LayersBuilt()
+    bool LayersValid() const;
+    void LayersBuilt();
+    void InvalidateLayers() { layerSize_ = QSize(); }
+    // Transparent layer of the given size in device-independent pixels
+    QPixmap CreateLayer(QSize size) const;
+    int DialSize() const { return qMin(width(), height()) - 20; }
+
+    void changeEvent(QEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    QTimer* repaintTimer_;
+    QElapsedTimer lastRepaint_;
+    QSize layerSize_;
+    qreal layerDpr_ = 0;
+};
+
+class CompassWidget : public InstrumentWidget {
+    Q_OBJECT
+public:
+    explicit CompassWidget(QWidget* parent = nullptr) : InstrumentWidget(parent) {}
+    void setYaw(float yaw) { yaw_ = yaw; ScheduleRepaint(); }
 protected:
     void paintEvent(QPaintEvent* event) override;
 private:
+    void BuildLayers();
+
     float yaw_ = 0;
+    QPixmap dial_;  // Circle, whole widget
+    QPixmap rose_;  // Arrows and labels, rotated by the yaw
 };
 
-class HorizonWidget : public QWidget {
+class HorizonWidget : public InstrumentWidget {
     Q_OBJECT
 public:
-    explicit HorizonWidget(QWidget* parent = nullptr) : QWidget(parent) {
-        setMinimumSize(150, 150);
-    }
-    void setOrientation(float roll, float pitch) { roll_ = roll; pitch_ = pitch; update(); }
+    explicit HorizonWidget(QWidget* parent = nullptr) : InstrumentWidget(parent) {}
+    void setOrientation(float roll, float pitch) { roll_ = roll; pitch_ = pitch; ScheduleRepaint(); }
 protected:
     void paintEvent(QPaintEvent* event) override;
 private:
+    void BuildLayers();
+
     float roll_ = 0;
     float pitch_ = 0;
+    QPixmap ball_;   // Sky and ground, rotated by the roll, shifted by the pitch
+    QPixmap bezel_;  // Background outside the dial and the aircraft symbol
+};
+
+// Strip chart of many channels over a shared time axis: each visible channel
+// gets its own lane with its own auto-scaled range, all drawn in one paint.
+// Samples older than the time window are dropped as new ones arrive; a lane
+// draws at most two points per pixel column however high the sample rate.
+// Under memory pressure the ring of samples is capped: once it is full the
+// window is thinned to every other sample rather than shortened.
+class StripChart : public InstrumentWidget, private MemoryBudget::Consumer {
+    Q_OBJECT
+public:
+    explicit StripChart(RenderQuality* quality, QWidget* parent = nullptr);
+
+    int AddChannel(const QString& name, const QString& unit, const QColor& color);
+    void SetChannelVisible(int channel, bool visible);
+    void SetTimeWindow(qreal seconds);
+    // One value per channel; stored only, ScheduleRepaint() shows it
+    void AddSample(qreal time, const float* values);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    struct Channel {
+        QString name;
+        QString unit;
+        QColor color;
+        bool visible = true;
+    };
+
+    void BuildLayers();
+    QRect PlotRect() const;
+    QVector<int> VisibleChannels() const;
+    void Thin();
+    size_t MemoryUsage() const override;
+    size_t Shed(size_t bytes) override;
+
+    RenderQuality* quality_;
+    QVector<Channel> channels_;
+    qreal window_ = 10;
+    // Sample times and one value column per channel, oldest first
+    std::deque<qreal> times_;
+    std::vector<std::deque<float>> values_;
+    size_t maxSamples_ = std::numeric_limits<size_t>::max();  // Lowered by Shed()
+    QPixmap frame_;  // Background, lanes, names and time axis
+    QVector<QPointF> polyline_;  // Reused between paints
+    MemoryBudget::Registration memoryRegistration_;
 };
@@ -0,0 +1,82 @@
+#include "IoReactor.h"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+IoReactor::IoReactor() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    throw std::runtime_error("Error creating epoll instance");
+  }
+}
+
+IoReactor::~IoReactor() {
+  Stop();
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+void IoReactor::Start() {
+  if (running_) return;
+  running_ = true;
+  thread_ = std::thread(&IoReactor::Loop, this);
+}
+
+void IoReactor::Stop() {
+  running_ = false;
+  if (thread_.joinable()) thread_.join();
+}
+
+void IoReactor::Add(int fd, Handler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  handlers_[fd] = std::move(handler);
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    handlers_.erase(fd);
+    throw std::runtime_error("Error registering descriptor with epoll");
+  }
+}
+
+void IoReactor::Remove(int fd) {
+  // Handlers run with mutex_ held, so taking it here waits out a running one
+  std::lock_guard<std::mutex> lock(mutex_);
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  handlers_.erase(fd);
+}
+
+void IoReactor::WatchWritable(int fd, bool enabled) {
+  // epoll_ctl is thread-safe; mutex_ is not taken so handlers can call this.
+  // Fails harmlessly once fd was removed or ignored.
+  epoll_event ev{};
+  ev.events = EPOLLIN | (enabled ? EPOLLOUT : 0);
+  ev.data.fd = fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void IoReactor::Ignore(int fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void IoReactor::Loop() {
+  epoll_event events[32];
+  while (running_) {
+    // Bounded wait so Stop() is noticed promptly
+    int n = epoll_wait(epoll_fd_, events, 32, 10);
+    if (n <= 0) continue;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < n; ++i) {
+      auto it = handlers_.find(events[i].data.fd);
+      if (it == handlers_.end()) continue;
+      uint32_t ready = 0;
+      if (events[i].events & EPOLLIN) ready |= kReadable;
+      if (events[i].events & EPOLLOUT) ready |= kWritable;
+      if (events[i].events & (EPOLLHUP | EPOLLERR)) ready |= kHangUp;
+      it->second(ready);
+    }
+  }
+}
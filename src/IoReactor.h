@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Single epoll thread dispatching readiness for many file descriptors.
+// Lets N serial ports share one I/O thread instead of two threads per port.
+class IoReactor {
+ public:
+  // Bits of the events passed to a handler
+  static constexpr uint32_t kReadable = 1;
+  static constexpr uint32_t kWritable = 2;
+  // Hang-up or error; the descriptor stays readable until it is closed
+  static constexpr uint32_t kHangUp = 4;
+
+  using Handler = std::function<void(uint32_t events)>;
+
+  IoReactor();
+  ~IoReactor();
+
+  void Start();
+  void Stop();
+
+  // Watches fd for reading, and for hang-ups
+  void Add(int fd, Handler handler);
+  // Blocks until no handler for fd is running. Must not be called from a handler.
+  void Remove(int fd);
+  // Also watches fd for writing while enabled, e.g. while output is queued.
+  // May be called from any thread, including fd's handler.
+  void WatchWritable(int fd, bool enabled);
+  // Stops reporting events for fd, e.g. from its handler after a hang-up, so
+  // a dead descriptor does not keep the thread busy. Remove() is still needed.
+  void Ignore(int fd);
+
+ private:
+  void Loop();
+
+  int epoll_fd_ = -1;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::unordered_map<int, Handler> handlers_;
+};
@@ -0,0 +1,156 @@
+#include "LinkProfiler.h"
+#include "ECUConnector.h"
+#include "FrameCodec.h"
+#include <algorithm>
+
+LinkProfiler::LinkProfiler(ECUConnector *connector, QObject *parent)
+    : QObject(parent), connector_(connector) {
+    sendTimer_ = new QTimer(this);
+    sendTimer_->setTimerType(Qt::PreciseTimer);
+    connect(sendTimer_, &QTimer::timeout, this, &LinkProfiler::OnSendTick);
+    drainTimer_ = new QTimer(this);
+    drainTimer_->setSingleShot(true);
+    connect(drainTimer_, &QTimer::timeout, this, &LinkProfiler::FinishStep);
+    connect(connector_, &ECUConnector::PingReceived, this, &LinkProfiler::OnPingReceived);
+}
+
+void LinkProfiler::Start(const Config &config) {
+    Stop();
+    config_ = config;
+    steps_.clear();
+    fixedUs_ = 0;
+    usPerByte_ = 0;
+    if (config_.sizes.empty() || config_.rates.empty() || config_.count <= 0) {
+        emit Finished();
+        return;
+    }
+    running_ = true;
+    stepIndex_ = 0;
+    StartStep();
+}
+
+void LinkProfiler::Stop() {
+    running_ = false;
+    sendTimer_->stop();
+    drainTimer_->stop();
+    inFlight_.clear();
+}
+
+void LinkProfiler::StartStep() {
+    int size = std::clamp(config_.sizes[stepIndex_ / config_.rates.size()], 0, protocol::kPingMaxData);
+    int rate = std::max(1, config_.rates[stepIndex_ % config_.rates.size()]);
+
+    // Includes 0x00 and 0xAA, which cost extra in some framings
+    data_.resize(size);
+    for (int i = 0; i < size; ++i) data_[i] = static_cast<uint8_t>(i * 37);
+
+    LinkProfileStep step;
+    step.dataBytes = size;
+    step.rateHz = rate;
+    step.wireBytes = WireBytes(size);
+    steps_.push_back(step);
+
+    sentInStep_ = 0;
+    rtts_.clear();
+    inFlight_.clear();
+    stepStart_ = std::chrono::steady_clock::now();
+    lastRx_ = stepStart_;
+    // Rates above 1 kHz are capped by the timer resolution
+    sendTimer_->start(std::max(1, 1000 / rate));
+    OnSendTick();
+}
+
+void LinkProfiler::OnSendTick() {
+    if (!running_) return;
+    if (sentInStep_ >= config_.count || !connector_->IsConnected()) {
+        sendTimer_->stop();
+        drainTimer_->start(static_cast<int>(config_.timeout.count()));
+        return;
+    }
+    uint16_t seq = nextSeq_++;
+    inFlight_[seq] = std::chrono::steady_clock::now();
+    connector_->Ping(seq, data_, static_cast<int>(data_.size()));
+    ++sentInStep_;
+}
+
+void LinkProfiler::OnPingReceived(uint16_t seq, int replyBytes, std::chrono::steady_clock::time_point rxTime) {
+    auto it = inFlight_.find(seq);
+    if (!running_ || it == inFlight_.end()) return;
+
+    double rtt = std::chrono::duration<double, std::micro>(rxTime - it->second).count();
+    // Short echoes and answers after the timeout count as lost
+    if (replyBytes == steps_.back().dataBytes &&
+        rtt <= std::chrono::duration<double, std::micro>(config_.timeout).count()) {
+        rtts_.push_back(rtt);
+        lastRx_ = rxTime;
+    }
+    inFlight_.erase(it);
+
+    // Everything answered: no need to wait for the timeout
+    if (sentInStep_ >= config_.count && inFlight_.empty() && drainTimer_->isActive()) {
+        drainTimer_->stop();
+        FinishStep();
+    }
+}
+
+void LinkProfiler::FinishStep() {
+    if (!running_) return;
+
+    LinkProfileStep &step = steps_.back();
+    step.sent = sentInStep_;
+    step.received = static_cast<int>(rtts_.size());
+    if (!rtts_.empty()) {
+        std::sort(rtts_.begin(), rtts_.end());
+        auto percentile = [this](double p) {
+            size_t index = static_cast<size_t>(p * (rtts_.size() - 1) + 0.5);
+            return rtts_[index];
+        };
+        step.rttMinUs = rtts_.front();
+        step.rttP50Us = percentile(0.5);
+        step.rttP90Us = percentile(0.9);
+        step.rttP99Us = percentile(0.99);
+        step.rttMaxUs = rtts_.back();
+
+        double seconds = std::chrono::duration<double>(lastRx_ - stepStart_).count();
+        if (seconds > 0) step.throughputBps = step.wireBytes * step.received / seconds;
+    }
+    // 8N1: ten bit times per byte
+    if (connector_->Baud() > 0) step.serialiseUs = step.wireBytes * 10.0 * 1e6 / connector_->Baud();
+    step.overheadUs = step.rttP50Us - step.serialiseUs;
+    emit StepFinished(step);
+
+    if (++stepIndex_ < config_.sizes.size() * config_.rates.size() && connector_->IsConnected()) {
+        StartStep();
+        return;
+    }
+    running_ = false;
+    Fit();
+    emit Finished();
+}
+
+void LinkProfiler::Fit() {
+    // Queueing only adds to an RTT, so the fastest one per step is the link itself
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const LinkProfileStep &step : steps_) {
+        if (step.received == 0) continue;
+        n += 1;
+        sx += step.wireBytes;
+        sy += step.rttMinUs;
+        sxx += double(step.wireBytes) * step.wireBytes;
+        sxy += step.wireBytes * step.rttMinUs;
+    }
+    if (n == 0) return;
+    double var = n * sxx - sx * sx;
+    usPerByte_ = var > 0 ? (n * sxy - sx * sy) / var : 0.0;
+    fixedUs_ = (sy - usPerByte_ * sx) / n;
+}
+
+int LinkProfiler::WireBytes(int dataBytes) const {
+    auto framing = connector_->UsesCobsFraming() ? FrameCodec::Framing::kCobs : FrameCodec::Framing::kLegacy;
+    std::vector<uint8_t> request(protocol::kPingRequestHeaderSize + dataBytes, 0x55);
+    std::vector<uint8_t> response(protocol::kPingResponseHeaderSize + dataBytes, 0x55);
+    std::vector<uint8_t> frames;
+    FrameCodec::Encode(framing, request.data(), request.size(), frames);
+    FrameCodec::Encode(framing, response.data(), response.size(), frames);
+    return static_cast<int>(frames.size());
+}
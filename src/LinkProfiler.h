@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include "Protocol.h"
+
+class ECUConnector;
+
+// Result of one ping step: a fixed data size sent at a fixed rate
+struct LinkProfileStep {
+    int dataBytes = 0;          // Ping data in each direction
+    int rateHz = 0;
+    int sent = 0;
+    int received = 0;           // Lost = sent - received
+    double rttMinUs = 0;
+    double rttP50Us = 0;
+    double rttP90Us = 0;
+    double rttP99Us = 0;
+    double rttMaxUs = 0;
+    int wireBytes = 0;          // Request and response frame as sent on the line
+    double serialiseUs = 0;     // Time on the wire for wireBytes at the port's baud rate
+    double overheadUs = 0;      // Median RTT minus serialisation: adapter, OS and ECU dispatch
+    double throughputBps = 0;   // Frame bytes per second, both directions
+};
+
+// Measures the link with ping requests: sweeps data sizes and send rates and
+// reports RTT percentiles, loss and throughput per step. Fitting the fastest
+// RTT of each size against its wire bytes separates the per-byte cost (the
+// line rate actually achieved) from the fixed per-transaction overhead.
+class LinkProfiler : public QObject {
+    Q_OBJECT
+public:
+    struct Config {
+        std::vector<int> sizes{0, 16, 64, 128, protocol::kPingMaxData};
+        std::vector<int> rates{10, 100, 500};
+        int count = 100;  // Pings per step
+        std::chrono::milliseconds timeout{500};
+    };
+
+    explicit LinkProfiler(ECUConnector *connector, QObject *parent = nullptr);
+
+    // The connector must be connected and support ping
+    void Start(const Config &config);
+    void Stop();
+    bool IsRunning() const { return running_; }
+
+    const std::vector<LinkProfileStep>& Steps() const { return steps_; }
+    // Least-squares fit of the fastest RTT per step over its wire bytes
+    double FixedOverheadUs() const { return fixedUs_; }
+    double UsPerByte() const { return usPerByte_; }
+
+signals:
+    void StepFinished(const LinkProfileStep &step);
+    void Finished();
+
+private slots:
+    void OnSendTick();
+    void OnPingReceived(uint16_t seq, int replyBytes, std::chrono::steady_clock::time_point rxTime);
+
+private:
+    void StartStep();
+    void FinishStep();
+    void Fit();
+    int WireBytes(int dataBytes) const;
+
+    ECUConnector *connector_;
+    QTimer *sendTimer_;
+    QTimer *drainTimer_;
+
+    Config config_;
+    bool running_ = false;
+    size_t stepIndex_ = 0;
+    int sentInStep_ = 0;
+    uint16_t nextSeq_ = 0;
+    std::chrono::steady_clock::time_point stepStart_;
+    std::chrono::steady_clock::time_point lastRx_;
+    std::unordered_map<uint16_t, std::chrono::steady_clock::time_point> inFlight_;
+    std::vector<double> rtts_;
+    std::vector<uint8_t> data_;
+
+    std::vector<LinkProfileStep> steps_;
+    double fixedUs_ = 0;
+    double usPerByte_ = 0;
+};
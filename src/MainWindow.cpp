@@ -2,9 +2,12 @@
 #include "ECUConnector.h"
 #include "ControlPanel.h"
 #include "DashboardPanel.h"
+#include "MemoryBudget.h"
+#include "StartupProfile.h"
 
 #include <QStatusBar>
 #include <QMenuBar>
+#include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent) {
@@ -26,6 +29,24 @@ MainWindow::MainWindow(QWidget *parent)
     });
     
     statusBar()->showMessage("Not connected");
+
+    // Histories and logs registered with the budget are checked once a
+    // second; ECU_PTS_MEMORY_BUDGET_MB overrides the default budget
+    MemoryBudget::Config memoryConfig;
+    bool ok = false;
+    int budgetMb = qEnvironmentVariableIntValue("ECU_PTS_MEMORY_BUDGET_MB", &ok);
+    if (ok && budgetMb > 0) memoryConfig.budget_bytes = size_t(budgetMb) << 20;
+    MemoryBudget::Global().SetConfig(memoryConfig);
+    memoryTimer_ = new QTimer(this);
+    connect(memoryTimer_, &QTimer::timeout, this, &MainWindow::EnforceMemoryBudget);
+    memoryTimer_->start(1000);
+}
+
+void MainWindow::EnforceMemoryBudget() {
+    MemoryBudget::Report report = MemoryBudget::Global().Enforce();
+    if (report.shed == 0) return;
+    qInfo().noquote() << QString("memory: shed %1 KiB of %2 KiB held, resident %3 MiB")
+                             .arg(report.shed >> 10).arg(report.usage >> 10).arg(report.resident >> 20);
 }
 
 void MainWindow::OnProtocolTesterTabActivated(bool activated) {
@@ -51,11 +72,17 @@ void MainWindow::SetupUi() {
     splitter_ = new QSplitter(Qt::Vertical, this);
     setCentralWidget(splitter_);
     
-    dashboardPanel_ = new DashboardPanel(connector_, this);
-    splitter_->addWidget(dashboardPanel_);
+    {
+        StartupProfile::Phase phase("dashboard panel");
+        dashboardPanel_ = new DashboardPanel(connector_, this);
+        splitter_->addWidget(dashboardPanel_);
+    }
     
-    controlPanel_ = new ControlPanel(connector_, this);
-    splitter_->addWidget(controlPanel_);
+    {
+        StartupProfile::Phase phase("control panel");
+        controlPanel_ = new ControlPanel(connector_, this);
+        splitter_->addWidget(controlPanel_);
+    }
     
     connect(controlPanel_, &ControlPanel::MaxRpmChanged, dashboardPanel_, &DashboardPanel::SetMaxRpm);
     dashboardPanel_->SetMaxRpm(controlPanel_->GetMaxRpm());
@@ -3,6 +3,7 @@
 #include <QMainWindow>
 #include <QSplitter>
 #include <QIcon>
+#include <QTimer>
 
 class ECUConnector;
 class ControlPanel;
@@ -18,6 +19,7 @@ public:
 
 private slots:
     void OnProtocolTesterTabActivated(bool activated);
+    void EnforceMemoryBudget();
 
 private:
     void SetupUi();
@@ -27,4 +29,5 @@ private:
     DashboardPanel* dashboardPanel_;
     IMUPanel* imuPanel_;
     QSplitter* splitter_;
+    QTimer* memoryTimer_;
 };
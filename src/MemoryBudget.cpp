@@ -0,0 +1,104 @@
+#include "MemoryBudget.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+MemoryBudget::Registration::Registration(Registration&& other) noexcept
+    : budget_(other.budget_), consumer_(other.consumer_) {
+  other.budget_ = nullptr;
+  other.consumer_ = nullptr;
+}
+
+MemoryBudget::Registration& MemoryBudget::Registration::operator=(
+    Registration&& other) noexcept {
+  if (this != &other) {
+    if (budget_) budget_->Unregister(consumer_);
+    budget_ = other.budget_;
+    consumer_ = other.consumer_;
+    other.budget_ = nullptr;
+    other.consumer_ = nullptr;
+  }
+  return *this;
+}
+
+MemoryBudget::Registration::~Registration() {
+  if (budget_) budget_->Unregister(consumer_);
+}
+
+MemoryBudget& MemoryBudget::Global() {
+  static MemoryBudget budget;
+  return budget;
+}
+
+void MemoryBudget::SetConfig(const Config& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+  config_.target = std::clamp(config_.target, 0.0, 1.0);
+}
+
+MemoryBudget::Config MemoryBudget::config() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_;
+}
+
+MemoryBudget::Registration MemoryBudget::Register(const std::string& name,
+                                                  Consumer* consumer,
+                                                  int priority) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), priority,
+      [](int p, const Entry& entry) { return p < entry.priority; });
+  entries_.insert(it, Entry{name, consumer, priority});
+  return Registration(this, consumer);
+}
+
+void MemoryBudget::Unregister(Consumer* consumer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [consumer](const Entry& entry) {
+                                  return entry.consumer == consumer;
+                                }),
+                 entries_.end());
+}
+
+std::vector<MemoryBudget::Usage> MemoryBudget::Usages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Usage> usages;
+  for (const Entry& entry : entries_) {
+    usages.push_back({entry.name, entry.priority, entry.consumer->MemoryUsage()});
+  }
+  return usages;
+}
+
+MemoryBudget::Report MemoryBudget::Enforce() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Report report;
+  for (const Entry& entry : entries_) {
+    report.usage += entry.consumer->MemoryUsage();
+  }
+  report.resident = ResidentBytes();
+
+  auto target = static_cast<size_t>(config_.budget_bytes * config_.target);
+  size_t excess = report.usage > target ? report.usage - target : 0;
+  if (report.usage <= config_.budget_bytes) excess = 0;
+  // Over the process limit, whatever the cause: halve what can be shed
+  if (config_.resident_limit > 0 && report.resident > config_.resident_limit) {
+    excess = std::max(excess, report.usage / 2);
+  }
+
+  for (const Entry& entry : entries_) {
+    if (report.shed >= excess) break;
+    report.shed += entry.consumer->Shed(excess - report.shed);
+  }
+  return report;
+}
+
+size_t MemoryBudget::ResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  if (!(statm >> pages >> resident)) return 0;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
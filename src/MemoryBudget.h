@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Central memory budget for the data the tool keeps while it runs: chart
+// histories, logs and capture buffers. Components register as consumers
+// and report how many bytes they hold; Enforce() sums them and, once the
+// total is over budget, or the whole process is over its resident limit,
+// asks consumers to shed memory until the total is back at the target.
+// Each consumer decides how: downsample old data, spill it to disk or
+// shrink a ring. Lower priorities are asked first.
+//
+// Registration is thread-safe. MemoryUsage() and Shed() are called on the
+// thread that calls Enforce(), with the registry locked, so consumers must
+// not register or unregister from inside them.
+class MemoryBudget {
+ public:
+  class Consumer {
+   public:
+    virtual ~Consumer() = default;
+    // Bytes held, an estimate is fine
+    virtual size_t MemoryUsage() const = 0;
+    // Release about bytes; returns the bytes actually released
+    virtual size_t Shed(size_t bytes) = 0;
+  };
+
+  // Unregisters on destruction; keep it as a member of the consumer
+  class Registration {
+   public:
+    Registration() = default;
+    Registration(Registration&& other) noexcept;
+    Registration& operator=(Registration&& other) noexcept;
+    ~Registration();
+
+   private:
+    friend class MemoryBudget;
+    Registration(MemoryBudget* budget, Consumer* consumer)
+        : budget_(budget), consumer_(consumer) {}
+
+    MemoryBudget* budget_ = nullptr;
+    Consumer* consumer_ = nullptr;
+  };
+
+  struct Config {
+    size_t budget_bytes = 256u << 20;    // Registered consumers together
+    size_t resident_limit = 1536u << 20;  // Whole process; 0: not checked
+    double target = 0.75;  // Shed down to this fraction of the budget
+  };
+
+  struct Usage {
+    std::string name;
+    int priority = 0;
+    size_t bytes = 0;
+  };
+
+  struct Report {
+    size_t usage = 0;     // Before shedding
+    size_t shed = 0;
+    size_t resident = 0;  // Process resident set, 0 if unknown
+  };
+
+  // The process-wide budget
+  static MemoryBudget& Global();
+
+  MemoryBudget() = default;
+  explicit MemoryBudget(const Config& config) : config_(config) {}
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  void SetConfig(const Config& config);
+  Config config() const;
+
+  [[nodiscard]] Registration Register(const std::string& name,
+                                      Consumer* consumer, int priority = 0);
+
+  std::vector<Usage> Usages() const;
+  Report Enforce();
+
+  // Resident set size of this process from /proc, 0 if unavailable
+  static size_t ResidentBytes();
+
+ private:
+  struct Entry {
+    std::string name;
+    Consumer* consumer;
+    int priority;
+  };
+
+  void Unregister(Consumer* consumer);
+
+  mutable std::mutex mutex_;
+  Config config_;
+  std::vector<Entry> entries_;  // By priority, then registration order
+};
@@ -0,0 +1,226 @@
+#include "PlanExecutor.h"
+
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+PlanExecutor::PlanExecutor(const QString &port, const TestPlan &plan, const StationConfig &config,
+                           Scheduler *scheduler, Link link)
+    : plan_(plan), config_(config), scheduler_(scheduler), link_(std::move(link)) {
+    result_.port = port;
+}
+
+PlanExecutor::~PlanExecutor() {
+    StopTicking();
+}
+
+void PlanExecutor::Start() {
+    start_ = scheduler_->Now();
+}
+
+qint64 PlanExecutor::ElapsedMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(scheduler_->Now() - start_).count();
+}
+
+void PlanExecutor::Run() {
+    nextTick_ = scheduler_->Now();
+    ScheduleTick();
+    EnterStep(0);
+}
+
+void PlanExecutor::ScheduleTick() {
+    // A tick that ran late is not followed by a burst of catch-up ticks
+    nextTick_ = std::max(nextTick_ + std::chrono::milliseconds(config_.periodMs), scheduler_->Now());
+    tickTimer_ = scheduler_->ScheduleAt(nextTick_, [this]() {
+        tickTimer_ = 0;
+        ScheduleTick();
+        OnTick();
+    });
+}
+
+void PlanExecutor::StopTicking() {
+    if (tickTimer_ != 0) scheduler_->Cancel(tickTimer_);
+    tickTimer_ = 0;
+}
+
+void PlanExecutor::EnterStep(size_t index) {
+    stepIndex_ = index;
+    stepStartMs_ = ElapsedMs();
+
+    if (index >= plan_.steps.size()) {
+        done_ = true;
+        StopTicking();
+        link_.setSpeeds({0, 0, 0, 0});
+        result_.durationMs = ElapsedMs();
+        MaybeFinish();
+        return;
+    }
+
+    const TestStep &step = plan_.steps[index];
+    switch (step.type) {
+        case TestStep::Type::kSpeed:
+            setpoint_ = step.target_rpm;
+            OnTick();
+            CompleteStep(true, QString());
+            break;
+        case TestStep::Type::kRamp:
+            rampStart_ = setpoint_;
+            break;
+        case TestStep::Type::kHold:
+            holdSamples_.clear();
+            holdSetpoint_ = setpoint_;
+            break;
+        case TestStep::Type::kCheckRpm:
+            StartRpmCheck(step.tolerance_pct);
+            break;
+        case TestStep::Type::kReadImu:
+            waitingImu_ = true;
+            link_.requestImu();
+            break;
+        case TestStep::Type::kStop:
+            setpoint_ = 0;
+            OnTick();
+            CompleteStep(true, QString());
+            break;
+    }
+}
+
+void PlanExecutor::CompleteStep(bool passed, const QString &detail) {
+    const TestStep &step = plan_.steps[stepIndex_];
+    result_.steps.push_back({QString::fromStdString(step.Describe()), passed, detail});
+    if (!passed) result_.passed = false;
+    EnterStep(stepIndex_ + 1);
+}
+
+void PlanExecutor::OnTick() {
+    if (done_) return;
+
+    qint64 elapsed = ElapsedMs() - stepStartMs_;
+    const TestStep &step = plan_.steps[stepIndex_];
+
+    if (step.type == TestStep::Type::kRamp) {
+        double fraction = std::min(1.0, static_cast<double>(elapsed) / step.duration_ms);
+        setpoint_ = rampStart_ + (step.target_rpm - rampStart_) * fraction;
+    }
+
+    int speed = static_cast<int>(std::lround(setpoint_));
+    link_.setSpeeds({speed, speed, speed, speed});
+    link_.requestEncoders();
+
+    if (step.type == TestStep::Type::kRamp && elapsed >= step.duration_ms) {
+        CompleteStep(true, QString());
+    } else if (step.type == TestStep::Type::kHold && elapsed >= step.duration_ms) {
+        CompleteStep(true, QString("%1 samples").arg(static_cast<int>(holdSamples_.size())));
+    } else if (step.type == TestStep::Type::kReadImu && elapsed >= config_.timeoutMs) {
+        waitingImu_ = false;
+        CompleteStep(false, "Timeout waiting for IMU data");
+    }
+}
+
+void PlanExecutor::OnEncoders(const std::vector<float> &values) {
+    if (done_ || values.size() < 4) return;
+    if (plan_.steps[stepIndex_].type != TestStep::Type::kHold) return;
+
+    EncoderSample sample;
+    sample.timeMs = ElapsedMs();
+    std::copy(values.begin(), values.begin() + 4, sample.ticks);
+    holdSamples_.push_back(sample);
+}
+
+void PlanExecutor::OnImu(const ImuData &data) {
+    if (!waitingImu_) return;
+    waitingImu_ = false;
+    CompleteStep(true, QString("accel=(%1, %2, %3)")
+                           .arg(data.accel_x).arg(data.accel_y).arg(data.accel_z));
+}
+
+bool PlanExecutor::CheckRpm(const std::vector<EncoderSample> &samples, double setpoint, int ticksPerRev,
+                            double tolerancePct, QString &detail) {
+    double totalTicks[4] = {0, 0, 0, 0};
+    for (size_t i = 1; i < samples.size(); ++i) {
+        for (int m = 0; m < 4; ++m) totalTicks[m] += samples[i].ticks[m];
+    }
+    double dtMs = static_cast<double>(samples.back().timeMs - samples.front().timeMs);
+    if (dtMs <= 0) {
+        detail = "Zero-length hold window";
+        return false;
+    }
+
+    bool passed = true;
+    QStringList parts;
+    for (int m = 0; m < 4 && passed; ++m) {
+        double rpm = (totalTicks[m] / ticksPerRev) * (60000.0 / dtMs);
+        // Zero setpoint: tolerance is interpreted as absolute RPM
+        double error = setpoint != 0 ? std::abs(rpm - setpoint) / std::abs(setpoint) * 100.0
+                                     : std::abs(rpm);
+        if (error >= tolerancePct) passed = false;
+        parts << QString("M%1 %2 rpm (%3%)").arg(m + 1).arg(rpm, 0, 'f', 1).arg(error, 0, 'f', 1);
+    }
+    detail = parts.join(", ");
+    return passed;
+}
+
+void PlanExecutor::StartRpmCheck(double tolerancePct) {
+    const TestStep &step = plan_.steps[stepIndex_];
+    if (holdSamples_.size() < 2) {
+        CompleteStep(false, "No encoder samples from a preceding hold");
+        return;
+    }
+
+    // The analysis may run elsewhere; the step is reported as pending and the
+    // plan continues so the station's stimulus timing is unaffected.
+    size_t resultIndex = result_.steps.size();
+    result_.steps.push_back({QString::fromStdString(step.Describe()), false, "pending"});
+    pendingAnalyses_++;
+
+    struct Analysis {
+        std::vector<EncoderSample> samples;
+        bool passed = false;
+        QString detail;
+    };
+    auto analysis = std::make_shared<Analysis>();
+    analysis->samples.swap(holdSamples_);
+    double setpoint = holdSetpoint_;
+    int ticksPerRev = config_.ticksPerRev;
+
+    auto work = [analysis, setpoint, ticksPerRev, tolerancePct]() {
+        analysis->passed = CheckRpm(analysis->samples, setpoint, ticksPerRev, tolerancePct, analysis->detail);
+    };
+    auto done = [this, analysis, resultIndex]() {
+        OnAnalysisDone(resultIndex, analysis->passed, analysis->detail);
+    };
+    if (link_.offload) {
+        link_.offload(std::move(work), std::move(done));
+        EnterStep(stepIndex_ + 1);
+    } else {
+        // Inline, but still reported after the plan moved on, as when offloaded
+        work();
+        EnterStep(stepIndex_ + 1);
+        done();
+    }
+}
+
+void PlanExecutor::OnAnalysisDone(size_t resultIndex, bool passed, const QString &detail) {
+    result_.steps[resultIndex].passed = passed;
+    result_.steps[resultIndex].detail = detail;
+    if (!passed) result_.passed = false;
+    pendingAnalyses_--;
+    MaybeFinish();
+}
+
+void PlanExecutor::Abort(const QString &reason) {
+    if (done_) return;
+    result_.steps.push_back({"connection", false, reason});
+    result_.passed = false;
+    done_ = true;
+    StopTicking();
+    result_.durationMs = ElapsedMs();
+    MaybeFinish();
+}
+
+void PlanExecutor::MaybeFinish() {
+    if (!done_ || pendingAnalyses_ > 0 || finishedEmitted_) return;
+    finishedEmitted_ = true;
+    if (link_.finished) link_.finished();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QString>
+#include <functional>
+#include <vector>
+#include "ECUConnector.h"
+#include "Scheduler.h"
+#include "TestPlan.h"
+
+struct StepResult {
+    QString step;
+    bool passed = false;
+    QString detail;
+};
+
+struct UnitResult {
+    QString port;
+    bool passed = true;
+    qint64 durationMs = 0;
+    std::vector<StepResult> steps;
+};
+
+struct StationConfig {
+    int baud = 115200;
+    int periodMs = 50;
+    int ticksPerRev = 1328;
+    int timeoutMs = 500;
+};
+
+// The control loop of one station: steps through a test plan, ticks the
+// setpoint and encoder polls every period and collects the results. It only
+// talks to the ECU through Link and only reads time from its Scheduler, so
+// Station runs it on a serial port in real time and VirtualRig against the
+// simulator in virtual time. All calls on the scheduler's thread.
+class PlanExecutor {
+public:
+    struct Link {
+        std::function<void(const std::vector<int> &speeds)> setSpeeds;
+        std::function<void()> requestEncoders;
+        std::function<void()> requestImu;
+        // Runs analysis, possibly on another thread, then done on the
+        // scheduler's thread; both inline if unset
+        std::function<void(std::function<void()> analysis, std::function<void()> done)> offload;
+        // The plan has ended and every analysis is in
+        std::function<void()> finished;
+    };
+
+    PlanExecutor(const QString &port, const TestPlan &plan, const StationConfig &config,
+                 Scheduler *scheduler, Link link);
+    ~PlanExecutor();
+
+    // Starts the unit's clock, before connecting
+    void Start();
+    // The link is up: starts ticking at the first step
+    void Run();
+    void OnEncoders(const std::vector<float> &values);
+    void OnImu(const ImuData &data);
+    void Abort(const QString &reason);
+
+    bool IsDone() const { return done_; }
+    const UnitResult& Result() const { return result_; }
+
+    // Mean RPM of each motor over a hold against its setpoint; encoder values
+    // are per-poll deltas, so the first sample only marks the start
+    struct EncoderSample {
+        qint64 timeMs;
+        float ticks[4];
+    };
+    static bool CheckRpm(const std::vector<EncoderSample> &samples, double setpoint, int ticksPerRev,
+                         double tolerancePct, QString &detail);
+
+private:
+    qint64 ElapsedMs() const;
+    void ScheduleTick();
+    void OnTick();
+    void EnterStep(size_t index);
+    void CompleteStep(bool passed, const QString &detail);
+    void StartRpmCheck(double tolerancePct);
+    void OnAnalysisDone(size_t resultIndex, bool passed, const QString &detail);
+    void StopTicking();
+    void MaybeFinish();
+
+    TestPlan plan_;
+    StationConfig config_;
+    Scheduler *scheduler_;
+    Link link_;
+
+    Scheduler::Clock::time_point start_;
+    // Ticks are scheduled at multiples of the period from Run(), so a
+    // slightly late tick does not shift the ones after it
+    Scheduler::Clock::time_point nextTick_;
+    Scheduler::TimerId tickTimer_ = 0;
+
+    size_t stepIndex_ = 0;
+    qint64 stepStartMs_ = 0;
+    double setpoint_ = 0;
+    double rampStart_ = 0;
+    bool waitingImu_ = false;
+    bool done_ = false;
+    bool finishedEmitted_ = false;
+    int pendingAnalyses_ = 0;
+
+    std::vector<EncoderSample> holdSamples_;
+    double holdSetpoint_ = 0;
+
+    UnitResult result_;
+};
@@ -0,0 +1,107 @@
+#include "ProductionRunner.h"
+
+#include <QMetaObject>
+#include <thread>
+
+Station::Station(const QString &port, const TestPlan &plan, const StationConfig &config,
+                 IoReactor *reactor, WorkerPool *pool, QObject *parent)
+    : QObject(parent), port_(port), config_(config), reactor_(reactor) {
+    connector_ = new ECUConnector(this);
+    connect(connector_, &ECUConnector::ConnectionChanged, this, &Station::OnConnectionChanged);
+    connect(connector_, &ECUConnector::ErrorOccurred, this, &Station::OnError);
+
+    PlanExecutor::Link link;
+    link.setSpeeds = [this](const std::vector<int> &speeds) { connector_->SetAllMotorsSpeed(speeds); };
+    link.requestEncoders = [this]() { connector_->GetAllEncoders(); };
+    link.requestImu = [this]() { connector_->GetImu(); };
+    // Analysis runs on the shared pool, its result is reported back here
+    link.offload = [this, pool](std::function<void()> analysis, std::function<void()> done) {
+        pool->Post([this, analysis = std::move(analysis), done = std::move(done)]() {
+            analysis();
+            QMetaObject::invokeMethod(this, done, Qt::QueuedConnection);
+        });
+    };
+    link.finished = [this]() {
+        connector_->Disconnect();
+        emit Finished();
+    };
+    executor_ = std::make_unique<PlanExecutor>(port, plan, config, connector_->Executor(), std::move(link));
+
+    connect(connector_, &ECUConnector::EncoderValuesUpdated, this, [this](const std::vector<float> &values) {
+        executor_->OnEncoders(values);
+    });
+    connect(connector_, &ECUConnector::ImuDataReceived, this, [this](const ImuData &data) {
+        executor_->OnImu(data);
+    });
+}
+
+void Station::Start() {
+    executor_->Start();
+    connector_->Connect(port_, config_.baud, reactor_);
+}
+
+void Station::OnConnectionChanged(bool connected) {
+    if (connected) {
+        executor_->Run();
+    } else if (!executor_->IsDone()) {
+        executor_->Abort(lastError_.isEmpty() ? QString("Disconnected") : lastError_);
+    }
+}
+
+void Station::OnError(const QString &message) {
+    lastError_ = message;
+}
+
+// --- ProductionRunner ---
+
+ProductionRunner::ProductionRunner(const QStringList &ports, const TestPlan &plan,
+                                   const StationConfig &config, QObject *parent)
+    : QObject(parent) {
+    reactor_ = std::make_unique<IoReactor>();
+    unsigned cores = std::thread::hardware_concurrency();
+    pool_ = std::make_unique<WorkerPool>(cores > 2 ? cores - 1 : 2);
+
+    for (const QString &port : ports) {
+        auto *station = new Station(port, plan, config, reactor_.get(), pool_.get(), this);
+        connect(station, &Station::Finished, this, &ProductionRunner::OnStationFinished);
+        stations_.push_back(station);
+    }
+}
+
+ProductionRunner::~ProductionRunner() {
+    // Drain analysis first, then close ports while the reactor still exists
+    pool_.reset();
+    for (auto *station : stations_) delete station;
+    stations_.clear();
+    reactor_.reset();
+}
+
+void ProductionRunner::Start() {
+    remaining_ = static_cast<int>(stations_.size());
+    if (remaining_ == 0) {
+        emit Finished(0);
+        return;
+    }
+    reactor_->Start();
+    for (auto *station : stations_) {
+        station->Start();
+    }
+}
+
+std::vector<UnitResult> ProductionRunner::Results() const {
+    std::vector<UnitResult> results;
+    for (const auto *station : stations_) {
+        results.push_back(station->Result());
+    }
+    return results;
+}
+
+void ProductionRunner::OnStationFinished() {
+    if (--remaining_ > 0) return;
+
+    int failed = 0;
+    for (const auto *station : stations_) {
+        if (!station->Result().passed) failed++;
+    }
+    emit Finished(failed);
+}
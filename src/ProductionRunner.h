@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <memory>
+#include <vector>
+#include "ECUConnector.h"
+#include "IoReactor.h"
+#include "PlanExecutor.h"
+#include "TestPlan.h"
+#include "WorkerPool.h"
+
+// Runs one test plan against one ECU on a serial port. All step timing is
+// measured on the station's own clock, so a late tick on one station never
+// shifts another.
+class Station : public QObject {
+    Q_OBJECT
+public:
+    Station(const QString &port, const TestPlan &plan, const StationConfig &config,
+            IoReactor *reactor, WorkerPool *pool, QObject *parent = nullptr);
+
+    void Start();
+    const UnitResult& Result() const { return executor_->Result(); }
+
+signals:
+    void Finished();
+
+private slots:
+    void OnConnectionChanged(bool connected);
+    void OnError(const QString &message);
+
+private:
+    QString port_;
+    StationConfig config_;
+    IoReactor *reactor_;
+
+    ECUConnector *connector_;
+    // Timed by the connector's executor, on the wall clock
+    std::unique_ptr<PlanExecutor> executor_;
+    QString lastError_;
+};
+
+// Executes the same test plan on N serial ports concurrently. Stations share
+// one I/O reactor and one worker pool for analysis.
+class ProductionRunner : public QObject {
+    Q_OBJECT
+public:
+    ProductionRunner(const QStringList &ports, const TestPlan &plan,
+                     const StationConfig &config, QObject *parent = nullptr);
+    ~ProductionRunner();
+
+    void Start();
+    std::vector<UnitResult> Results() const;
+
+signals:
+    void Finished(int failedUnits);
+
+private:
+    void OnStationFinished();
+
+    std::unique_ptr<IoReactor> reactor_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::vector<Station*> stations_;
+    int remaining_ = 0;
+};
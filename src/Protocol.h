@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+
+// Command identifiers and capability levels of the chassis controller
+// protocol (see doc/protocol.md).
+namespace protocol {
+
+constexpr uint8_t kGetApiVersion = 0x01;
+constexpr uint8_t kSetMotorSpeed = 0x02;
+constexpr uint8_t kSetAllMotorsSpeed = 0x03;
+constexpr uint8_t kGetEncoder = 0x04;
+constexpr uint8_t kGetAllEncoders = 0x05;
+constexpr uint8_t kGetImu = 0x06;
+constexpr uint8_t kSubscribe = 0x07;
+constexpr uint8_t kGetTelemetry = 0x08;
+constexpr uint8_t kBurst = 0x09;
+constexpr uint8_t kSetFraming = 0x0A;
+constexpr uint8_t kTimeSync = 0x0B;
+constexpr uint8_t kPing = 0x0C;
+constexpr uint8_t kSegment = 0x0D;
+constexpr uint8_t kSegmentAck = 0x0E;
+constexpr uint8_t kReadLog = 0x0F;
+constexpr uint8_t kFirmware = 0x10;
+
+// Unsolicited stream frames reuse the command id of the polled equivalent
+// with the high bit set.
+constexpr uint8_t kStreamFlag = 0x80;
+constexpr uint8_t kEncoderStream = kStreamFlag | kGetAllEncoders;
+constexpr uint8_t kImuStream = kStreamFlag | kGetImu;
+
+// From kApiTimeSync, stream frames end with the ECU capture time in
+// microseconds (uint32, big-endian, wraps)
+constexpr int kStreamTimestampSize = 4;
+
+// Stream selection bits for subscribe
+constexpr uint8_t kStreamEncoders = 0x01;
+constexpr uint8_t kStreamImu = 0x02;
+
+// Field selection bits for get_telemetry. Blocks appear in the response in
+// bit order; kTelemetryLayout is bumped whenever a field is added.
+constexpr uint8_t kFieldEncoders = 0x01;
+constexpr uint8_t kFieldImu = 0x02;
+constexpr uint8_t kFieldStatus = 0x04;
+// Layout 2: compact variants, each replacing its plain block when both are set
+constexpr uint8_t kFieldEncodersCompact = 0x08;  // Zigzag varint deltas
+constexpr uint8_t kFieldImuCompact = 0x10;       // int16 fixed point
+constexpr uint8_t kTelemetryLayout = 2;
+constexpr uint8_t kTelemetryFieldsV1 = kFieldEncoders | kFieldImu | kFieldStatus;
+constexpr uint8_t kTelemetryFieldsV2 = kTelemetryFieldsV1 | kFieldEncodersCompact | kFieldImuCompact;
+
+// burst operations and flags. The ECU samples the encoders into its own
+// buffer at the burst rate; the host drains it with read requests.
+constexpr uint8_t kBurstStop = 0x00;
+constexpr uint8_t kBurstStart = 0x01;
+constexpr uint8_t kBurstRead = 0x02;
+constexpr uint8_t kBurstOverrun = 0x01;  // ECU buffer overflowed since the last read
+constexpr int kBurstMaxRateHz = 2000;
+// Lowest rate whose period in µs still fits the 16-bit period_us field
+constexpr int kBurstMinRateHz = 16;
+constexpr int kBurstHeaderSize = 14;   // Cmd, op, flags, index, time, period, count
+constexpr int kBurstSampleSize = 8;    // 4 x int16 encoder deltas, big-endian
+constexpr int kBurstMaxSamples = 29;   // Largest batch that fits one frame
+
+// set_framing modes. The acknowledgement still uses the old framing; both
+// directions switch right after it.
+constexpr uint8_t kFramingLegacy = 0x00;  // 0xAA, length, payload, CRC
+constexpr uint8_t kFramingCobs = 0x01;    // COBS(payload, CRC), 0x00
+
+// time_sync response: cmd, seq, ECU receive and transmit time (uint64 µs,
+// big-endian)
+constexpr int kTimeSyncResponseSize = 18;
+
+// ping: cmd, seq (2), reply length, then data to echo. The response carries
+// cmd, seq and reply length bytes of data.
+constexpr int kPingRequestHeaderSize = 4;
+constexpr int kPingResponseHeaderSize = 3;
+constexpr int kPingMaxData = 248;  // Largest data that fits either frame
+
+// segment: cmd, transfer id, seq (2), last seq (2), data. segment_ack: cmd,
+// transfer id, next expected seq (2), bitmap of the 32 seqs after it (4),
+// all big-endian. Payloads larger than one frame travel as segments in either
+// direction; see Segmenter.
+constexpr int kSegmentHeaderSize = 6;
+constexpr int kSegmentAckSize = 8;
+
+// read_log request: cmd, offset (uint32), max length (uint16). Response: cmd,
+// offset, total log size (uint32), then up to max length bytes of log text.
+constexpr int kReadLogRequestSize = 7;
+constexpr int kReadLogResponseHeaderSize = 9;
+
+// firmware operations (request byte 1). begin: image size (uint32), block
+// size (uint16). write: block number (uint16), CRC-32 of the data (uint32),
+// data. finish: SHA-256 of the image. abort. All responses echo cmd and op;
+// write adds the block number, status and the number of leading blocks
+// programmed (uint16), finish adds the SHA-256 the ECU computed.
+constexpr uint8_t kFirmwareBegin = 0x00;
+constexpr uint8_t kFirmwareWrite = 0x01;
+constexpr uint8_t kFirmwareFinish = 0x02;
+constexpr uint8_t kFirmwareAbort = 0x03;
+constexpr int kFirmwareWriteHeaderSize = 8;
+constexpr int kFirmwareWriteResponseSize = 7;
+constexpr int kFirmwareHashSize = 32;
+constexpr int kFirmwareMaxBlockSize = 16384;
+
+// firmware status codes
+constexpr uint8_t kFirmwareOk = 0x00;
+constexpr uint8_t kFirmwareRejected = 0x01;   // begin: image or block size; write: no session or bad block
+constexpr uint8_t kFirmwareCrcError = 0x02;   // write: data did not match its CRC after programming
+constexpr uint8_t kFirmwareIncomplete = 0x03; // finish: blocks missing
+constexpr uint8_t kFirmwareHashError = 0x04;  // finish: image does not match the hash
+
+// Status flags reported in the status block
+constexpr uint8_t kStatusFailsafe = 0x01;  // Link timeout stopped the motors
+
+// Minimum API version reported by get_api_version for each extension
+constexpr int kApiStreaming = 2;
+constexpr int kApiTelemetry = 3;
+constexpr int kApiCompact = 4;  // get_telemetry layout 2
+constexpr int kApiBurst = 5;
+constexpr int kApiCobs = 6;
+constexpr int kApiTimeSync = 7;  // time_sync, timestamped stream frames
+constexpr int kApiPing = 8;
+constexpr int kApiSegmentation = 9;  // segment, segment_ack, read_log
+constexpr int kApiFirmware = 10;
+// Newest API version this code base implements
+constexpr int kApiLatest = kApiFirmware;
+
+constexpr int kEncoderPayloadSize = 16;  // 4 x int32, big-endian
+constexpr int kImuPayloadSize = 52;      // 13 x float32, little-endian
+constexpr int kStatusPayloadSize = 5;    // uint32 ECU time in ms (big-endian) + flags
+
+}  // namespace protocol
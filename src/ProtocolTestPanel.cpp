@@ -5,11 +5,28 @@
 #include <QHBoxLayout>
 #include <QGroupBox>
 #include <QLabel>
+#include <QCoreApplication>
 #include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextStream>
+
+namespace {
+
+// Rough size of one logged character: the UTF-16 text plus block and
+// layout data
+constexpr size_t kLogBytesPerChar = 8;
+// Lines that always stay in the widget
+constexpr int kLogLinesKept = 1000;
+
+}  // namespace
 
 ProtocolTestPanel::ProtocolTestPanel(ECUConnector* connector, QWidget *parent)
     : QWidget(parent), connector_(connector), loggingEnabled_(false) {
     SetupUi();
+    memoryRegistration_ = MemoryBudget::Global().Register("protocol log", this);
     
     connect(connector_, &ECUConnector::ApiVersionReceived, this, [this](int version){
         OnLogMessage(QString("RX <- get_api_version response: API version = %1").arg(version));
@@ -38,10 +55,28 @@ ProtocolTestPanel::ProtocolTestPanel(ECUConnector* connector, QWidget *parent)
         OnLogMessage(msg);
     });
 
+    connect(connector_, &ECUConnector::StatusReceived, this, [this](const EcuStatus& status){
+        OnLogMessage(QString("RX <- get_telemetry status: ECU time = %1 ms, flags = 0x%2")
+                         .arg(status.ecuTimeMs).arg(status.flags, 2, 16, QChar('0')));
+    });
+
+    connect(connector_, &ECUConnector::PingReceived, this,
+            [this](uint16_t seq, int replyBytes, std::chrono::steady_clock::time_point rxTime){
+        // Only time the request sent from this panel
+        if (seq != pingSeq_) return;
+        auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(rxTime - pingSent_);
+        OnLogMessage(QString("RX <- ping response: seq=%1 bytes=%2 RTT=%3 us")
+                         .arg(seq).arg(replyBytes).arg(qint64(rtt.count())));
+    });
+
     connect(connector_, &ECUConnector::RawDataSent, this, &ProtocolTestPanel::OnRawDataSent);
     connect(connector_, &ECUConnector::RawDataReceived, this, &ProtocolTestPanel::OnRawDataReceived);
 }
 
+ProtocolTestPanel::~ProtocolTestPanel() {
+    RemoveSpillFile();
+}
+
 void ProtocolTestPanel::SetupUi() {
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
     
@@ -58,7 +93,9 @@ void ProtocolTestPanel::SetupUi() {
         "set_all_motors_speed (0x03)",
         "get_encoder (0x04)", // Not implemented in Connector yet
         "get_all_encoders (0x05)",
-        "get_imu (0x06)"
+        "get_imu (0x06)",
+        "get_telemetry (0x08)",
+        "ping (0x0C)"
     });
     connect(cmdCombo_, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ProtocolTestPanel::OnCommandChanged);
     cmdLayout->addWidget(cmdCombo_);
@@ -111,6 +148,30 @@ void ProtocolTestPanel::SetupUi() {
     // 5: get_imu
     paramsStack_->addWidget(new QWidget());
     
+    // 6: get_telemetry
+    QWidget* pageTelemetry = new QWidget();
+    QHBoxLayout* layoutTelemetry = new QHBoxLayout(pageTelemetry);
+    layoutTelemetry->addWidget(new QLabel("Fields:"));
+    telemetryEncodersCheck_ = new QCheckBox("Encoders");
+    telemetryImuCheck_ = new QCheckBox("IMU");
+    telemetryStatusCheck_ = new QCheckBox("Status");
+    for (QCheckBox* check : {telemetryEncodersCheck_, telemetryImuCheck_, telemetryStatusCheck_}) {
+        check->setChecked(true);
+        layoutTelemetry->addWidget(check);
+    }
+    layoutTelemetry->addStretch();
+    paramsStack_->addWidget(pageTelemetry);
+    
+    // 7: ping
+    QWidget* pagePing = new QWidget();
+    QHBoxLayout* layoutPing = new QHBoxLayout(pagePing);
+    layoutPing->addWidget(new QLabel("Data bytes:"));
+    pingSizeSpin_ = new QSpinBox();
+    pingSizeSpin_->setRange(0, protocol::kPingMaxData);
+    layoutPing->addWidget(pingSizeSpin_);
+    layoutPing->addStretch();
+    paramsStack_->addWidget(pagePing);
+    
     inputLayout->addWidget(paramsStack_);
     
     sendButton_ = new QPushButton("Send Command");
@@ -124,7 +185,12 @@ void ProtocolTestPanel::SetupUi() {
     QVBoxLayout* logLayout = new QVBoxLayout(logGroup);
     logText_ = new QTextEdit();
     logText_->setReadOnly(true);
+    // Appended lines would otherwise also be kept on the undo stack
+    logText_->setUndoRedoEnabled(false);
     logLayout->addWidget(logText_);
+    QPushButton* clearButton = new QPushButton("Clear Log");
+    connect(clearButton, &QPushButton::clicked, this, &ProtocolTestPanel::ClearLog);
+    logLayout->addWidget(clearButton);
     mainLayout->addWidget(logGroup);
 }
 
@@ -172,6 +238,35 @@ void ProtocolTestPanel::OnSendClicked() {
             OnLogMessage("TX -> get_imu (0x06)");
             connector_->GetImu();
             break;
+        case 6: // get_telemetry
+        {
+            if (!connector_->SupportsTelemetry()) {
+                OnLogMessage(QString("Error: get_telemetry needs API version %1, ECU reports %2")
+                                 .arg(protocol::kApiTelemetry).arg(connector_->ApiVersion()));
+                break;
+            }
+            uint8_t fields = 0;
+            if (telemetryEncodersCheck_->isChecked()) fields |= protocol::kFieldEncoders;
+            if (telemetryImuCheck_->isChecked()) fields |= protocol::kFieldImu;
+            if (telemetryStatusCheck_->isChecked()) fields |= protocol::kFieldStatus;
+            OnLogMessage(QString("TX -> get_telemetry (0x08) fields=0x%1").arg(fields, 2, 16, QChar('0')));
+            connector_->GetTelemetry(fields);
+            break;
+        }
+        case 7: // ping
+        {
+            if (!connector_->SupportsPing()) {
+                OnLogMessage(QString("Error: ping needs API version %1, ECU reports %2")
+                                 .arg(protocol::kApiPing).arg(connector_->ApiVersion()));
+                break;
+            }
+            std::vector<uint8_t> data(pingSizeSpin_->value());
+            for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i);
+            OnLogMessage(QString("TX -> ping (0x0C) seq=%1 bytes=%2").arg(++pingSeq_).arg(data.size()));
+            pingSent_ = std::chrono::steady_clock::now();
+            connector_->Ping(pingSeq_, data, static_cast<int>(data.size()));
+            break;
+        }
     }
 }
 
@@ -199,3 +294,50 @@ void ProtocolTestPanel::OnRawDataReceived(const std::vector<uint8_t>& data) {
     for (uint8_t b : data) hex += QString("%1 ").arg(b, 2, 16, QChar('0')).toUpper();
     OnLogMessage(QString("RX RAW: [ %1]").arg(hex));
 }
+
+void ProtocolTestPanel::ClearLog() {
+    logText_->clear();
+    RemoveSpillFile();
+}
+
+void ProtocolTestPanel::RemoveSpillFile() {
+    // Spilled lines are part of the log being discarded
+    if (spillFile_.fileName().isEmpty()) return;
+    spillFile_.remove();
+    spillFile_.setFileName(QString());
+}
+
+size_t ProtocolTestPanel::MemoryUsage() const {
+    return static_cast<size_t>(logText_->document()->characterCount()) * kLogBytesPerChar;
+}
+
+size_t ProtocolTestPanel::Shed(size_t bytes) {
+    QTextDocument* document = logText_->document();
+    int spillable = document->blockCount() - kLogLinesKept;
+    if (spillable <= 0) return 0;
+    if (!spillFile_.isOpen()) {
+        spillFile_.setFileName(QDir::temp().filePath(
+            QString("ecu_pts_protocol_log_%1.txt").arg(QCoreApplication::applicationPid())));
+        if (!spillFile_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            qWarning() << "protocol log: cannot spill to" << spillFile_.fileName();
+            return 0;
+        }
+        qInfo() << "protocol log: older lines moved to" << spillFile_.fileName();
+    }
+
+    // Oldest lines first, until enough is freed
+    QTextStream out(&spillFile_);
+    QTextBlock block = document->begin();
+    size_t freed = 0;
+    for (int lines = 0; lines < spillable && freed < bytes; ++lines) {
+        out << block.text() << '\n';
+        freed += static_cast<size_t>(block.length()) * kLogBytesPerChar;
+        block = block.next();
+    }
+    out.flush();
+
+    QTextCursor cursor(document);
+    cursor.setPosition(block.position(), QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    return freed;
+}
@@ -1,22 +1,31 @@
 #pragma once
 
 #include <QWidget>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QStackedWidget>
 #include <QSpinBox>
 #include <QTextEdit>
 #include <QPushButton>
+#include <QFile>
+#include <chrono>
+#include "MemoryBudget.h"
 
 class ECUConnector;
 
-class ProtocolTestPanel : public QWidget {
+class ProtocolTestPanel : public QWidget, private MemoryBudget::Consumer {
     Q_OBJECT
 
 public:
     explicit ProtocolTestPanel(ECUConnector* connector, QWidget *parent = nullptr);
+    ~ProtocolTestPanel() override;
     
     void SetLoggingEnabled(bool enabled);
 
+public slots:
+    // Also deletes the lines spilled to disk
+    void ClearLog();
+
 private slots:
     void OnCommandChanged(int index);
     void OnSendClicked();
@@ -27,6 +36,12 @@ private slots:
 private:
     void SetupUi();
 
+    // The log is the one history here that grows without bound: under
+    // memory pressure its oldest lines are moved to a file
+    size_t MemoryUsage() const override;
+    size_t Shed(size_t bytes) override;
+    void RemoveSpillFile();
+
     ECUConnector* connector_;
     bool loggingEnabled_;
     
@@ -44,4 +59,18 @@ private:
     
     // Params for SetAllMotorsSpeed
     QSpinBox* allSpeedsSpins_[4];
+    
+    // Params for GetTelemetry
+    QCheckBox* telemetryEncodersCheck_;
+    QCheckBox* telemetryImuCheck_;
+    QCheckBox* telemetryStatusCheck_;
+    
+    // Params for Ping
+    QSpinBox* pingSizeSpin_;
+    uint16_t pingSeq_ = 0;
+    std::chrono::steady_clock::time_point pingSent_;
+
+    // Removed with the log, on ClearLog() and on destruction
+    QFile spillFile_;
+    MemoryBudget::Registration memoryRegistration_;
 };
@@ -0,0 +1,34 @@
+#include "RenderGate.h"
+
+#include <QWidget>
+#include <QWindowStateChangeEvent>
+
+RenderGate::RenderGate(QWidget *widget) : QObject(widget), widget_(widget) {
+    widget_->installEventFilter(this);
+    WatchWindow();
+}
+
+bool RenderGate::IsOpen() const {
+    return widget_->isVisible() && !widget_->window()->isMinimized();
+}
+
+void RenderGate::WatchWindow() {
+    QWidget *window = widget_->window();
+    if (window == window_) return;
+    if (window_) window_->removeEventFilter(this);
+    window_ = window;
+    if (window_ != widget_) window_->installEventFilter(this);
+}
+
+bool RenderGate::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == widget_) {
+        if (event->type() == QEvent::ParentChange || event->type() == QEvent::Show) WatchWindow();
+        // Shown because its tab became current, or together with its window
+        if (event->type() == QEvent::Show && IsOpen()) emit Opened();
+    } else if (watched == window_ && event->type() == QEvent::WindowStateChange) {
+        // Restored from minimised; children get no show event for that
+        auto *change = static_cast<QWindowStateChangeEvent *>(event);
+        if ((change->oldState() & Qt::WindowMinimized) && IsOpen()) emit Opened();
+    }
+    return false;
+}
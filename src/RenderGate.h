@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+
+class QWidget;
+
+// Tells a panel whether drawing is worth it: the widget is visible (its tab
+// is current) and its window is not minimised. While the gate is closed the
+// panel only stores incoming data; Opened() is emitted when the widget can be
+// seen again, so the panel can redraw its current window in one pass.
+class RenderGate : public QObject {
+    Q_OBJECT
+public:
+    explicit RenderGate(QWidget *widget);
+
+    bool IsOpen() const;
+
+signals:
+    void Opened();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void WatchWindow();
+
+    QWidget *widget_;
+    // Window of the widget, which changes when a lazily built tab is reparented
+    QPointer<QWidget> window_;
+};
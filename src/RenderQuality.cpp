@@ -0,0 +1,25 @@
+#include "RenderQuality.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <chrono>
+
+RenderQuality::RenderQuality(QObject *parent) : QObject(parent) {}
+
+void RenderQuality::AddFrame(qint64 paintNs) {
+    if (!budget_.AddFrame(std::chrono::nanoseconds(paintNs), std::chrono::steady_clock::now())) return;
+    qInfo().noquote() << QString("render quality level %1 (paint %2 ms)")
+                             .arg(budget_.level()).arg(budget_.average_ms(), 0, 'f', 1);
+    emit LevelChanged(budget_.level());
+}
+
+TimedChartView::TimedChartView(RenderQuality *quality, QWidget *parent)
+    : QChartView(parent), quality_(quality) {
+}
+
+void TimedChartView::paintEvent(QPaintEvent *event) {
+    QElapsedTimer timer;
+    timer.start();
+    QChartView::paintEvent(event);
+    if (quality_) quality_->AddFrame(timer.nsecsElapsed());
+}
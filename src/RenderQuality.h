@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QObject>
+#include <QtCharts/QChartView>
+#include "FrameBudget.h"
+
+// Render quality shared by the chart views. Views report their paint times;
+// when painting gets slower than the frame budget the level goes up and
+// panels shed cost in this order, and get it back when there is headroom.
+class RenderQuality : public QObject {
+    Q_OBJECT
+public:
+    enum Level {
+        Full = 0,
+        NoAnimations = 1,
+        NoAntialiasing = 2,
+        Decimated = 3,  // Only every other point is drawn
+    };
+
+    explicit RenderQuality(QObject *parent = nullptr);
+
+    int level() const { return budget_.level(); }
+    void AddFrame(qint64 paintNs);
+
+signals:
+    void LevelChanged(int level);
+
+private:
+    FrameBudget budget_;
+};
+
+// Chart view that reports the time of each paint to a RenderQuality
+class TimedChartView : public QChartView {
+    Q_OBJECT
+public:
+    explicit TimedChartView(RenderQuality *quality = nullptr, QWidget *parent = nullptr);
+
+    void SetRenderQuality(RenderQuality *quality) { quality_ = quality; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    RenderQuality *quality_;
+};
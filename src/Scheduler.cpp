@@ -0,0 +1,56 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+
+Scheduler::TimerId VirtualScheduler::ScheduleAt(Clock::time_point deadline,
+                                                std::function<void()> callback) {
+  // Time never runs backwards, not even for a callback that is overdue
+  deadline = std::max(deadline, now_);
+  TimerId id = next_id_++;
+  timers_.emplace(std::make_pair(deadline, id), std::move(callback));
+  deadlines_.emplace(id, deadline);
+  return id;
+}
+
+void VirtualScheduler::Cancel(TimerId id) {
+  auto it = deadlines_.find(id);
+  if (it == deadlines_.end()) return;
+  timers_.erase(std::make_pair(it->second, id));
+  deadlines_.erase(it);
+}
+
+bool VirtualScheduler::RunNext() {
+  if (timers_.empty()) return false;
+  auto node = timers_.extract(timers_.begin());
+  deadlines_.erase(node.key().second);
+  now_ = node.key().first;
+  node.mapped()();
+  return true;
+}
+
+void VirtualScheduler::RunUntil(Clock::time_point until) {
+  while (!timers_.empty() && timers_.begin()->first.first <= until) RunNext();
+  now_ = std::max(now_, until);
+}
+
+void RepeatingTimer::Start(Scheduler::Clock::duration interval) {
+  Stop();
+  interval_ = interval;
+  next_ = scheduler_->Now();
+  ScheduleNext();
+}
+
+void RepeatingTimer::Stop() {
+  if (id_ != 0) scheduler_->Cancel(id_);
+  id_ = 0;
+}
+
+void RepeatingTimer::ScheduleNext() {
+  next_ = std::max(next_ + interval_, scheduler_->Now());
+  id_ = scheduler_->ScheduleAt(next_, [this]() {
+    // The next tick is due before the callback can stop or restart the timer
+    id_ = 0;
+    ScheduleNext();
+    callback_();
+  });
+}
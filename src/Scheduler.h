@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+// Time source and timers for timing-dependent logic, so the same code runs
+// on the wall clock (AsyncExecutor, driven by the Qt event loop) or in
+// virtual time (VirtualScheduler, driven by a test harness).
+class Scheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using TimerId = uint64_t;
+
+  virtual ~Scheduler() = default;
+
+  virtual Clock::time_point Now() const = 0;
+  // Runs callback once at deadline on the scheduler's thread; a deadline in
+  // the past runs it as soon as possible, never from the caller's stack
+  virtual TimerId ScheduleAt(Clock::time_point deadline,
+                             std::function<void()> callback) = 0;
+  virtual void Cancel(TimerId id) = 0;
+
+  TimerId ScheduleAfter(Clock::duration delay, std::function<void()> callback) {
+    return ScheduleAt(Now() + delay, std::move(callback));
+  }
+};
+
+// Runs callback every interval on a Scheduler, the counterpart of a
+// repeating QTimer. Ticks stay on multiples of the interval from Start(), and
+// one that ran late is not followed by catch-up ticks. Stop() may be called
+// from the callback.
+class RepeatingTimer {
+ public:
+  RepeatingTimer(Scheduler* scheduler, std::function<void()> callback)
+      : scheduler_(scheduler), callback_(std::move(callback)) {}
+  ~RepeatingTimer() { Stop(); }
+  RepeatingTimer(const RepeatingTimer&) = delete;
+  RepeatingTimer& operator=(const RepeatingTimer&) = delete;
+
+  // Restarts the timer if it is already running
+  void Start(Scheduler::Clock::duration interval);
+  void Stop();
+  bool active() const { return id_ != 0; }
+  Scheduler::Clock::duration interval() const { return interval_; }
+
+ private:
+  void ScheduleNext();
+
+  Scheduler* scheduler_;
+  std::function<void()> callback_;
+  Scheduler::Clock::duration interval_{};
+  Scheduler::Clock::time_point next_;
+  Scheduler::TimerId id_ = 0;
+};
+
+// Virtual time: Now() only moves when the owner runs the scheduler, and each
+// callback runs with Now() at exactly its deadline, in deadline order and,
+// for equal deadlines, in the order scheduled. A run therefore reproduces
+// exactly, and an hour of timers takes only as long as the callbacks.
+// Single-threaded.
+class VirtualScheduler : public Scheduler {
+ public:
+  // Time starts well after the clock's epoch, so a default time_point still
+  // reads as "unset" to the code under test
+  explicit VirtualScheduler(Clock::time_point start = Clock::time_point(std::chrono::hours(1)))
+      : now_(start) {}
+
+  Clock::time_point Now() const override { return now_; }
+  TimerId ScheduleAt(Clock::time_point deadline,
+                     std::function<void()> callback) override;
+  void Cancel(TimerId id) override;
+
+  // Runs the next callback, moving time forward to it; false if none is
+  // pending
+  bool RunNext();
+  // Runs every callback due up to and including until, including those they
+  // schedule, then sets Now() to until
+  void RunUntil(Clock::time_point until);
+  void RunFor(Clock::duration duration) { RunUntil(now_ + duration); }
+
+  size_t pending() const { return timers_.size(); }
+
+ private:
+  Clock::time_point now_;
+  TimerId next_id_ = 1;
+  std::map<std::pair<Clock::time_point, TimerId>, std::function<void()>> timers_;
+  std::unordered_map<TimerId, Clock::time_point> deadlines_;
+};
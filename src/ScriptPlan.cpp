@@ -0,0 +1,136 @@
+#include "ScriptPlan.h"
+
+#include <QFile>
+#include <QJSEngine>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// Exposes the API object's methods as plain global functions
+const char *const kPrelude =
+    "function speed(rpm) { ecu.speed(rpm); }\n"
+    "function ramp(rpm, ms) { ecu.ramp(rpm, ms); }\n"
+    "function hold(ms) { ecu.hold(ms); }\n"
+    "function checkMeanError(percent) { ecu.checkMeanError(percent); }\n"
+    "function readImu() { ecu.readImu(); }\n"
+    "function stop() { ecu.stop(); }\n";
+
+}  // namespace
+
+void ScriptPlanApi::Append(const TestStep &step) {
+    if (plan_->steps.size() >= ScriptPlan::kMaxSteps) {
+        engine_->throwError(QString("Test plan exceeds %1 steps").arg(static_cast<int>(ScriptPlan::kMaxSteps)));
+        return;
+    }
+    plan_->steps.push_back(step);
+}
+
+void ScriptPlanApi::speed(double rpm) {
+    TestStep step;
+    step.type = TestStep::Type::kSpeed;
+    step.target_rpm = rpm;
+    Append(step);
+}
+
+void ScriptPlanApi::ramp(double rpm, int durationMs) {
+    if (durationMs <= 0) {
+        engine_->throwError(QJSValue::RangeError, "ramp() duration must be positive");
+        return;
+    }
+    TestStep step;
+    step.type = TestStep::Type::kRamp;
+    step.target_rpm = rpm;
+    step.duration_ms = durationMs;
+    Append(step);
+}
+
+void ScriptPlanApi::hold(int durationMs) {
+    if (durationMs <= 0) {
+        engine_->throwError(QJSValue::RangeError, "hold() duration must be positive");
+        return;
+    }
+    TestStep step;
+    step.type = TestStep::Type::kHold;
+    step.duration_ms = durationMs;
+    Append(step);
+}
+
+void ScriptPlanApi::checkMeanError(double percent) {
+    if (percent <= 0) {
+        engine_->throwError(QJSValue::RangeError, "checkMeanError() tolerance must be positive");
+        return;
+    }
+    TestStep step;
+    step.type = TestStep::Type::kCheckRpm;
+    step.tolerance_pct = percent;
+    Append(step);
+}
+
+void ScriptPlanApi::readImu() {
+    TestStep step;
+    step.type = TestStep::Type::kReadImu;
+    Append(step);
+}
+
+void ScriptPlanApi::stop() {
+    TestStep step;
+    step.type = TestStep::Type::kStop;
+    Append(step);
+}
+
+TestPlan ScriptPlan::Build(const QString &source, int timeoutMs) {
+    std::mutex mutex;
+    QJSEngine *running = nullptr;
+    std::promise<void> engineReady;
+
+    // QJSEngine must live on the thread that uses it, so it is created there
+    auto result = std::async(std::launch::async, [&]() {
+        QJSEngine engine;
+        TestPlan plan;
+        ScriptPlanApi api(&engine, &plan);
+        // Stack object: the engine must never try to delete it
+        QJSEngine::setObjectOwnership(&api, QJSEngine::CppOwnership);
+        engine.globalObject().setProperty("ecu", engine.newQObject(&api));
+        engine.evaluate(kPrelude);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = &engine;
+        }
+        engineReady.set_value();
+        QJSValue value = engine.evaluate(source, "plan");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = nullptr;
+        }
+
+        if (engine.isInterrupted()) {
+            throw std::runtime_error("Test script timed out");
+        }
+        if (value.isError()) {
+            throw std::runtime_error(QString("Test script error on line %1: %2")
+                                         .arg(value.property("lineNumber").toInt())
+                                         .arg(value.toString())
+                                         .toStdString());
+        }
+        return plan;
+    });
+
+    engineReady.get_future().wait();
+    if (result.wait_for(std::chrono::milliseconds(timeoutMs)) == std::future_status::timeout) {
+        // A runaway loop in the script; stop the interpreter from this thread
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) running->setInterrupted(true);
+    }
+    return result.get();
+}
+
+TestPlan ScriptPlan::Load(const QString &path, int timeoutMs) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        throw std::runtime_error("Error opening test script " + path.toStdString());
+    }
+    return Build(QString::fromUtf8(file.readAll()), timeoutMs);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include "TestPlan.h"
+
+class QJSEngine;
+
+// Functions available to test scripts. Each call appends a step; nothing is
+// executed while the script runs.
+class ScriptPlanApi : public QObject {
+    Q_OBJECT
+public:
+    ScriptPlanApi(QJSEngine *engine, TestPlan *plan) : engine_(engine), plan_(plan) {}
+
+    Q_INVOKABLE void speed(double rpm);
+    Q_INVOKABLE void ramp(double rpm, int durationMs);
+    Q_INVOKABLE void hold(int durationMs);
+    Q_INVOKABLE void checkMeanError(double percent);
+    Q_INVOKABLE void readImu();
+    Q_INVOKABLE void stop();
+
+private:
+    void Append(const TestStep &step);
+
+    QJSEngine *engine_;
+    TestPlan *plan_;
+};
+
+// Compiles an operator script (JavaScript, e.g. "ramp(100, 2000); hold(5000);
+// checkMeanError(3); readImu(); stop();") into a TestPlan. The script runs in
+// a QJSEngine on a worker thread and only describes the sequence; the station
+// control loop executes it, so interpreter speed never affects stimulus timing.
+class ScriptPlan {
+public:
+    // Throws std::runtime_error on script errors or when the script does not
+    // finish within timeoutMs.
+    static TestPlan Build(const QString &source, int timeoutMs = 2000);
+    static TestPlan Load(const QString &path, int timeoutMs = 2000);
+
+    static constexpr size_t kMaxSteps = 10000;
+};
@@ -0,0 +1,305 @@
+#include "Segmenter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int kRtoBackoffLimit = 3;  // RTO doubles per retry, up to 8x
+
+void PutBe16(std::vector<uint8_t>& out, uint32_t v) {
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+uint32_t GetBe16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+
+}  // namespace
+
+Segmenter::Segmenter() : Segmenter(Config()) {}
+
+Segmenter::Segmenter(const Config& config) : config_(config) {
+  // Acks report 32 segments past the first gap
+  config_.window = std::clamp<size_t>(config_.window, 1, 32);
+  config_.ack_every = std::max<size_t>(config_.ack_every, 1);
+}
+
+bool Segmenter::Send(std::vector<uint8_t> payload, Clock::time_point now,
+                     Frames& out) {
+  if (payload.empty() || payload.size() > kMaxTransfer) return false;
+
+  Outgoing transfer;
+  transfer.id = next_id_++;
+  transfer.last_seq = static_cast<uint16_t>((payload.size() - 1) / kSegmentData);
+  transfer.segments.resize(transfer.last_seq + 1);
+  transfer.payload = std::move(payload);
+  outgoing_.push_back(std::move(transfer));
+
+  FillWindow(now, out);
+  return true;
+}
+
+bool Segmenter::OnFrame(const std::vector<uint8_t>& frame,
+                        Clock::time_point now, Frames& out, Frames& completed) {
+  if (frame.empty()) return false;
+  if (frame[0] == protocol::kSegment) {
+    OnSegment(frame, now, out, completed);
+    return true;
+  }
+  if (frame[0] == protocol::kSegmentAck) {
+    OnAck(frame, now, out);
+    return true;
+  }
+  return false;
+}
+
+void Segmenter::Poll(Clock::time_point now, Frames& out) {
+  for (auto it = outgoing_.begin(); it != outgoing_.end();) {
+    Outgoing& t = *it;
+    bool failed = false;
+    for (uint32_t seq = t.base; seq < t.next_unsent; ++seq) {
+      SegmentState& s = t.segments[seq];
+      if (!s.in_flight || now - std::max(s.sent, t.last_progress) < Rto(s.retries)) {
+        continue;
+      }
+      if (s.retries >= config_.max_retries) {
+        failed = true;
+        break;
+      }
+      ++s.retries;
+      s.retransmitted = true;
+      ++stats_.retransmits;
+      SendSegment(t, seq, now, out);
+    }
+    if (failed) {
+      for (const SegmentState& s : t.segments) {
+        if (s.in_flight) --in_flight_;
+      }
+      ++stats_.transfers_failed;
+      it = outgoing_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  FillWindow(now, out);
+
+  for (auto it = incoming_.begin(); it != incoming_.end();) {
+    Incoming& t = it->second;
+    if (!t.done && t.unacked > 0 && now >= t.ack_due) SendAck(it->first, t, out);
+    if (now - t.last_activity > kIncomingTimeout) {
+      it = incoming_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Segmenter::FillWindow(Clock::time_point now, Frames& out) {
+  for (Outgoing& t : outgoing_) {
+    while (in_flight_ < config_.window && t.next_unsent <= t.last_seq) {
+      SendSegment(t, t.next_unsent++, now, out);
+    }
+    if (in_flight_ >= config_.window) return;
+  }
+}
+
+void Segmenter::SendSegment(Outgoing& transfer, uint32_t seq,
+                            Clock::time_point now, Frames& out) {
+  size_t offset = seq * kSegmentData;
+  size_t len = std::min(kSegmentData, transfer.payload.size() - offset);
+
+  std::vector<uint8_t> frame;
+  frame.reserve(protocol::kSegmentHeaderSize + len);
+  frame.push_back(protocol::kSegment);
+  frame.push_back(transfer.id);
+  PutBe16(frame, seq);
+  PutBe16(frame, transfer.last_seq);
+  frame.insert(frame.end(), transfer.payload.begin() + offset,
+               transfer.payload.begin() + offset + len);
+  out.push_back(std::move(frame));
+
+  SegmentState& s = transfer.segments[seq];
+  if (!s.in_flight) {
+    s.in_flight = true;
+    ++in_flight_;
+  }
+  s.sent = now;
+  s.transmission = ++transmissions_;
+  ++stats_.segments_sent;
+}
+
+void Segmenter::OnSegment(const std::vector<uint8_t>& frame,
+                          Clock::time_point now, Frames& out,
+                          Frames& completed) {
+  if (frame.size() <= static_cast<size_t>(protocol::kSegmentHeaderSize)) return;
+  uint8_t id = frame[1];
+  uint32_t seq = GetBe16(&frame[2]);
+  uint16_t last_seq = static_cast<uint16_t>(GetBe16(&frame[4]));
+  size_t len = frame.size() - protocol::kSegmentHeaderSize;
+  if (seq > last_seq || (seq < last_seq && len != kSegmentData)) return;
+
+  auto it = incoming_.find(id);
+  if (it == incoming_.end() || it->second.last_seq != last_seq) {
+    if ((last_seq + size_t{1}) * kSegmentData > config_.max_incoming) {
+      ++stats_.segments_rejected;
+      return;
+    }
+    // Transfer ids are reused after 256 transfers; by the time this one
+    // comes round again its old entry has been dropped here
+    incoming_.erase(static_cast<uint8_t>(id + 128));
+    Incoming fresh;
+    fresh.last_seq = last_seq;
+    fresh.data.resize((last_seq + 1) * kSegmentData);
+    fresh.received.assign(last_seq + 1, false);
+    it = incoming_.insert_or_assign(id, std::move(fresh)).first;
+  }
+  Incoming& t = it->second;
+  t.last_activity = now;
+
+  if (t.done || t.received[seq]) {
+    // Our ack was lost; repeat it so the sender stops retransmitting
+    SendAck(id, t, out);
+    return;
+  }
+
+  std::memcpy(t.data.data() + seq * kSegmentData,
+              frame.data() + protocol::kSegmentHeaderSize, len);
+  t.received[seq] = true;
+  ++t.count;
+  if (seq == last_seq) t.last_length = len;
+
+  bool in_order = seq == t.next_expected;
+  while (t.next_expected <= last_seq && t.received[t.next_expected]) {
+    ++t.next_expected;
+  }
+  if (t.unacked++ == 0) t.ack_due = now + config_.ack_delay;
+
+  if (t.count == t.received.size()) {
+    t.done = true;
+    t.data.resize(last_seq * kSegmentData + t.last_length);
+    completed.push_back(std::move(t.data));
+    t.data = {};
+    t.received = {};
+    ++stats_.transfers_received;
+    SendAck(id, t, out);
+  } else if (!in_order || t.unacked >= config_.ack_every) {
+    // Out of order means a gap: report it right away
+    SendAck(id, t, out);
+  }
+}
+
+void Segmenter::OnAck(const std::vector<uint8_t>& frame, Clock::time_point now,
+                      Frames& out) {
+  if (frame.size() < static_cast<size_t>(protocol::kSegmentAckSize)) return;
+  uint8_t id = frame[1];
+  auto it = std::find_if(outgoing_.begin(), outgoing_.end(),
+                         [id](const Outgoing& t) { return t.id == id; });
+  if (it == outgoing_.end()) return;  // Stale ack for a finished transfer
+  Outgoing& t = *it;
+
+  uint32_t next = std::min<uint32_t>(GetBe16(&frame[2]), t.last_seq + 1u);
+  uint32_t bitmap = (frame[4] << 24) | (frame[5] << 16) | (frame[6] << 8) | frame[7];
+
+  // Newest transmission the receiver has seen; anything sent before it and
+  // still missing was lost rather than delayed
+  uint64_t newest = 0;
+  uint32_t highest = next;
+  for (uint32_t seq = t.base; seq < next; ++seq) {
+    if (t.segments[seq].acked) continue;
+    newest = std::max(newest, t.segments[seq].transmission);
+    Acknowledge(t, seq, now);
+  }
+  for (int i = 0; i < 32; ++i) {
+    uint32_t seq = next + 1 + i;
+    if (seq > t.last_seq) break;
+    if (!(bitmap & (1u << i))) continue;
+    newest = std::max(newest, t.segments[seq].transmission);
+    highest = seq;
+    Acknowledge(t, seq, now);
+  }
+  while (t.base <= t.last_seq && t.segments[t.base].acked) ++t.base;
+
+  for (uint32_t seq = t.base; seq < highest; ++seq) {
+    FastRetransmit(t, seq, newest, now, out);
+  }
+  // The line delivers in order and the tail of a transfer is acked at once,
+  // so earlier transfers' segments sent before newest are lost too. This
+  // recovers a lost last segment without waiting for the timeout.
+  for (auto prior = outgoing_.begin(); prior != it; ++prior) {
+    for (uint32_t seq = prior->base; seq < prior->next_unsent; ++seq) {
+      FastRetransmit(*prior, seq, newest, now, out);
+    }
+  }
+
+  if (t.acked == t.segments.size()) {
+    ++stats_.transfers_sent;
+    outgoing_.erase(it);
+  }
+  FillWindow(now, out);
+}
+
+void Segmenter::FastRetransmit(Outgoing& transfer, uint32_t seq,
+                               uint64_t newest, Clock::time_point now,
+                               Frames& out) {
+  SegmentState& s = transfer.segments[seq];
+  if (s.acked || !s.in_flight || s.transmission >= newest) return;
+  s.retransmitted = true;
+  ++stats_.retransmits;
+  SendSegment(transfer, seq, now, out);
+}
+
+void Segmenter::Acknowledge(Outgoing& transfer, uint32_t seq,
+                            Clock::time_point now) {
+  SegmentState& s = transfer.segments[seq];
+  if (s.acked) return;
+  s.acked = true;
+  ++transfer.acked;
+  transfer.last_progress = now;
+  if (s.in_flight) {
+    s.in_flight = false;
+    --in_flight_;
+  }
+  if (s.retransmitted) return;  // Ambiguous which transmission was acked
+
+  double rtt_us =
+      std::chrono::duration<double, std::micro>(now - s.sent).count();
+  if (srtt_us_ == 0) {
+    srtt_us_ = rtt_us;
+    rttvar_us_ = rtt_us / 2;
+  } else {
+    rttvar_us_ = 0.75 * rttvar_us_ + 0.25 * std::abs(srtt_us_ - rtt_us);
+    srtt_us_ = 0.875 * srtt_us_ + 0.125 * rtt_us;
+  }
+}
+
+void Segmenter::SendAck(uint8_t id, Incoming& transfer, Frames& out) {
+  uint32_t bitmap = 0;
+  for (int i = 0; i < 32; ++i) {
+    uint32_t seq = transfer.next_expected + 1 + i;
+    if (seq > transfer.last_seq) break;
+    if (transfer.received[seq]) bitmap |= 1u << i;
+  }
+
+  std::vector<uint8_t> frame;
+  frame.reserve(protocol::kSegmentAckSize);
+  frame.push_back(protocol::kSegmentAck);
+  frame.push_back(id);
+  PutBe16(frame, transfer.next_expected);
+  PutBe16(frame, bitmap >> 16);
+  PutBe16(frame, bitmap & 0xFFFF);
+  out.push_back(std::move(frame));
+
+  transfer.unacked = 0;
+  ++stats_.acks_sent;
+}
+
+Segmenter::Clock::duration Segmenter::Rto(int retries) const {
+  Clock::duration rto = config_.initial_rto;
+  if (srtt_us_ > 0) {
+    auto us = std::chrono::microseconds(
+        static_cast<int64_t>(srtt_us_ + 4 * rttvar_us_));
+    rto = std::max<Clock::duration>(config_.min_rto, us);
+  }
+  return rto * (1 << std::min(retries, kRtoBackoffLimit));
+}
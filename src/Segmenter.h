@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "FrameCodec.h"
+#include "Protocol.h"
+
+// Segmentation and reassembly of payloads larger than one frame (segment and
+// segment_ack, see doc/protocol.md). A sliding window keeps several segments
+// in flight; the receiver acknowledges cumulatively plus a bitmap of the
+// segments after the first gap, so only lost segments are sent again.
+//
+// Transport-agnostic and not thread-safe: the caller sends the frames
+// appended to out and calls Poll() regularly for delayed acks and timeouts.
+class Segmenter {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Frames = std::vector<std::vector<uint8_t>>;
+
+  struct Config {
+    size_t window = 16;  // Segments in flight across all transfers, <= 32
+    size_t ack_every = 4;  // Received segments per ack while in order
+    Clock::duration ack_delay = std::chrono::milliseconds(20);
+    Clock::duration initial_rto = std::chrono::seconds(1);
+    Clock::duration min_rto = std::chrono::milliseconds(100);
+    int max_retries = 8;
+    // Largest payload accepted from the peer. Reassembly buffers are sized
+    // from the peer's last_seq, so larger transfers are dropped unanswered.
+    size_t max_incoming = 1 << 20;
+  };
+
+  struct Stats {
+    uint64_t transfers_sent = 0;
+    uint64_t transfers_received = 0;
+    uint64_t transfers_failed = 0;  // Given up after max_retries
+    uint64_t segments_sent = 0;
+    uint64_t retransmits = 0;
+    uint64_t acks_sent = 0;
+    uint64_t segments_rejected = 0;  // Of transfers over max_incoming
+  };
+
+  static constexpr size_t kSegmentData =
+      FrameCodec::kMaxPayload - protocol::kSegmentHeaderSize;
+  // The receiver's next expected seq must fit 16 bits after the last segment
+  static constexpr size_t kMaxTransfer = kSegmentData * 65535;
+
+  Segmenter();
+  explicit Segmenter(const Config& config);
+
+  // Queues a payload and appends the segments the window allows; false if
+  // it is empty or larger than kMaxTransfer
+  bool Send(std::vector<uint8_t> payload, Clock::time_point now, Frames& out);
+  // Consumes segment and segment_ack frames, returns false for any other
+  // payload. Reassembled payloads are appended to completed.
+  bool OnFrame(const std::vector<uint8_t>& frame, Clock::time_point now,
+               Frames& out, Frames& completed);
+  void Poll(Clock::time_point now, Frames& out);
+
+  // No transfer waiting for acknowledgement
+  bool idle() const { return outgoing_.empty(); }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct SegmentState {
+    bool acked = false;
+    bool in_flight = false;
+    bool retransmitted = false;
+    Clock::time_point sent;
+    uint64_t transmission = 0;  // Order of the latest transmission
+    int retries = 0;
+  };
+
+  struct Outgoing {
+    uint8_t id = 0;
+    std::vector<uint8_t> payload;
+    uint16_t last_seq = 0;
+    uint32_t base = 0;  // Oldest unacknowledged seq
+    uint32_t next_unsent = 0;
+    size_t acked = 0;
+    // Segments queue behind the rest of the window on a slow line, so the
+    // retransmission timer runs from the later of their transmission and
+    // the last ack that acknowledged anything new in this transfer
+    Clock::time_point last_progress{};
+    std::vector<SegmentState> segments;
+  };
+
+  struct Incoming {
+    uint16_t last_seq = 0;
+    std::vector<uint8_t> data;
+    std::vector<bool> received;
+    size_t count = 0;
+    size_t last_length = 0;
+    uint32_t next_expected = 0;
+    size_t unacked = 0;
+    Clock::time_point ack_due;
+    Clock::time_point last_activity;
+    bool done = false;
+  };
+
+  void FillWindow(Clock::time_point now, Frames& out);
+  void SendSegment(Outgoing& transfer, uint32_t seq, Clock::time_point now,
+                   Frames& out);
+  void OnSegment(const std::vector<uint8_t>& frame, Clock::time_point now,
+                 Frames& out, Frames& completed);
+  void OnAck(const std::vector<uint8_t>& frame, Clock::time_point now,
+             Frames& out);
+  void SendAck(uint8_t id, Incoming& transfer, Frames& out);
+  void Acknowledge(Outgoing& transfer, uint32_t seq, Clock::time_point now);
+  // Resends seq if it is outstanding and was sent before transmission newest
+  void FastRetransmit(Outgoing& transfer, uint32_t seq, uint64_t newest,
+                      Clock::time_point now, Frames& out);
+  Clock::duration Rto(int retries) const;
+
+  // Incomplete transfers are dropped after this long without a segment
+  static constexpr auto kIncomingTimeout = std::chrono::seconds(5);
+
+  Config config_;
+  Stats stats_;
+
+  std::deque<Outgoing> outgoing_;
+  uint8_t next_id_ = 0;
+  size_t in_flight_ = 0;
+  uint64_t transmissions_ = 0;
+  // Smoothed segment round trip, from segments sent only once
+  double srtt_us_ = 0;
+  double rttvar_us_ = 0;
+
+  std::map<uint8_t, Incoming> incoming_;
+};
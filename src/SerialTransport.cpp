@@ -1,18 +1,34 @@
 #include "SerialTransport.h"
+#include "IoReactor.h"
 
 #include <fcntl.h>
+#include <sys/file.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
 
+namespace {
+
+// Reactor mode: a port that stopped draining drops frames beyond this
+// instead of buffering without bound
+constexpr size_t kMaxPendingWrite = 64 * 1024;
+
+}  // namespace
+
 SerialTransport::SerialTransport(const std::string& port, int baud)
-    : port_(port), baud_(baud), input_buffer_(65536) {
+    : port_(port), baud_(baud) {
   fd_ = open(port.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
   if (fd_ < 0) {
     throw std::runtime_error("Error opening serial port");
   }
+  // A second connector on the same tty would steal half of each reply
+  if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+    close(fd_);
+    throw std::runtime_error("Serial port " + port + " is already open");
+  }
 
   struct termios tty;
   if (tcgetattr(fd_, &tty) != 0) {
@@ -43,6 +59,19 @@ SerialTransport::SerialTransport(const std::string& port, int baud)
   }
 }
 
+SerialTransport::SerialTransport(int fd)
+    : port_("fd:" + std::to_string(fd)), baud_(0), fd_(fd) {
+  // The read/write loops poll, so they must never block on the descriptor
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) != 0) {
+    close(fd_);
+    throw std::runtime_error("Error configuring descriptor");
+  }
+}
+
+SerialTransport::SerialTransport(Scheduler* clock, WriteFunction write)
+    : port_("virtual"), baud_(0), clock_(clock), write_(std::move(write)) {}
+
 SerialTransport::~SerialTransport() {
   Stop();
   if (fd_ >= 0) close(fd_);
@@ -51,231 +80,137 @@ SerialTransport::~SerialTransport() {
 void SerialTransport::Start() {
   if (running_) return;
   running_ = true;
+  if (write_) return;
   read_thread_ = std::thread(&SerialTransport::ReadLoop, this);
   write_thread_ = std::thread(&SerialTransport::WriteLoop, this);
 }
 
+void SerialTransport::Start(IoReactor* reactor) {
+  if (running_) return;
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) != 0) {
+    throw std::runtime_error("Error configuring descriptor");
+  }
+  running_ = true;
+  reactor_ = reactor;
+  reactor_->Add(fd_, [this](uint32_t events) { OnReady(events); });
+}
+
 void SerialTransport::Stop() {
+  if (reactor_) {
+    reactor_->Remove(fd_);
+    reactor_ = nullptr;
+    // Frames still queued, such as the unsubscribe sent on disconnect, get
+    // one more non-blocking write; the kernel buffer normally takes them
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    FlushPendingLocked();
+    watching_writable_ = false;
+  }
   running_ = false;
   if (read_thread_.joinable()) read_thread_.join();
   if (write_thread_.joinable()) write_thread_.join();
 }
 
-void SerialTransport::Send(std::vector<uint8_t> data) {
+bool SerialTransport::Send(std::vector<uint8_t> data) {
   if (data.empty()) {
-    return;
+    return false;
+  }
+  if (data.size() <= FrameCodec::kMaxPayload) {
+    SendPayload(std::move(data));
+    return true;
   }
 
-  if (data.size() + 2 > 255) {
-    return;
+  Segmenter::Frames segments;
+  {
+    std::lock_guard<std::mutex> lock(segment_mutex_);
+    if (!segmenter_.Send(std::move(data), Now(),
+                         segments)) {
+      return false;
+    }
   }
+  for (auto& segment : segments) SendPayload(std::move(segment));
+  return true;
+}
 
-  // The protocol expects:
-  // [0xAA] [Length] [Payload...] [CRC_L] [CRC_H]
-  // Length includes Payload + CRC (2 bytes)
-  
-  // The reference implementation (tools/cpp_app/SerialTransport.cpp) does:
-  // data[0] = static_cast<uint8_t>(data.size() + 2);
-  // This implies that the caller MUST reserve the first byte for length!
-  
-  // However, my ECUConnector implementation does NOT reserve the first byte.
-  // It sends [CmdID, Args...].
-  
-  // So I must PREPEND the length byte.
-  
-  // BUT, wait. If I prepend length, then the vector becomes:
-  // [Length, CmdID, Args...]
-  
-  // The reference implementation calculates CRC on 'data':
-  // uint16_t crc = CalculateCrc16(data.data(), data.size());
-  // So CRC is calculated on [Length, CmdID, Args...] (assuming data[0] was length).
-  
-  // My previous fix:
-  // payload_with_len = [Length, CmdID, Args...]
-  // crc = CalculateCrc16(payload_with_len...)
-  // frame = [0xAA, Length, CmdID, Args..., CRC_L, CRC_H]
-  
-  // This looks correct IF the ECU expects CRC to cover Length.
-  
-  // Let's look at the log again.
-  // "CRC mismatch on serial frame"
-  
-  // Maybe the ECU expects CRC to cover ONLY the payload (CmdID + Args)?
-  // Or maybe it expects CRC to cover [0xAA, Length, Payload...]?
-  
-  // Let's check ProcessBuffer in SerialTransport.cpp (which mimics ECU logic?)
-  /*
-    uint16_t received_crc = frame[total_len - 2] | (frame[total_len - 1] << 8);
-    uint16_t calculated_crc = CalculateCrc16(&frame[1], len_byte - 2);
-    
-    if (received_crc == calculated_crc) { ... }
-  */
-  
-  // frame[0] is 0xAA.
-  // frame[1] is Length.
-  // &frame[1] points to Length.
-  // len_byte is the value of Length byte.
-  // len_byte = PayloadSize + 2 (CRC size).
-  // CalculateCrc16 is called with length: len_byte - 2.
-  // So it calculates CRC on (PayloadSize + 2) - 2 = PayloadSize bytes.
-  // STARTING AT &frame[1].
-  
-  // Wait!
-  // If frame is [AA, Len, Pay0, Pay1, CRC, CRC]
-  // &frame[1] is Len.
-  // It calculates CRC on 'Len' and following bytes?
-  
-  // If len_byte is 4 (1 byte payload + 2 crc).
-  // It calculates CRC on 4-2 = 2 bytes.
-  // Starting at frame[1].
-  // So it calculates CRC on [Len, Pay0].
-  
-  // So YES, CRC includes the Length byte!
-  
-  // My previous fix:
-  // payload_with_len = [Length, CmdID, Args...]
-  // crc = CalculateCrc16(payload_with_len...)
-  // This matches the logic: CRC on [Length, Payload...].
-  
-  // So why mismatch?
-  
-  // Maybe the length calculation is wrong?
-  // data.size() is Payload size.
-  // Length = data.size() + 2.
-  
-  // Example: GetApiVersion (0x01, 0x01). Payload size 2.
-  // Length = 4.
-  // payload_with_len = [0x04, 0x01, 0x01].
-  // CRC on [0x04, 0x01, 0x01].
-  
-  // Wait, ProcessBuffer logic:
-  // uint16_t calculated_crc = CalculateCrc16(&frame[1], len_byte - 2);
-  
-  // If len_byte is 4.
-  // It calculates CRC on 2 bytes.
-  // Starting at frame[1] (which is 0x04).
-  // So it calculates CRC on [0x04, 0x01].
-  // It MISSES the last byte of payload (0x01)!
-  
-  // If len_byte includes CRC size (2 bytes).
-  // And we want to calculate CRC on [Length, Payload...].
-  // The size of [Length, Payload...] is 1 + PayloadSize.
-  // len_byte = PayloadSize + 2.
-  // We want to calculate on 1 + PayloadSize bytes.
-  // 1 + PayloadSize = 1 + (len_byte - 2) = len_byte - 1.
-  
-  // But ProcessBuffer uses `len_byte - 2`.
-  // This means it calculates CRC on `PayloadSize` bytes.
-  // Starting at `frame[1]` (Length).
-  // So it calculates CRC on [Length, Payload[0]... Payload[N-2]].
-  // It effectively drops the last byte of the payload from CRC calculation?
-  // OR, it implies Length byte is NOT part of CRC, and &frame[1] is wrong?
-  
-  // If the reference implementation `tools/cpp_app/SerialTransport.cpp` is correct (it's from the repo),
-  // then `CalculateCrc16(&frame[1], len_byte - 2)` is the ground truth for RX.
-  
-  // Let's trace the TX side of reference implementation:
-  // data[0] = static_cast<uint8_t>(data.size() + 2);
-  // crc = CalculateCrc16(data.data(), data.size());
-  
-  // Here `data` ALREADY has length at index 0.
-  // So `data.size()` is the full size of vector passed to Send.
-  // Let's say caller passes vector of size 3: [Dummy, Pay1, Pay2].
-  // data[0] becomes 3+2 = 5.
-  // Vector: [0x05, Pay1, Pay2].
-  // CRC calc on 3 bytes: [0x05, Pay1, Pay2].
-  
-  // RX side:
-  // frame: [AA, 05, Pay1, Pay2, CRC, CRC].
-  // len_byte = 5.
-  // Calc CRC on `len_byte - 2` = 3 bytes.
-  // Starting at `frame[1]` (0x05).
-  // Bytes: 0x05, Pay1, Pay2.
-  
-  // This matches!
-  
-  // So my logic for TX seems correct:
-  // payload_with_len = [Length, Payload...]
-  // CRC on payload_with_len.
-  
-  // So why mismatch?
-  
-  // Maybe `data.size()` in `payload_with_len.push_back` is wrong?
-  // `data` is [CmdID, Args...].
-  // `data.size()` is PayloadSize.
-  // `payload_with_len` gets `PayloadSize + 2`.
-  // Then `data` is appended.
-  // So `payload_with_len` is [Len, CmdID, Args...].
-  // Size is 1 + PayloadSize.
-  
-  // In reference TX:
-  // Caller passes `data` where `data[0]` is reserved.
-  // `data.size()` includes the reserved byte.
-  // So `data.size()` = 1 + PayloadSize.
-  // `data[0]` = (1 + PayloadSize) + 2 = PayloadSize + 3?
-  // NO!
-  
-  // If reference TX says: `data[0] = data.size() + 2`.
-  // And `data` is [Reserved, Pay1, Pay2]. Size 3.
-  // `data[0]` = 5.
-  // But PayloadSize is 2.
-  // Length should be PayloadSize + CRC = 2 + 2 = 4?
-  // Or does Length include Length byte itself?
-  
-  // If `data[0]` = 5.
-  // RX sees len=5.
-  // RX expects total_len = 1 + 5 = 6 bytes. [AA, 05, Pay1, Pay2, CRC, CRC].
-  // Payload is Pay1, Pay2. Size 2.
-  // CRC is 2.
-  // Length byte is 1.
-  // Total 5 bytes (excluding AA).
-  // So Length = 1 (Len) + 2 (Pay) + 2 (CRC) = 5.
-  
-  // So Length INCLUDES the Length byte itself!
-  
-  // My code:
-  // payload_with_len.push_back(static_cast<uint8_t>(data.size() + 2));
-  // `data.size()` is PayloadSize.
-  // I am setting Length = PayloadSize + 2.
-  // I am MISSING the +1 for the Length byte itself!
-  
-  // Let's verify.
-  // My code: Payload [0x01, 0x01] (Size 2).
-  // Length = 2 + 2 = 4.
-  // Frame: [AA, 04, 01, 01, CRC, CRC].
-  // RX sees Len=4.
-  // RX expects total_len = 1 + 4 = 5 bytes.
-  // But we sent 6 bytes! [AA, 04, 01, 01, CRC, CRC].
-  // RX reads AA, 04.
-  // RX reads 4-2 = 2 bytes for CRC calc?
-  // RX reads frame of size 5: [AA, 04, 01, 01, CRC_L].
-  // CRC_H is left in buffer!
-  // CRC check fails because it reads wrong bytes for CRC.
-  
-  // FIX: Length should be `data.size() + 3` (Payload + CRC + LengthByte).
-  
-  uint8_t len_byte = static_cast<uint8_t>(data.size() + 3);
-  
-  std::vector<uint8_t> payload_with_len;
-  payload_with_len.reserve(1 + data.size());
-  payload_with_len.push_back(len_byte);
-  payload_with_len.insert(payload_with_len.end(), data.begin(), data.end());
-  
-  uint16_t crc = CalculateCrc16(payload_with_len.data(), payload_with_len.size());
+void SerialTransport::Poll() {
+  Segmenter::Frames frames;
+  {
+    std::lock_guard<std::mutex> lock(segment_mutex_);
+    segmenter_.Poll(Now(), frames);
+  }
+  for (auto& frame : frames) SendPayload(std::move(frame));
+}
+
+Segmenter::Stats SerialTransport::segment_stats() {
+  std::lock_guard<std::mutex> lock(segment_mutex_);
+  return segmenter_.stats();
+}
+
+void SerialTransport::SendPayload(std::vector<uint8_t> data) {
+  std::vector<std::vector<uint8_t>> expired;
+  {
+    std::lock_guard<std::mutex> lock(framing_mutex_);
+    if (switch_pending_) {
+      if (Now() < switch_deadline_) {
+        held_.push_back(std::move(data));
+        return;
+      }
+      // Never acknowledged: carry on in the current framing
+      switch_pending_ = false;
+      expired.swap(held_);
+    }
+  }
+  for (const auto& payload : expired) SendFrame(payload);
+  SendFrame(data);
+}
+
+void SerialTransport::SendFramingSwitch(std::vector<uint8_t> request,
+                                        Framing framing) {
+  if (request.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(framing_mutex_);
+    switch_pending_ = true;
+    switch_command_ = request[0];
+    switch_framing_ = framing;
+    switch_deadline_ = Now() + std::chrono::milliseconds(500);
+  }
+  SendFrame(request);
+}
 
+void SerialTransport::SetRxFraming(Framing framing) {
+  std::lock_guard<std::mutex> lock(rx_mutex_);
+  rx_codec_.SetFraming(framing);
+}
+
+void SerialTransport::SendFrame(const std::vector<uint8_t>& payload) {
   std::vector<uint8_t> frame;
-  frame.reserve(1 + payload_with_len.size() + 2);
-  frame.push_back(0xAA);
-  frame.insert(frame.end(), payload_with_len.begin(), payload_with_len.end());
-  frame.push_back(crc & 0xFF);
-  frame.push_back((crc >> 8) & 0xFF);
+  frame.reserve(payload.size() + 8);
+  if (!FrameCodec::Encode(tx_framing_, payload.data(), payload.size(), frame)) {
+    return;
+  }
 
-  output_queue_.Push(frame);
+  if (reactor_) {
+    QueueWrite(frame);
+  } else if (write_) {
+    WriteFrame(frame);
+  } else {
+    output_queue_.Push(frame);
+  }
   if (log_cb_) log_cb_(frame, true);
 }
 
 bool SerialTransport::Read(std::vector<uint8_t>& payload) {
-  return input_queue_.Pop(payload);
+  std::chrono::steady_clock::time_point rx_time;
+  return Read(payload, rx_time);
+}
+
+bool SerialTransport::Read(std::vector<uint8_t>& payload,
+                           std::chrono::steady_clock::time_point& rx_time) {
+  RxFrame frame;
+  if (!input_queue_.Pop(frame)) return false;
+  payload = std::move(frame.payload);
+  rx_time = frame.time;
+  return true;
 }
 
 void SerialTransport::ReadLoop() {
@@ -283,88 +218,160 @@ void SerialTransport::ReadLoop() {
   while (running_) {
     int n = ::read(fd_, tmp, sizeof(tmp));
     if (n > 0) {
-      input_buffer_.Push(tmp, n);
-      ProcessBuffer();
+      last_read_time_ = Now();
+      OnBytes(tmp, n);
     } else {
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    Poll();
   }
 }
 
+void SerialTransport::OnReady(uint32_t events) {
+  if (events & IoReactor::kWritable) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    FlushPendingLocked();
+  }
+  if (events & (IoReactor::kReadable | IoReactor::kHangUp)) OnReadable();
+}
+
+void SerialTransport::OnReadable() {
+  uint8_t tmp[4096];
+  int n = ::read(fd_, tmp, sizeof(tmp));
+  if (n > 0) {
+    last_read_time_ = Now();
+    OnBytes(tmp, n);
+    return;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+  // End of file or EIO: the port is gone. Stop watching it, or the reactor
+  // would report it readable forever.
+  hung_up_ = true;
+  reactor_->Ignore(fd_);
+}
+
 void SerialTransport::WriteLoop() {
+  std::vector<uint8_t> frame;
   while (running_) {
-    std::vector<uint8_t> frame;
     if (output_queue_.Pop(frame)) {
-      size_t written = 0;
-      while (written < frame.size()) {
-        int n = ::write(fd_, frame.data() + written, frame.size() - written);
-        if (n > 0) {
-          written += n;
-        } else {
-          std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
-      }
+      WriteFrame(frame);
     } else {
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
   }
+  // Frames queued just before Stop(), such as the unsubscribe sent on
+  // disconnect, still go out before the port is closed
+  while (output_queue_.Pop(frame)) WriteFrame(frame);
 }
 
-void SerialTransport::ProcessBuffer() {
-  while (input_buffer_.Size() >= 2) {
-    if (input_buffer_.Peek(0) != 0xAA) {
-      input_buffer_.Pop(1);
-      continue;
+void SerialTransport::WriteFrame(const std::vector<uint8_t>& frame) {
+  if (write_) {
+    write_(frame);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  size_t written = 0;
+  while (written < frame.size()) {
+    int n = ::write(fd_, frame.data() + written, frame.size() - written);
+    if (n > 0) {
+      written += n;
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      // The port is gone (e.g. unplugged): give up rather than spin, which
+      // would also block the final drain in Stop()
+      return;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+  }
+}
 
-    uint8_t len_byte = input_buffer_.Peek(1);
-    if (len_byte < 3) {
-      input_buffer_.Pop(1);
-      continue;
-    }
+void SerialTransport::Receive(const uint8_t* data, size_t len) {
+  last_read_time_ = Now();
+  OnBytes(data, len);
+}
 
-    size_t total_len = 1 + len_byte;
+void SerialTransport::QueueWrite(const std::vector<uint8_t>& frame) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  if (hung_up_ || pending_write_.size() + frame.size() > kMaxPendingWrite) {
+    return;
+  }
+  bool idle = pending_write_.empty();
+  pending_write_.insert(pending_write_.end(), frame.begin(), frame.end());
+  // Otherwise the reactor is already waiting to write the earlier bytes
+  if (idle) FlushPendingLocked();
+}
 
-    if (input_buffer_.Size() < total_len) {
+void SerialTransport::FlushPendingLocked() {
+  size_t written = 0;
+  while (written < pending_write_.size()) {
+    ssize_t n = ::write(fd_, pending_write_.data() + written,
+                        pending_write_.size() - written);
+    if (n > 0) {
+      written += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      if (n < 0 && errno != EAGAIN) {
+        hung_up_ = true;
+        written = pending_write_.size();
+      }
       break;
     }
+  }
+  pending_write_.erase(pending_write_.begin(), pending_write_.begin() + written);
 
-    std::vector<uint8_t> frame(total_len);
-    for (size_t i = 0; i < total_len; ++i) {
-      frame[i] = input_buffer_.Peek(i);
-    }
+  bool want = !pending_write_.empty();
+  if (reactor_ && want != watching_writable_) {
+    reactor_->WatchWritable(fd_, want);
+    watching_writable_ = want;
+  }
+}
 
-    uint16_t received_crc = frame[total_len - 2] | (frame[total_len - 1] << 8);
-    uint16_t calculated_crc = CalculateCrc16(&frame[1], len_byte - 2);
+void SerialTransport::OnBytes(const uint8_t* data, size_t len) {
+  std::lock_guard<std::mutex> lock(rx_mutex_);
+  rx_codec_.Feed(data, len, [this](std::vector<uint8_t>& payload,
+                                   const uint8_t* frame, size_t frame_len) {
+    if (log_cb_) log_cb_(std::vector<uint8_t>(frame, frame + frame_len), false);
+    CheckFramingAck(payload);
 
-    if (received_crc == calculated_crc) {
-      if (log_cb_) log_cb_(frame, false);
-      std::vector<uint8_t> payload;
-      if (len_byte > 3) {
-        payload.assign(frame.begin() + 2, frame.end() - 2);
-      }
-      input_queue_.Push(payload);
-      input_buffer_.Pop(total_len);
-    } else {
-      input_buffer_.Pop(1);
+    Segmenter::Frames replies;
+    Segmenter::Frames completed;
+    bool segment;
+    {
+      std::lock_guard<std::mutex> lock(segment_mutex_);
+      segment = segmenter_.OnFrame(payload, last_read_time_, replies, completed);
     }
-  }
+    for (auto& reply : replies) SendPayload(std::move(reply));
+    if (!segment) {
+      input_queue_.Push({std::move(payload), last_read_time_});
+      return;
+    }
+    for (auto& reassembled : completed) {
+      input_queue_.Push({std::move(reassembled), last_read_time_});
+    }
+  });
 }
 
-uint16_t SerialTransport::CalculateCrc16(const uint8_t* data, size_t len) {
-  uint16_t crc = 0xFFFF;
-  for (size_t pos = 0; pos < len; pos++) {
-    crc ^= (uint16_t)data[pos];
-    for (int i = 8; i != 0; i--) {
-      if ((crc & 0x0001) != 0) {
-        crc >>= 1;
-        crc ^= 0xA001;
-      } else {
-        crc >>= 1;
-      }
+void SerialTransport::CheckFramingAck(const std::vector<uint8_t>& payload) {
+  std::vector<std::vector<uint8_t>> held;
+  {
+    std::lock_guard<std::mutex> lock(framing_mutex_);
+    if (!switch_pending_ || payload.size() < 2 || payload[0] != switch_command_) {
+      return;
+    }
+    switch_pending_ = false;
+    if (payload[1] == 0) {
+      // Everything after this frame arrives in the new framing
+      rx_codec_.SetFraming(switch_framing_);
+      tx_framing_ = switch_framing_;
     }
+    held.swap(held_);
   }
-  return crc;
+  for (const auto& frame : held) SendFrame(frame);
+}
+
+std::chrono::steady_clock::time_point SerialTransport::Now() const {
+  return clock_ ? clock_->Now() : std::chrono::steady_clock::now();
 }
 
 speed_t SerialTransport::GetBaud(int baud) {
@@ -1,35 +1,95 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
 #include <termios.h>
 #include <thread>
 #include <vector>
 #include <functional>
 
-#include "CircularBuffer.h"
+#include "FrameCodec.h"
+#include "Scheduler.h"
+#include "Segmenter.h"
 #include "ThreadSafeQueue.h"
 
+class IoReactor;
+
 class SerialTransport {
  public:
+  struct RxFrame {
+    std::vector<uint8_t> payload;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  using Framing = FrameCodec::Framing;
+
+  // Throws if the port cannot be opened or another transport holds it
   SerialTransport(const std::string& port, int baud);
+  // Adopts an already open descriptor (e.g. a pty master) and takes ownership
+  explicit SerialTransport(int fd);
+  using WriteFunction = std::function<void(const std::vector<uint8_t>& bytes)>;
+  // A link without a port, e.g. to a simulated ECU in virtual time: encoded
+  // frames go to write on the sending thread, the owner passes the bytes that
+  // arrive to Receive(), and times are read from clock. Start() creates no
+  // threads, so the owner must call Poll() as in reactor mode.
+  SerialTransport(Scheduler* clock, WriteFunction write);
   ~SerialTransport();
 
   using LogCallback = std::function<void(const std::vector<uint8_t>&, bool isTx)>;
   void SetLogCallback(LogCallback cb) { log_cb_ = cb; }
 
   void Start();
+  // Reactor mode: the port owns no threads and its descriptor is made
+  // non-blocking. Reads are dispatched by a shared IoReactor. Send() writes
+  // what the port takes at once and queues the rest for the reactor, so a
+  // slow or unplugged port never stalls the sending thread.
+  void Start(IoReactor* reactor);
+  // Frames already sent are written out before the threads stop
   void Stop();
-  void Send(std::vector<uint8_t> data);
+  // Payloads larger than one frame go out as segments and arrive through
+  // Read() reassembled; false if data is empty or too large even for that
+  bool Send(std::vector<uint8_t> data);
   bool Read(std::vector<uint8_t>& payload);
-  bool IsConnected() const { return fd_ >= 0; }
+  // Also returns the host time the frame's last byte was read from the port
+  bool Read(std::vector<uint8_t>& payload,
+            std::chrono::steady_clock::time_point& rx_time);
+  // False once a port in reactor mode hung up, e.g. when unplugged
+  bool IsConnected() const { return (fd_ >= 0 && !hung_up_) || write_ != nullptr; }
+  // Bytes received on a link without a port
+  void Receive(const uint8_t* data, size_t len);
+
+  // Retransmits lost segments and sends delayed segment acks. The read thread
+  // calls it; in reactor mode the owner must, every few milliseconds.
+  void Poll();
+  Segmenter::Stats segment_stats();
+
+  // Sends request in the current framing and switches both directions to
+  // framing once the peer answers {request[0], 0}. Frames sent in between are
+  // held and then go out in the new framing; without an answer within 500 ms
+  // they are sent in the old one.
+  void SendFramingSwitch(std::vector<uint8_t> request, Framing framing);
+  // Immediate switches, for the answering side of the negotiation
+  void SetRxFraming(Framing framing);
+  void SetTxFraming(Framing framing) { tx_framing_ = framing; }
+  Framing tx_framing() const { return tx_framing_; }
 
  private:
   void ReadLoop();
   void WriteLoop();
-  void ProcessBuffer();
-  uint16_t CalculateCrc16(const uint8_t* data, size_t len);
+  void OnReady(uint32_t events);
+  void OnReadable();
+  void WriteFrame(const std::vector<uint8_t>& frame);
+  void QueueWrite(const std::vector<uint8_t>& frame);
+  // With write_mutex_ held
+  void FlushPendingLocked();
+  void SendPayload(std::vector<uint8_t> payload);
+  void SendFrame(const std::vector<uint8_t>& payload);
+  void OnBytes(const uint8_t* data, size_t len);
+  void CheckFramingAck(const std::vector<uint8_t>& payload);
   speed_t GetBaud(int baud);
+  std::chrono::steady_clock::time_point Now() const;
 
   std::string port_;
   int baud_;
@@ -37,9 +97,31 @@ class SerialTransport {
   std::atomic<bool> running_{false};
   std::thread read_thread_;
   std::thread write_thread_;
+  IoReactor* reactor_ = nullptr;
+  Scheduler* clock_ = nullptr;
+  WriteFunction write_;
+  std::atomic<bool> hung_up_{false};
+  std::mutex write_mutex_;
+  // Reactor mode: bytes the port did not take yet, written on writability
+  std::vector<uint8_t> pending_write_;
+  bool watching_writable_ = false;
+
+  std::mutex rx_mutex_;
+  FrameCodec rx_codec_;
+  std::atomic<Framing> tx_framing_{Framing::kLegacy};
+
+  std::mutex framing_mutex_;
+  bool switch_pending_ = false;
+  uint8_t switch_command_ = 0;
+  Framing switch_framing_ = Framing::kLegacy;
+  std::chrono::steady_clock::time_point switch_deadline_;
+  std::vector<std::vector<uint8_t>> held_;
+  std::chrono::steady_clock::time_point last_read_time_;
+
+  std::mutex segment_mutex_;
+  Segmenter segmenter_;
 
-  CircularBuffer input_buffer_;
-  ThreadSafeQueue<std::vector<uint8_t>> input_queue_;
+  ThreadSafeQueue<RxFrame> input_queue_;
   ThreadSafeQueue<std::vector<uint8_t>> output_queue_;
   LogCallback log_cb_;
 };
@@ -0,0 +1,118 @@
+#include "SetpointDispatcher.h"
+
+#include <algorithm>
+
+SetpointDispatcher::SetpointDispatcher(SendFunction send)
+    : send_(std::move(send)) {}
+
+SetpointDispatcher::~SetpointDispatcher() { Stop(); }
+
+void SetpointDispatcher::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) return;
+  running_ = true;
+  have_setpoint_ = false;
+  pending_ = false;
+  thread_ = std::thread(&SetpointDispatcher::Loop, this);
+}
+
+void SetpointDispatcher::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+void SetpointDispatcher::SetConfig(const Config& config) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    config_.max_rate_hz = std::max(config_.max_rate_hz, 1);
+  }
+  wake_.notify_all();
+}
+
+void SetpointDispatcher::Submit(const Speeds& speeds) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) return;
+  Clock::time_point now = Clock::now();
+  if (have_setpoint_ && speeds == last_sent_) {
+    // Back to what the ECU already has: nothing held needs to go out
+    if (pending_) ++stats_.coalesced;
+    pending_ = false;
+    return;
+  }
+  auto interval = std::chrono::microseconds(1000000 / config_.max_rate_hz);
+  if (!have_setpoint_ || now - last_send_time_ >= interval) {
+    ++stats_.sent;
+    pending_ = false;
+    SendLocked(speeds, now);
+    return;
+  }
+  if (pending_) {
+    ++stats_.coalesced;
+  } else {
+    ++stats_.held;
+  }
+  pending_ = true;
+  pending_speeds_ = speeds;
+  lock.unlock();
+  wake_.notify_all();
+}
+
+void SetpointDispatcher::SendNow(const Speeds& speeds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_) return;
+  if (pending_) ++stats_.coalesced;
+  pending_ = false;
+  ++stats_.sent;
+  SendLocked(speeds, Clock::now());
+}
+
+SetpointDispatcher::Stats SetpointDispatcher::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void SetpointDispatcher::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    auto interval = std::chrono::microseconds(1000000 / config_.max_rate_hz);
+    Clock::time_point wake_at = Clock::time_point::max();
+    if (pending_) {
+      wake_at = last_send_time_ + interval;
+    } else if (have_setpoint_ && config_.keepalive > Clock::duration::zero()) {
+      wake_at = last_send_time_ + config_.keepalive;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (now < wake_at) {
+      if (wake_at == Clock::time_point::max()) {
+        wake_.wait(lock);
+      } else {
+        wake_.wait_until(lock, wake_at);
+      }
+      continue;
+    }
+    if (pending_) {
+      pending_ = false;
+      ++stats_.sent;
+      SendLocked(pending_speeds_, now);
+    } else {
+      ++stats_.keepalives;
+      SendLocked(last_sent_, now);
+    }
+  }
+}
+
+void SetpointDispatcher::SendLocked(const Speeds& speeds, Clock::time_point now) {
+  // Sending under the lock keeps setpoints in order between threads; the
+  // send function only queues a frame
+  last_sent_ = speeds;
+  last_send_time_ = now;
+  have_setpoint_ = true;
+  send_(speeds);
+  wake_.notify_all();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sends motor setpoints as soon as input changes them, at most max_rate_hz
+// times per second, and repeats the last one as a keepalive when nothing
+// changed for keepalive. A setpoint arriving within the minimum interval of
+// the previous send is held and sent when the interval ends, replacing any
+// setpoint held before it, so a fast-moving stick never queues up stale
+// values. Submit() may be called from any thread; a send that is due goes
+// out on the calling thread, held ones and keepalives on the dispatcher's.
+class SetpointDispatcher {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Speeds = std::vector<int>;
+  using SendFunction = std::function<void(const Speeds&)>;
+
+  struct Config {
+    int max_rate_hz = 50;
+    Clock::duration keepalive = std::chrono::milliseconds(100);  // 0: off
+  };
+
+  struct Stats {
+    uint64_t sent = 0;        // Changes sent, immediately or held
+    uint64_t held = 0;        // Changes delayed by the rate limit
+    uint64_t coalesced = 0;   // Held changes replaced before they went out
+    uint64_t keepalives = 0;
+  };
+
+  explicit SetpointDispatcher(SendFunction send);
+  ~SetpointDispatcher();
+
+  void Start();
+  void Stop();
+  void SetConfig(const Config& config);
+
+  // Rate-limited; unchanged setpoints are left to the keepalive
+  void Submit(const Speeds& speeds);
+  // Sends at once regardless of the rate limit, e.g. an explicit command or
+  // a stop
+  void SendNow(const Speeds& speeds);
+
+  Stats stats() const;
+
+ private:
+  void Loop();
+  // With mutex_ held
+  void SendLocked(const Speeds& speeds, Clock::time_point now);
+
+  SendFunction send_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  Config config_;
+  bool running_ = false;
+  bool have_setpoint_ = false;
+  Speeds last_sent_;
+  Clock::time_point last_send_time_;
+  bool pending_ = false;
+  Speeds pending_speeds_;
+  Stats stats_;
+  std::thread thread_;
+};
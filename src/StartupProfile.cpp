@@ -0,0 +1,62 @@
+#include "StartupProfile.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEvent>
+#include <QTimer>
+#include <QWidget>
+
+namespace {
+
+QElapsedTimer startTimer;
+qint64 lastMarkNs = 0;
+
+qint64 SinceStart() {
+    return startTimer.isValid() ? startTimer.elapsed() : 0;
+}
+
+void Log(const QString &phase, qint64 durationNs) {
+    qInfo().noquote() << QString("startup: %1 %2 ms (t=%3 ms)")
+                             .arg(phase).arg(durationNs / 1e6, 0, 'f', 1).arg(SinceStart());
+}
+
+}  // namespace
+
+StartupProfile::Phase::Phase(const QString &name) : name_(name) {
+    timer_.start();
+}
+
+StartupProfile::Phase::~Phase() {
+    Log(name_, timer_.nsecsElapsed());
+}
+
+void StartupProfile::Start() {
+    startTimer.start();
+    lastMarkNs = 0;
+}
+
+void StartupProfile::Mark(const QString &phase) {
+    qint64 now = startTimer.isValid() ? startTimer.nsecsElapsed() : 0;
+    Log(phase, now - lastMarkNs);
+    lastMarkNs = now;
+}
+
+void StartupProfile::WatchFirstPaint(QWidget *window) {
+    // Deletes itself after the first frame
+    qApp->installEventFilter(new StartupProfile(window));
+}
+
+StartupProfile::StartupProfile(QWidget *window) : QObject(window), window_(window) {}
+
+bool StartupProfile::eventFilter(QObject *watched, QEvent *event) {
+    if (event->type() != QEvent::Paint || !watched->isWidgetType()) return false;
+    if (static_cast<QWidget *>(watched)->window() != window_) return false;
+    // All widgets of a frame are painted in one pass; the frame is done once
+    // control is back in the event loop
+    qApp->removeEventFilter(this);
+    QTimer::singleShot(0, this, [this] {
+        Mark("first paint");
+        deleteLater();
+    });
+    return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+
+class QWidget;
+
+// Times the phases of GUI start-up and logs each one as
+//   startup: <phase> <duration> ms (t=<time since Start()> ms)
+// so that a cold-start regression shows up in the log. main() marks the end
+// of each sequential phase; panels time their own construction with Phase,
+// which also covers panels built lazily long after start-up.
+// GUI thread only.
+class StartupProfile : public QObject {
+    Q_OBJECT
+public:
+    // Times the enclosing scope
+    class Phase {
+    public:
+        explicit Phase(const QString &name);
+        ~Phase();
+
+    private:
+        QString name_;
+        QElapsedTimer timer_;
+    };
+
+    // As early as possible in main(), before QApplication
+    static void Start();
+    // Ends the phase that began at the previous mark
+    static void Mark(const QString &phase);
+    // Marks "first paint" once the first frame of window has been painted
+    static void WatchFirstPaint(QWidget *window);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    explicit StartupProfile(QWidget *window);
+
+    QWidget *window_;
+};
@@ -0,0 +1,232 @@
+#include "TelemetryExporter.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+struct FieldGroup {
+  const char* name;
+  const char* axes[4];
+  int count;
+};
+
+// Field layout of an IMU sample, in ImuData order.
+const FieldGroup kImuGroups[] = {
+    {"accel", {"x", "y", "z"}, 3},
+    {"gyro", {"x", "y", "z"}, 3},
+    {"mag", {"x", "y", "z"}, 3},
+    {"quat", {"w", "x", "y", "z"}, 4},
+};
+
+const char* const kMotorNames[] = {"m1", "m2", "m3", "m4"};
+
+void AppendString(std::vector<uint8_t>& out, const char* s) {
+  out.insert(out.end(), s, s + strlen(s));
+}
+
+void AppendNumber(std::vector<uint8_t>& out, double v) {
+  // JSON has no nan or inf
+  if (!std::isfinite(v)) {
+    AppendString(out, "null");
+    return;
+  }
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), "%.7g", v);
+  out.insert(out.end(), buf, buf + n);
+}
+
+void PackStr(std::vector<uint8_t>& out, const char* s) {
+  size_t len = strlen(s);  // Keys are short literals, fixstr is enough
+  out.push_back(static_cast<uint8_t>(0xA0 | len));
+  out.insert(out.end(), s, s + len);
+}
+
+void PackMap(std::vector<uint8_t>& out, int entries) {
+  out.push_back(static_cast<uint8_t>(0x80 | entries));
+}
+
+void PackFloat(std::vector<uint8_t>& out, float v) {
+  uint32_t bits;
+  std::memcpy(&bits, &v, 4);
+  out.push_back(0xCA);
+  for (int shift = 24; shift >= 0; shift -= 8) out.push_back((bits >> shift) & 0xFF);
+}
+
+void PackDouble(std::vector<uint8_t>& out, double v) {
+  uint64_t bits;
+  std::memcpy(&bits, &v, 8);
+  out.push_back(0xCB);
+  for (int shift = 56; shift >= 0; shift -= 8) out.push_back((bits >> shift) & 0xFF);
+}
+
+}  // namespace
+
+TelemetryExporter::TelemetryExporter(const std::string& host, uint16_t port,
+                                     Format format)
+    : format_(format) {
+  dest_.sin_family = AF_INET;
+  dest_.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &dest_.sin_addr) != 1) {
+    throw std::runtime_error("Invalid UDP export address");
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error("Error creating UDP socket");
+  }
+}
+
+TelemetryExporter::~TelemetryExporter() {
+  Stop();
+  if (fd_ >= 0) close(fd_);
+}
+
+void TelemetryExporter::Start() {
+  if (running_) return;
+  running_ = true;
+  send_thread_ = std::thread(&TelemetryExporter::SendLoop, this);
+}
+
+void TelemetryExporter::Stop() {
+  running_ = false;
+  if (send_thread_.joinable()) send_thread_.join();
+}
+
+void TelemetryExporter::Push(const TelemetrySample& sample) {
+  // Never let a stalled consumer grow the queue without bound
+  if (queue_.Size() >= kMaxPending) {
+    dropped_++;
+    return;
+  }
+  queue_.Push(sample);
+}
+
+void TelemetryExporter::SendLoop() {
+  std::vector<TelemetrySample> batch;
+  batch.reserve(kMaxBatch);
+  while (running_) {
+    TelemetrySample sample;
+    while (batch.size() < kMaxBatch && queue_.Pop(sample)) {
+      batch.push_back(sample);
+    }
+    if (batch.empty()) {
+      // Samples arrive at the poll rate, a few ms of batching is invisible in a plot
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    Flush(batch);
+    batch.clear();
+  }
+}
+
+void TelemetryExporter::Flush(const std::vector<TelemetrySample>& batch) {
+  // One datagram per sample (what PlotJuggler's parsers expect), but the whole
+  // batch goes out in a single sendmmsg() call.
+  std::vector<std::vector<uint8_t>> datagrams(batch.size());
+  std::vector<iovec> iov(batch.size());
+  std::vector<mmsghdr> msgs(batch.size());
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (format_ == Format::kJson) {
+      SerializeJson(batch[i], datagrams[i]);
+    } else {
+      SerializeMsgPack(batch[i], datagrams[i]);
+    }
+    iov[i].iov_base = datagrams[i].data();
+    iov[i].iov_len = datagrams[i].size();
+    std::memset(&msgs[i], 0, sizeof(mmsghdr));
+    msgs[i].msg_hdr.msg_name = &dest_;
+    msgs[i].msg_hdr.msg_namelen = sizeof(dest_);
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  size_t sent = 0;
+  while (sent < msgs.size()) {
+    int n = sendmmsg(fd_, msgs.data() + sent, msgs.size() - sent, 0);
+    if (n <= 0) {
+      // Nobody listening or buffer full: telemetry is best-effort
+      dropped_ += msgs.size() - sent;
+      break;
+    }
+    sent += n;
+  }
+}
+
+void TelemetryExporter::SerializeJson(const TelemetrySample& sample,
+                                      std::vector<uint8_t>& out) {
+  out.reserve(sample.kind == TelemetrySample::Kind::kImu ? 320 : 96);
+  AppendString(out, "{\"timestamp\":");
+  char ts[32];
+  int n = snprintf(ts, sizeof(ts), "%.6f", sample.timestamp);
+  out.insert(out.end(), ts, ts + n);
+
+  if (sample.kind == TelemetrySample::Kind::kEncoders) {
+    AppendString(out, ",\"encoders\":{");
+    for (int i = 0; i < 4; ++i) {
+      if (i > 0) out.push_back(',');
+      out.push_back('"');
+      AppendString(out, kMotorNames[i]);
+      AppendString(out, "\":");
+      AppendNumber(out, sample.values[i]);
+    }
+    out.push_back('}');
+  } else {
+    AppendString(out, ",\"imu\":{");
+    int index = 0;
+    for (size_t g = 0; g < sizeof(kImuGroups) / sizeof(kImuGroups[0]); ++g) {
+      if (g > 0) out.push_back(',');
+      out.push_back('"');
+      AppendString(out, kImuGroups[g].name);
+      AppendString(out, "\":{");
+      for (int a = 0; a < kImuGroups[g].count; ++a) {
+        if (a > 0) out.push_back(',');
+        out.push_back('"');
+        AppendString(out, kImuGroups[g].axes[a]);
+        AppendString(out, "\":");
+        AppendNumber(out, sample.values[index++]);
+      }
+      out.push_back('}');
+    }
+    out.push_back('}');
+  }
+  out.push_back('}');
+}
+
+void TelemetryExporter::SerializeMsgPack(const TelemetrySample& sample,
+                                         std::vector<uint8_t>& out) {
+  out.reserve(sample.kind == TelemetrySample::Kind::kImu ? 128 : 48);
+  PackMap(out, 2);
+  PackStr(out, "timestamp");
+  PackDouble(out, sample.timestamp);
+
+  if (sample.kind == TelemetrySample::Kind::kEncoders) {
+    PackStr(out, "encoders");
+    PackMap(out, 4);
+    for (int i = 0; i < 4; ++i) {
+      PackStr(out, kMotorNames[i]);
+      PackFloat(out, sample.values[i]);
+    }
+  } else {
+    PackStr(out, "imu");
+    int groups = sizeof(kImuGroups) / sizeof(kImuGroups[0]);
+    PackMap(out, groups);
+    int index = 0;
+    for (int g = 0; g < groups; ++g) {
+      PackStr(out, kImuGroups[g].name);
+      PackMap(out, kImuGroups[g].count);
+      for (int a = 0; a < kImuGroups[g].count; ++a) {
+        PackStr(out, kImuGroups[g].axes[a]);
+        PackFloat(out, sample.values[index++]);
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadSafeQueue.h"
+
+// One decoded telemetry sample as handed over by ECUConnector.
+struct TelemetrySample {
+  enum class Kind : uint8_t { kEncoders, kImu };
+
+  Kind kind = Kind::kEncoders;
+  double timestamp = 0;  // Host time, seconds since the Unix epoch
+  float values[13] = {};
+};
+
+// Streams telemetry samples to a UDP endpoint (e.g. PlotJuggler's UDP server).
+// Serialisation and socket I/O run on a dedicated thread; Push() only enqueues.
+class TelemetryExporter {
+ public:
+  enum class Format { kJson, kMsgPack };
+
+  TelemetryExporter(const std::string& host, uint16_t port, Format format);
+  ~TelemetryExporter();
+
+  void Start();
+  void Stop();
+  void Push(const TelemetrySample& sample);
+  uint64_t DroppedSamples() const { return dropped_; }
+
+ private:
+  void SendLoop();
+  void Flush(const std::vector<TelemetrySample>& batch);
+  void SerializeJson(const TelemetrySample& sample, std::vector<uint8_t>& out);
+  void SerializeMsgPack(const TelemetrySample& sample, std::vector<uint8_t>& out);
+
+  static constexpr size_t kMaxBatch = 64;
+  static constexpr size_t kMaxPending = 4096;
+
+  int fd_ = -1;
+  sockaddr_in dest_{};
+  Format format_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> dropped_{0};
+  std::thread send_thread_;
+
+  ThreadSafeQueue<TelemetrySample> queue_;
+};
@@ -0,0 +1,89 @@
+#include "TestPlan.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+std::string TestStep::Describe() const {
+  std::ostringstream out;
+  switch (type) {
+    case Type::kSpeed:
+      out << "speed " << target_rpm;
+      break;
+    case Type::kRamp:
+      out << "ramp " << target_rpm << " " << duration_ms;
+      break;
+    case Type::kHold:
+      out << "hold " << duration_ms;
+      break;
+    case Type::kCheckRpm:
+      out << "check_rpm " << tolerance_pct;
+      break;
+    case Type::kReadImu:
+      out << "imu";
+      break;
+    case Type::kStop:
+      out << "stop";
+      break;
+  }
+  return out.str();
+}
+
+TestPlan TestPlan::Parse(const std::string& text) {
+  TestPlan plan;
+  std::istringstream input(text);
+  std::string line;
+  int line_no = 0;
+
+  while (std::getline(input, line)) {
+    ++line_no;
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+
+    std::istringstream fields(line);
+    std::string keyword;
+    if (!(fields >> keyword)) continue;
+
+    TestStep step;
+    step.line = line_no;
+    bool ok = true;
+    if (keyword == "speed") {
+      step.type = TestStep::Type::kSpeed;
+      ok = static_cast<bool>(fields >> step.target_rpm);
+    } else if (keyword == "ramp") {
+      step.type = TestStep::Type::kRamp;
+      ok = static_cast<bool>(fields >> step.target_rpm >> step.duration_ms) &&
+           step.duration_ms > 0;
+    } else if (keyword == "hold") {
+      step.type = TestStep::Type::kHold;
+      ok = static_cast<bool>(fields >> step.duration_ms) && step.duration_ms > 0;
+    } else if (keyword == "check_rpm") {
+      step.type = TestStep::Type::kCheckRpm;
+      ok = static_cast<bool>(fields >> step.tolerance_pct) && step.tolerance_pct > 0;
+    } else if (keyword == "imu") {
+      step.type = TestStep::Type::kReadImu;
+    } else if (keyword == "stop") {
+      step.type = TestStep::Type::kStop;
+    } else {
+      throw std::runtime_error("Unknown test step '" + keyword + "' on line " +
+                               std::to_string(line_no));
+    }
+
+    if (!ok) {
+      throw std::runtime_error("Invalid arguments for '" + keyword + "' on line " +
+                               std::to_string(line_no));
+    }
+    plan.steps.push_back(step);
+  }
+  return plan;
+}
+
+TestPlan TestPlan::Load(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Error opening test plan " + path);
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  return Parse(text.str());
+}
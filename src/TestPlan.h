@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One step of a production test plan.
+struct TestStep {
+  enum class Type { kSpeed, kRamp, kHold, kCheckRpm, kReadImu, kStop };
+
+  Type type = Type::kStop;
+  double target_rpm = 0;     // kSpeed, kRamp
+  int duration_ms = 0;       // kRamp, kHold
+  double tolerance_pct = 0;  // kCheckRpm
+  int line = 0;              // Source line, for reports
+
+  std::string Describe() const;
+};
+
+// Plain-text test plan, one step per line ('#' starts a comment):
+//   speed <rpm>            set all motors to <rpm>
+//   ramp <rpm> <ms>        ramp linearly from the current setpoint to <rpm>
+//   hold <ms>              keep the setpoint and sample encoders for <ms>
+//   check_rpm <percent>    mean RPM of the last hold within <percent> of setpoint
+//   imu                    read one IMU sample
+//   stop                   set all motors to zero
+struct TestPlan {
+  std::vector<TestStep> steps;
+
+  // Throws std::runtime_error naming the offending line.
+  static TestPlan Parse(const std::string& text);
+  static TestPlan Load(const std::string& path);
+};
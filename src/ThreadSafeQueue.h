@@ -35,6 +35,11 @@ class ThreadSafeQueue {
     return queue_.empty();
   }
 
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
  private:
   std::queue<T> queue_;
   mutable std::mutex mutex_;
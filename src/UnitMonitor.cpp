@@ -0,0 +1,105 @@
+#include "UnitMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Buckets the sample rate is averaged over
+constexpr size_t kRateBuckets = 4;
+
+}  // namespace
+
+void UnitMonitor::SetConnected(bool connected, Clock::time_point now) {
+  Advance(now);
+  connected_ = connected;
+  if (connected) {
+    // Not stale before the first sample had a chance to arrive
+    last_sample_ = now;
+  }
+}
+
+void UnitMonitor::OnEncoders(const float* deltas, Clock::time_point captured) {
+  Advance(captured);
+  // Late samples, e.g. placed by their ECU timestamp, go to the open bucket
+  for (int i = 0; i < 4; ++i) current_.ticks[i] += deltas[i];
+  ++current_.samples;
+  ++samples_;
+  if (captured > last_sample_) last_sample_ = captured;
+}
+
+void UnitMonitor::OnGap(uint64_t missed, Clock::time_point now) {
+  gaps_ += missed;
+  last_gap_ = now;
+}
+
+void UnitMonitor::OnError(const std::string& message, Clock::time_point now) {
+  ++errors_;
+  last_error_ = now;
+  last_error_message_ = message;
+}
+
+void UnitMonitor::Advance(Clock::time_point now) {
+  if (!started_) {
+    started_ = true;
+    bucket_start_ = now;
+    return;
+  }
+  if (now - bucket_start_ < config_.bucket) return;
+  history_.push_back(current_);
+  current_ = Bucket();
+  bucket_start_ += config_.bucket;
+  // After a long silence skip ahead instead of pushing one bucket at a time
+  auto missed = (now - bucket_start_) / config_.bucket;
+  auto empty = missed;
+  if (missed >= static_cast<int64_t>(config_.buckets)) {
+    history_.clear();
+    empty = config_.buckets;
+  }
+  for (int64_t i = 0; i < empty; ++i) history_.push_back(Bucket());
+  // The open bucket is always the one containing now
+  bucket_start_ += missed * config_.bucket;
+  while (history_.size() > config_.buckets) history_.pop_front();
+}
+
+UnitMonitor::Snapshot UnitMonitor::TakeSnapshot(Clock::time_point now) {
+  Advance(now);
+  Snapshot s;
+  s.samples = samples_;
+  s.gaps = gaps_;
+  s.errors = errors_;
+  s.last_error = last_error_message_;
+
+  bool recent_error = errors_ > 0 && now - last_error_ < config_.alarm_hold;
+  bool recent_gap = gaps_ > 0 && now - last_gap_ < config_.alarm_hold;
+  if (!connected_) {
+    s.alarm = Alarm::kDisconnected;
+  } else if (now - last_sample_ > config_.stale_after) {
+    s.alarm = Alarm::kStale;
+  } else if (recent_error) {
+    s.alarm = Alarm::kErrors;
+  } else if (recent_gap) {
+    s.alarm = Alarm::kGaps;
+  } else {
+    s.alarm = Alarm::kOk;
+  }
+
+  double bucket_s = std::chrono::duration<double>(config_.bucket).count();
+  double rpm_per_tick = 60.0 / (config_.ticks_per_rev * bucket_s);
+  for (int i = 0; i < 4; ++i) s.rpm[i].reserve(history_.size());
+  for (const Bucket& bucket : history_) {
+    for (int i = 0; i < 4; ++i) {
+      s.rpm[i].push_back(bucket.samples == 0 ? std::numeric_limits<float>::quiet_NaN()
+                                             : static_cast<float>(bucket.ticks[i] * rpm_per_tick));
+    }
+  }
+
+  size_t rate_buckets = std::min(kRateBuckets, history_.size());
+  uint32_t recent = 0;
+  for (size_t i = history_.size() - rate_buckets; i < history_.size(); ++i) {
+    recent += history_[i].samples;
+  }
+  if (rate_buckets > 0) s.sample_rate_hz = recent / (rate_buckets * bucket_s);
+  return s;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Condensed state of one ECU for the fleet overview: link health, sample
+// rate, alarm state and per-motor RPM history. Encoder deltas are summed
+// into fixed time buckets, so the history is already decimated to one value
+// per bucket whatever the telemetry rate, and a tile draws a few dozen
+// points per motor. FleetPanel keeps one per unit and calls it only from the
+// GUI thread, in its connector's signal handlers and its refresh timer.
+// Encoder samples carry the connector's SampleTime(); other events and
+// snapshots use steady_clock::now() at the time they are handled.
+class UnitMonitor {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Config {
+    double ticks_per_rev = 1328;
+    Clock::duration bucket = std::chrono::milliseconds(250);
+    size_t buckets = 120;  // History length, 30 s at the default bucket
+    // No encoder sample for this long while connected raises kStale
+    Clock::duration stale_after = std::chrono::seconds(1);
+    // Errors and stream gaps keep their alarm up for this long
+    Clock::duration alarm_hold = std::chrono::seconds(5);
+  };
+
+  // In increasing severity
+  enum class Alarm { kOk, kGaps, kErrors, kStale, kDisconnected };
+
+  struct Snapshot {
+    Alarm alarm = Alarm::kDisconnected;
+    double sample_rate_hz = 0;
+    uint64_t samples = 0;
+    uint64_t gaps = 0;  // Lost stream frames
+    uint64_t errors = 0;
+    std::string last_error;
+    // RPM per motor, oldest bucket first; NaN for buckets without samples
+    std::array<std::vector<float>, 4> rpm;
+  };
+
+  UnitMonitor() = default;
+  explicit UnitMonitor(const Config& config) : config_(config) {}
+
+  void SetConnected(bool connected, Clock::time_point now);
+  void OnEncoders(const float* deltas, Clock::time_point captured);
+  void OnGap(uint64_t missed, Clock::time_point now);
+  void OnError(const std::string& message, Clock::time_point now);
+
+  // Closes the buckets that ended before now
+  Snapshot TakeSnapshot(Clock::time_point now);
+
+ private:
+  struct Bucket {
+    float ticks[4] = {};
+    uint32_t samples = 0;
+  };
+
+  void Advance(Clock::time_point now);
+
+  Config config_;
+  bool connected_ = false;
+  bool started_ = false;  // A bucket is open
+  Clock::time_point bucket_start_;
+  Bucket current_;
+  std::deque<Bucket> history_;
+  Clock::time_point last_sample_;
+  Clock::time_point last_gap_;
+  Clock::time_point last_error_;
+  uint64_t samples_ = 0;
+  uint64_t gaps_ = 0;
+  uint64_t errors_ = 0;
+  std::string last_error_message_;
+};
@@ -0,0 +1,118 @@
+#include "VirtualRig.h"
+
+#include <QCoreApplication>
+#include <algorithm>
+
+VirtualRig::VirtualRig(const QStringList &units, const TestPlan &plan, const Config &config)
+    : config_(config) {
+    for (const QString &name : units) {
+        auto unit = std::make_unique<Unit>();
+        Unit *u = unit.get();
+        u->simulator = std::make_unique<EcuSimulator>(config_.simulator, scheduler_.Now());
+        u->ecuLink = std::make_unique<SerialTransport>(
+            &scheduler_, [this, u](const std::vector<uint8_t> &frame) { SendUp(u, frame); });
+        u->ecuLink->Start();
+        u->connector = std::make_unique<ECUConnector>(&scheduler_);
+        ECUConnector *connector = u->connector.get();
+
+        // Wired like a production Station, with the analysis inline
+        PlanExecutor::Link link;
+        link.setSpeeds = [connector](const std::vector<int> &speeds) { connector->SetAllMotorsSpeed(speeds); };
+        link.requestEncoders = [connector]() { connector->GetAllEncoders(); };
+        link.requestImu = [connector]() { connector->GetImu(); };
+        link.finished = [u]() {
+            u->finished = true;
+            u->connector->Disconnect();
+        };
+        u->executor = std::make_unique<PlanExecutor>(name, plan, config_.station, connector->Executor(),
+                                                     std::move(link));
+
+        QObject::connect(connector, &ECUConnector::ConnectionChanged, [u](bool connected) {
+            if (connected) {
+                u->executor->Run();
+            } else if (!u->executor->IsDone()) {
+                u->executor->Abort("Disconnected");
+            }
+        });
+        QObject::connect(connector, &ECUConnector::EncoderValuesUpdated, [u](const std::vector<float> &values) {
+            u->executor->OnEncoders(values);
+        });
+        QObject::connect(connector, &ECUConnector::ImuDataReceived, [u](const ImuData &data) {
+            u->executor->OnImu(data);
+        });
+        units_.push_back(std::move(unit));
+    }
+}
+
+VirtualRig::~VirtualRig() = default;
+
+bool VirtualRig::Run(Scheduler::Clock::duration limit) {
+    start_ = scheduler_.Now();
+    for (auto &unit : units_) {
+        Unit *u = unit.get();
+        u->executor->Start();
+        auto hostLink = std::make_unique<SerialTransport>(
+            &scheduler_, [this, u](const std::vector<uint8_t> &frame) { SendDown(u, frame); });
+        u->hostLink = hostLink.get();
+        u->connector->Connect(std::move(hostLink), config_.station.baud);
+    }
+    auto finished = [this]() {
+        return std::all_of(units_.begin(), units_.end(), [](const auto &unit) { return unit->finished; });
+    };
+    size_t steps = 0;
+    while (!finished() && scheduler_.Now() - start_ < limit && scheduler_.RunNext()) {
+        // No event loop runs meanwhile; deliver the connectors' queued
+        // signals (e.g. SpeedSet) so they do not pile up over a long run
+        if (++steps % 4096 == 0) QCoreApplication::sendPostedEvents();
+    }
+    return finished();
+}
+
+std::vector<UnitResult> VirtualRig::Results() const {
+    std::vector<UnitResult> results;
+    for (const auto &unit : units_) results.push_back(unit->executor->Result());
+    return results;
+}
+
+Scheduler::Clock::duration VirtualRig::WireTime(size_t frameBytes) const {
+    // 8N1: ten bits per byte
+    double seconds = frameBytes * 10.0 / std::max(config_.station.baud, 1);
+    return std::chrono::duration_cast<Scheduler::Clock::duration>(std::chrono::duration<double>(seconds)) +
+           config_.linkLatency;
+}
+
+void VirtualRig::SendDown(Unit *unit, const std::vector<uint8_t> &frame) {
+    unit->downFree = std::max(unit->downFree, scheduler_.Now()) + WireTime(frame.size());
+    scheduler_.ScheduleAt(unit->downFree, [this, unit, frame]() {
+        unit->ecuLink->Receive(frame.data(), frame.size());
+        ServeRequests(unit);
+    });
+}
+
+void VirtualRig::SendUp(Unit *unit, const std::vector<uint8_t> &frame) {
+    unit->upFree = std::max(unit->upFree, scheduler_.Now()) + WireTime(frame.size());
+    scheduler_.ScheduleAt(unit->upFree, [unit, frame]() {
+        // The host end is gone once the connector has disconnected
+        if (!unit->connector->IsConnected()) return;
+        unit->hostLink->Receive(frame.data(), frame.size());
+    });
+}
+
+void VirtualRig::ServeRequests(Unit *unit) {
+    std::vector<uint8_t> request;
+    EcuSimulator::Frames responses;
+    while (unit->ecuLink->Read(request)) {
+        unit->simulator->HandleRequest(request, scheduler_.Now(), responses);
+        // As in ecu_sim: receive in the new framing at once, but the
+        // set_framing acknowledgement still goes out in the old one
+        bool cobs = unit->simulator->UsesCobs();
+        auto framing = cobs ? SerialTransport::Framing::kCobs : SerialTransport::Framing::kLegacy;
+        if (cobs != unit->ecuCobs) unit->ecuLink->SetRxFraming(framing);
+        for (auto &response : responses) unit->ecuLink->Send(std::move(response));
+        responses.clear();
+        if (cobs != unit->ecuCobs) {
+            unit->ecuLink->SetTxFraming(framing);
+            unit->ecuCobs = cobs;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QStringList>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "ECUConnector.h"
+#include "EcuSimulator.h"
+#include "PlanExecutor.h"
+#include "Scheduler.h"
+#include "SerialTransport.h"
+
+// Runs a test plan on simulated ECUs in virtual time. Each unit's
+// PlanExecutor, the control loop of a production station, drives a real
+// ECUConnector, whose transport is linked to its own EcuSimulator over a
+// modelled serial line, and one VirtualScheduler times them all: the plan,
+// the connector's polling and timeouts and the line. Hours of plan time run
+// in seconds, and a run reproduces exactly. Single-threaded; analysis runs
+// inline.
+class VirtualRig {
+public:
+    struct Config {
+        StationConfig station;
+        EcuSimulator::Config simulator;
+        // Per frame in each direction, on top of its time on the wire at
+        // station.baud
+        std::chrono::microseconds linkLatency{500};
+    };
+
+    VirtualRig(const QStringList &units, const TestPlan &plan, const Config &config);
+    ~VirtualRig();
+
+    // Runs until every unit has finished the plan; false if one is still
+    // running after limit of virtual time
+    bool Run(Scheduler::Clock::duration limit = std::chrono::hours(24 * 7));
+    std::vector<UnitResult> Results() const;
+    // Virtual time since Run() started
+    Scheduler::Clock::duration Elapsed() const { return scheduler_.Now() - start_; }
+
+private:
+    struct Unit {
+        std::unique_ptr<EcuSimulator> simulator;
+        // ECU end of the line
+        std::unique_ptr<SerialTransport> ecuLink;
+        bool ecuCobs = false;
+        // Destroyed after the connector, which reports its disconnect to it
+        std::unique_ptr<PlanExecutor> executor;
+        std::unique_ptr<ECUConnector> connector;
+        // Host end of the line, owned by the connector while connected
+        SerialTransport *hostLink = nullptr;
+        bool finished = false;
+        // When each direction of the line is free again
+        Scheduler::Clock::time_point downFree;
+        Scheduler::Clock::time_point upFree;
+    };
+
+    Scheduler::Clock::duration WireTime(size_t frameBytes) const;
+    void SendDown(Unit *unit, const std::vector<uint8_t> &frame);
+    void SendUp(Unit *unit, const std::vector<uint8_t> &frame);
+    void ServeRequests(Unit *unit);
+
+    Config config_;
+    VirtualScheduler scheduler_;
+    Scheduler::Clock::time_point start_;
+    std::vector<std::unique_ptr<Unit>> units_;
+};
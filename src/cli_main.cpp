@@ -0,0 +1,219 @@
+#include "CliRunner.h"
+#include "ProductionRunner.h"
+#include "VirtualRig.h"
+#ifdef ECU_PTS_HAS_SCRIPTING
+#include "ScriptPlan.h"
+#endif
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+static void PrintReport(const std::vector<UnitResult>& results) {
+    for (const auto& unit : results) {
+        printf("%s  %s  (%lld ms)\n", unit.passed ? "PASS" : "FAIL",
+               qPrintable(unit.port), static_cast<long long>(unit.durationMs));
+        for (const auto& step : unit.steps) {
+            printf("    %-4s %-20s %s\n", step.passed ? "ok" : "FAIL",
+                   qPrintable(step.step), qPrintable(step.detail));
+        }
+    }
+}
+
+static QString CsvField(QString value) {
+    value.replace('"', "\"\"");
+    return '"' + value + '"';
+}
+
+static bool RecordSession(const QString& path, const std::vector<UnitResult>& results) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        fprintf(stderr, "error: cannot open record file: %s\n", qPrintable(file.errorString()));
+        return false;
+    }
+    QTextStream out(&file);
+    out << "port,unit_passed,duration_ms,step,step_passed,detail\n";
+    for (const auto& unit : results) {
+        for (const auto& step : unit.steps) {
+            out << CsvField(unit.port) << ',' << (unit.passed ? 1 : 0) << ',' << unit.durationMs << ','
+                << CsvField(step.step) << ',' << (step.passed ? 1 : 0) << ',' << CsvField(step.detail) << '\n';
+        }
+    }
+    return true;
+}
+
+static TestPlan LoadPlan(const QString& planPath) {
+    if (planPath.endsWith(".js")) {
+#ifdef ECU_PTS_HAS_SCRIPTING
+        return ScriptPlan::Load(planPath);
+#else
+        throw std::runtime_error("Scripted test plans need Qt Qml; rebuild with qt6-declarative-dev installed");
+#endif
+    }
+    return TestPlan::Load(planPath.toStdString());
+}
+
+static int RunProductionPlan(QCoreApplication& app, const QStringList& ports, const QString& planPath,
+                             const QString& recordPath, const StationConfig& config, bool virtualTime) {
+    TestPlan plan;
+    try {
+        plan = LoadPlan(planPath);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 2;
+    }
+
+    if (virtualTime) {
+        // The ports only name the simulated units; no event loop is needed
+        VirtualRig::Config rigConfig;
+        rigConfig.station = config;
+        rigConfig.simulator.ticks_per_rev = config.ticksPerRev;
+        VirtualRig rig(ports, plan, rigConfig);
+        QElapsedTimer wallClock;
+        wallClock.start();
+        bool complete = rig.Run();
+        PrintReport(rig.Results());
+        printf("virtual time %.1f s in %lld ms\n",
+               std::chrono::duration<double>(rig.Elapsed()).count(), static_cast<long long>(wallClock.elapsed()));
+        if (!complete) {
+            fprintf(stderr, "error: the plan did not finish within the virtual time limit\n");
+            return 2;
+        }
+        if (!recordPath.isEmpty() && !RecordSession(recordPath, rig.Results())) return 2;
+        auto results = rig.Results();
+        bool failed = std::any_of(results.begin(), results.end(), [](const UnitResult& unit) { return !unit.passed; });
+        return failed ? 1 : 0;
+    }
+
+    ProductionRunner runner(ports, plan, config);
+    QObject::connect(&runner, &ProductionRunner::Finished, &app, [&runner, recordPath](int failedUnits) {
+        PrintReport(runner.Results());
+        if (!recordPath.isEmpty() && !RecordSession(recordPath, runner.Results())) {
+            QCoreApplication::exit(2);
+            return;
+        }
+        QCoreApplication::exit(failedUnits > 0 ? 1 : 0);
+    }, Qt::QueuedConnection);
+    QTimer::singleShot(0, &runner, &ProductionRunner::Start);
+
+    return app.exec();
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName("KPI-Rover");
+    app.setApplicationName("ecu_pts_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless ECU PTS: scripted connect, command, poll and record runs.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("commands", "Commands to run in order: version, encoders, imu, stop, poll, ping, log, firmware.", "[commands...]");
+
+    QCommandLineOption portOption({"p", "port"}, "Serial port.", "port", "/dev/ttyUSB0");
+    QCommandLineOption baudOption({"b", "baud"}, "Baud rate.", "baud", "115200");
+    QCommandLineOption periodOption("period", "Poll period in ms.", "ms", "100");
+    QCommandLineOption durationOption("duration", "Poll duration in ms.", "ms", "10000");
+    QCommandLineOption timeoutOption("timeout", "Response timeout in ms.", "ms", "500");
+    QCommandLineOption speedsOption("speeds", "Motor speeds sent while polling (RPM).", "m1,m2,m3,m4", "0,0,0,0");
+    QCommandLineOption recordOption({"r", "record"}, "Record every decoded response to a CSV file.", "file");
+    QCommandLineOption planOption("plan", "Run a production test plan (text, or JavaScript if *.js) instead of commands.", "file");
+    QCommandLineOption stationsOption("stations", "Serial ports to run the test plan on concurrently.", "port1,port2,...");
+    QCommandLineOption virtualOption("virtual", "Run the test plan on simulated ECUs in virtual time; --stations then names the units.");
+    QCommandLineOption ticksOption("ticks-per-rev", "Encoder ticks per revolution.", "ticks", "1328");
+    QCommandLineOption burstOption("burst", "While polling, also sample the encoders in the ECU at this rate, 16-2000 Hz (API version 5+).", "hz", "0");
+    QCommandLineOption pingSizesOption("ping-sizes", "Ping data sizes swept by the ping command (bytes, 0-248).", "n1,n2,...", "0,16,64,128,248");
+    QCommandLineOption pingRatesOption("ping-rates", "Ping rates swept by the ping command (Hz).", "hz1,hz2,...", "10,100,500");
+    QCommandLineOption pingCountOption("ping-count", "Pings per size and rate.", "count", "100");
+    QCommandLineOption firmwareOption("firmware", "Image written by the firmware command (API version 10+).", "file");
+    QCommandLineOption firmwareBlockOption("firmware-block", "Firmware block size in bytes (1-16384).", "bytes", "4096");
+    QCommandLineOption gamepadOption("gamepad", "While polling, drive with this evdev gamepad (e.g. /dev/input/event5) instead of --speeds.", "device");
+    QCommandLineOption maxRpmOption("max-rpm", "Full gamepad stick deflection in RPM.", "rpm", "200");
+    QCommandLineOption setpointRateOption("setpoint-rate", "Most gamepad setpoints sent per second.", "hz", "50");
+    QCommandLineOption cobsOption("cobs", "Switch the link to COBS framing if the ECU supports it (API version 6+).");
+    parser.addOption(portOption);
+    parser.addOption(baudOption);
+    parser.addOption(periodOption);
+    parser.addOption(durationOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(speedsOption);
+    parser.addOption(recordOption);
+    parser.addOption(planOption);
+    parser.addOption(stationsOption);
+    parser.addOption(virtualOption);
+    parser.addOption(ticksOption);
+    parser.addOption(burstOption);
+    parser.addOption(cobsOption);
+    parser.addOption(pingSizesOption);
+    parser.addOption(pingRatesOption);
+    parser.addOption(pingCountOption);
+    parser.addOption(firmwareOption);
+    parser.addOption(gamepadOption);
+    parser.addOption(maxRpmOption);
+    parser.addOption(setpointRateOption);
+    parser.addOption(firmwareBlockOption);
+    parser.process(app);
+
+    if (parser.isSet(planOption)) {
+        StationConfig config;
+        config.baud = parser.value(baudOption).toInt();
+        config.periodMs = parser.value(periodOption).toInt();
+        config.timeoutMs = parser.value(timeoutOption).toInt();
+        config.ticksPerRev = parser.value(ticksOption).toInt();
+        QStringList ports = parser.isSet(stationsOption)
+            ? parser.value(stationsOption).split(',')
+            : QStringList{parser.value(portOption)};
+        return RunProductionPlan(app, ports, parser.value(planOption), parser.value(recordOption), config,
+                                 parser.isSet(virtualOption));
+    }
+
+    CliRunner::Options options;
+    options.port = parser.value(portOption);
+    options.baud = parser.value(baudOption).toInt();
+    options.periodMs = parser.value(periodOption).toInt();
+    options.durationMs = parser.value(durationOption).toInt();
+    options.timeoutMs = parser.value(timeoutOption).toInt();
+    options.recordPath = parser.value(recordOption);
+    options.burstHz = parser.value(burstOption).toInt();
+    if (options.burstHz != 0 &&
+        (options.burstHz < protocol::kBurstMinRateHz || options.burstHz > protocol::kBurstMaxRateHz)) {
+        fprintf(stderr, "error: --burst expects 0 or a rate of %d-%d Hz\n",
+                protocol::kBurstMinRateHz, protocol::kBurstMaxRateHz);
+        return 2;
+    }
+    options.cobs = parser.isSet(cobsOption);
+    options.commands = parser.positionalArguments();
+    if (options.commands.isEmpty()) options.commands << "version";
+
+    QStringList speeds = parser.value(speedsOption).split(',');
+    if (speeds.size() != 4) {
+        fprintf(stderr, "error: --speeds expects four comma-separated values\n");
+        return 2;
+    }
+    for (int i = 0; i < 4; ++i) options.speeds[i] = speeds[i].toInt();
+
+    options.ping.sizes.clear();
+    for (const QString& size : parser.value(pingSizesOption).split(',')) options.ping.sizes.push_back(size.toInt());
+    options.ping.rates.clear();
+    for (const QString& rate : parser.value(pingRatesOption).split(',')) options.ping.rates.push_back(rate.toInt());
+    options.ping.count = parser.value(pingCountOption).toInt();
+    options.ping.timeout = std::chrono::milliseconds(options.timeoutMs);
+    options.firmwarePath = parser.value(firmwareOption);
+    options.gamepadDevice = parser.value(gamepadOption);
+    options.maxRpm = parser.value(maxRpmOption).toInt();
+    options.setpointRateHz = parser.value(setpointRateOption).toInt();
+    options.firmwareBlockSize = parser.value(firmwareBlockOption).toInt();
+
+    CliRunner runner(options);
+    QObject::connect(&runner, &CliRunner::Finished, &app, [](int exitCode) {
+        QCoreApplication::exit(exitCode);
+    }, Qt::QueuedConnection);
+    QTimer::singleShot(0, &runner, &CliRunner::Start);
+
+    return app.exec();
+}
@@ -1,11 +1,14 @@
 #include "MainWindow.h"
+#include "StartupProfile.h"
 #include <QApplication>
 #include <QIcon>
 #include <QDebug>
 #include <QFile>
 
 int main(int argc, char *argv[]) {
+    StartupProfile::Start();
     QApplication app(argc, argv);
+    StartupProfile::Mark("qt init");
     
     // Set application properties for better window manager integration
     app.setOrganizationName("KPI-Rover");
@@ -18,8 +21,11 @@ int main(int argc, char *argv[]) {
     } else {
         app.setWindowIcon(icon);
     }
+    StartupProfile::Mark("resources");
     
     MainWindow window;
+    StartupProfile::Mark("main window");
+    StartupProfile::WatchFirstPaint(&window);
     window.show();
     
     return app.exec();
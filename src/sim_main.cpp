@@ -0,0 +1,146 @@
+// ecu_sim: serves EcuSimulator on a pseudo-terminal so ecu_pts and
+// ecu_pts_cli can connect to it like to a real serial port.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "EcuSimulator.h"
+#include "SerialTransport.h"
+
+namespace {
+
+std::atomic<bool> g_running{true};
+
+void OnSignal(int) { g_running = false; }
+
+void PrintUsage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--api N] [--ticks-per-rev N] [--drift-ppm N] [--flash-errors P]\n"
+          "          [--link PATH]\n"
+          "  --api N            API version reported to the host (default %d)\n"
+          "  --ticks-per-rev N  encoder resolution (default 1328)\n"
+          "  --drift-ppm N      ECU clock error against the host clock (default 0)\n"
+          "  --flash-errors P   share of firmware blocks that fail to program (0-1)\n"
+          "  --link PATH        create a symlink to the pty slave at PATH\n",
+          argv0, protocol::kApiLatest);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  EcuSimulator::Config config;
+  std::string link_path;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--api" && has_value) {
+      config.api_version = atoi(argv[++i]);
+    } else if (arg == "--ticks-per-rev" && has_value) {
+      config.ticks_per_rev = atoi(argv[++i]);
+    } else if (arg == "--drift-ppm" && has_value) {
+      config.clock_drift_ppm = atof(argv[++i]);
+    } else if (arg == "--flash-errors" && has_value) {
+      config.flash_error_rate = atof(argv[++i]);
+    } else if (arg == "--link" && has_value) {
+      link_path = argv[++i];
+    } else {
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+  if (config.api_version < 1 || config.api_version > 255 || config.ticks_per_rev <= 0) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+  std::string slave_path = ptsname(master);
+
+  // Keep the slave open in raw mode: no echo of frames written before the
+  // host configures the port, and no EIO on the master between host sessions.
+  int slave = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    perror("open pty slave");
+    return 1;
+  }
+  termios tty;
+  tcgetattr(slave, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(slave, TCSANOW, &tty);
+
+  if (!link_path.empty()) {
+    unlink(link_path.c_str());
+    if (symlink(slave_path.c_str(), link_path.c_str()) != 0) {
+      perror("symlink");
+      return 1;
+    }
+  }
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+
+  try {
+    SerialTransport link(master);
+    link.Start();
+
+    printf("ECU simulator on %s (API v%d)\n",
+           link_path.empty() ? slave_path.c_str() : link_path.c_str(),
+           config.api_version);
+    fflush(stdout);
+
+    EcuSimulator sim(config);
+    EcuSimulator::Frames out;
+    std::vector<uint8_t> request;
+    bool cobs = false;
+    auto flush = [&] {
+      for (auto& frame : out) {
+        link.Send(std::move(frame));
+      }
+      out.clear();
+    };
+    // Receive in the new framing at once; anything already queued, including
+    // the set_framing acknowledgement, still goes out in the old one
+    auto sync_framing = [&] {
+      if (sim.UsesCobs() == cobs) return;
+      cobs = sim.UsesCobs();
+      auto framing = cobs ? SerialTransport::Framing::kCobs
+                          : SerialTransport::Framing::kLegacy;
+      link.SetRxFraming(framing);
+      flush();
+      link.SetTxFraming(framing);
+    };
+    while (g_running) {
+      auto now = EcuSimulator::Clock::now();
+      while (link.Read(request)) {
+        sim.HandleRequest(request, now, out);
+        sync_framing();
+      }
+      sim.Advance(now, out);
+      sync_framing();
+      flush();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  } catch (const std::exception& e) {
+    fprintf(stderr, "error: %s\n", e.what());
+  }
+
+  close(slave);
+  if (!link_path.empty()) unlink(link_path.c_str());
+  return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal assertion for the unit tests: a failed check prints where it is
+// and exits non-zero, which ctest reports as a failure
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,         \
+                   __LINE__, #condition);                                 \
+      std::exit(1);                                                       \
+    }                                                                     \
+  } while (0)
@@ -0,0 +1,58 @@
+// CRC-32 and SHA-256 against the published check values
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Checksums.h"
+
+namespace {
+
+const uint8_t* Bytes(const char* s) {
+  return reinterpret_cast<const uint8_t*>(s);
+}
+
+std::string Hex(const Sha256::Digest& digest) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (uint8_t b : digest) {
+    hex += kDigits[b >> 4];
+    hex += kDigits[b & 0xF];
+  }
+  return hex;
+}
+
+void TestCrc32() {
+  CHECK(Crc32(Bytes("123456789"), 9) == 0xCBF43926);
+  CHECK(Crc32(nullptr, 0) == 0);
+  // In pieces, as the firmware uploader checksums an image
+  uint32_t crc = Crc32(Bytes("1234"), 4);
+  CHECK(Crc32(Bytes("56789"), 5, crc) == 0xCBF43926);
+}
+
+void TestSha256() {
+  CHECK(Hex(Sha256::Hash(nullptr, 0)) ==
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  CHECK(Hex(Sha256::Hash(Bytes("abc"), 3)) ==
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  // Two blocks, the padding in the second
+  const char* two_blocks =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  CHECK(Hex(Sha256::Hash(Bytes(two_blocks), strlen(two_blocks))) ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+  // A million 'a', fed in pieces that straddle the block boundaries
+  std::vector<uint8_t> a(1000, 'a');
+  Sha256 sha;
+  for (int i = 0; i < 1000; ++i) sha.Update(a.data(), a.size());
+  CHECK(Hex(sha.Final()) ==
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+}  // namespace
+
+int main() {
+  TestCrc32();
+  TestSha256();
+  return 0;
+}
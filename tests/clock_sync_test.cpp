@@ -0,0 +1,49 @@
+// Offset and drift estimation from simulated time_sync exchanges
+#include <cmath>
+#include <cstdint>
+
+#include "Check.h"
+#include "ClockSync.h"
+
+namespace {
+
+// ECU clock = host clock * (1 + drift) + offset
+struct SimulatedEcu {
+  double offset_us;
+  double drift;
+  int64_t Time(int64_t host_us) const {
+    return static_cast<int64_t>(std::llround(host_us * (1 + drift) + offset_us));
+  }
+};
+
+void TestOffsetAndDrift() {
+  SimulatedEcu ecu{5e6, 100e-6};
+  ClockSync sync;
+  CHECK(!sync.valid());
+  for (int i = 0; i < 40; ++i) {
+    int64_t t1 = 1000000 + i * 250000;
+    // Symmetric 400 us round trip, every fourth one queued behind a stream
+    int64_t delay = i % 4 == 3 ? 5000 : 200;
+    int64_t t2 = ecu.Time(t1 + delay);
+    int64_t t3 = t2 + 50;
+    int64_t t4 = t1 + 2 * delay + 50;
+    sync.AddExchange(t1, t2, t3, t4);
+  }
+  CHECK(sync.valid());
+  CHECK(std::fabs(sync.drift_ppm() - 100) < 5);
+  CHECK(sync.min_delay_us() == 400);
+  int64_t host_us = 12000000;
+  CHECK(std::llabs(sync.HostToEcu(host_us) - ecu.Time(host_us)) < 20);
+  CHECK(std::llabs(sync.EcuToHost(ecu.Time(host_us)) - host_us) < 20);
+
+  sync.Reset();
+  CHECK(!sync.valid());
+  CHECK(sync.exchanges() == 0);
+}
+
+}  // namespace
+
+int main() {
+  TestOffsetAndDrift();
+  return 0;
+}
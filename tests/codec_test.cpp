@@ -0,0 +1,159 @@
+// Frame encoding in both framings and the compact telemetry blocks
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Check.h"
+#include "CompactCodec.h"
+#include "FrameCodec.h"
+
+namespace {
+
+using Framing = FrameCodec::Framing;
+
+std::vector<std::vector<uint8_t>> Decode(Framing framing,
+                                         const std::vector<uint8_t>& bytes,
+                                         FrameCodec& codec) {
+  std::vector<std::vector<uint8_t>> payloads;
+  codec.SetFraming(framing);
+  codec.Feed(bytes.data(), bytes.size(),
+             [&](std::vector<uint8_t>& payload, const uint8_t*, size_t) {
+               payloads.push_back(payload);
+             });
+  return payloads;
+}
+
+void TestCrc16() {
+  // CRC-16/MODBUS check value
+  CHECK(FrameCodec::Crc16(reinterpret_cast<const uint8_t*>("123456789"), 9) ==
+        0x4B37);
+}
+
+void TestLegacyFrame() {
+  const uint8_t payload[] = {0x01, 0x02};
+  std::vector<uint8_t> frame;
+  CHECK(FrameCodec::Encode(Framing::kLegacy, payload, 2, frame));
+  uint16_t crc = FrameCodec::Crc16(&frame[1], 3);
+  const std::vector<uint8_t> expected = {0xAA, 0x05, 0x01, 0x02,
+                                         static_cast<uint8_t>(crc & 0xFF),
+                                         static_cast<uint8_t>(crc >> 8)};
+  CHECK(frame == expected);
+}
+
+void TestCobsFrame() {
+  // Zeros only as the delimiter
+  const uint8_t payload[] = {0x11, 0x00, 0x00, 0x22};
+  std::vector<uint8_t> frame;
+  CHECK(FrameCodec::Encode(Framing::kCobs, payload, sizeof(payload), frame));
+  CHECK(frame.back() == 0x00);
+  CHECK(std::memchr(frame.data(), 0, frame.size() - 1) == nullptr);
+  CHECK(frame[0] == 0x02 && frame[1] == 0x11 && frame[2] == 0x01);
+}
+
+void TestRoundTrip(Framing framing) {
+  std::vector<std::vector<uint8_t>> sent;
+  for (size_t len : {size_t{1}, size_t{2}, size_t{53}, FrameCodec::kMaxPayload}) {
+    std::vector<uint8_t> payload(len);
+    for (size_t i = 0; i < len; ++i) payload[i] = static_cast<uint8_t>(i * 37);
+    sent.push_back(payload);
+  }
+  std::vector<uint8_t> stream;
+  for (const auto& p : sent) {
+    CHECK(FrameCodec::Encode(framing, p.data(), p.size(), stream));
+  }
+  FrameCodec codec;
+  CHECK(Decode(framing, stream, codec) == sent);
+  CHECK(codec.crc_errors() == 0);
+
+  // A corrupted byte costs only its own frame
+  std::vector<uint8_t> corrupted = stream;
+  corrupted[3] ^= 0x40;
+  FrameCodec resync;
+  auto received = Decode(framing, corrupted, resync);
+  CHECK(received.size() == sent.size() - 1);
+  CHECK(received.back() == sent.back());
+}
+
+void TestEncodeLimits() {
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> big(FrameCodec::kMaxPayload + 1, 1);
+  CHECK(!FrameCodec::Encode(Framing::kLegacy, big.data(), 0, out));
+  CHECK(!FrameCodec::Encode(Framing::kCobs, big.data(), big.size(), out));
+  CHECK(out.empty());
+}
+
+void TestDeltas() {
+  const int32_t deltas[] = {0, -1, 1, -64, 64, INT32_MIN, INT32_MAX};
+  const int count = sizeof(deltas) / sizeof(deltas[0]);
+  std::vector<uint8_t> block;
+  compact::EncodeDeltas(deltas, count, block);
+  // Zigzag: 0, -1 and 1 take one byte each
+  CHECK(block[0] == 0 && block[1] == 1 && block[2] == 2);
+
+  int32_t decoded[count];
+  const uint8_t* p = block.data();
+  CHECK(compact::DecodeDeltas(p, block.data() + block.size(), decoded, count));
+  CHECK(p == block.data() + block.size());
+  CHECK(std::memcmp(decoded, deltas, sizeof(deltas)) == 0);
+
+  // Truncated block
+  p = block.data();
+  CHECK(!compact::DecodeDeltas(p, block.data() + block.size() - 1, decoded,
+                               count));
+  CHECK(p == block.data());
+  // A varint beyond 32 bits
+  const uint8_t overflow[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x1F};
+  p = overflow;
+  CHECK(!compact::DecodeDeltas(p, overflow + sizeof(overflow), decoded, 1));
+  const uint8_t endless[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+  p = endless;
+  CHECK(!compact::DecodeDeltas(p, endless + sizeof(endless), decoded, 1));
+}
+
+void TestImu() {
+  const float fields[compact::kImuFields] = {9.81f, -0.5f, 0.25f, 0.1f, -3.0f,
+                                             31.0f, 40.0f, -12.5f, 0.0f, 1.0f,
+                                             0.0f, 0.0f, 0.0f};
+  std::vector<uint8_t> block;
+  compact::EncodeImu(fields, compact::kDefaultImuExponents, block);
+  CHECK(block.size() == compact::kImuBlockSize);
+
+  float decoded[compact::kImuFields];
+  const uint8_t* p = block.data();
+  CHECK(compact::DecodeImu(p, block.data() + block.size(), decoded));
+  CHECK(p == block.data() + block.size());
+  for (int i = 0; i < compact::kImuFields; ++i) {
+    int sensor = i < 9 ? i / 3 : 3;
+    float step = std::ldexp(1.0f, -compact::kDefaultImuExponents[sensor]);
+    CHECK(std::fabs(decoded[i] - fields[i]) <= step / 2);
+  }
+
+  // Out of range values saturate instead of wrapping
+  float large[compact::kImuFields] = {1000.0f, -1000.0f};
+  block.clear();
+  compact::EncodeImu(large, compact::kDefaultImuExponents, block);
+  p = block.data();
+  CHECK(compact::DecodeImu(p, block.data() + block.size(), decoded));
+  CHECK(decoded[0] > 127.0f && decoded[1] < -127.0f);
+
+  // Truncated block and implausible exponent
+  p = block.data();
+  CHECK(!compact::DecodeImu(p, block.data() + block.size() - 1, decoded));
+  block[0] = 31;
+  p = block.data();
+  CHECK(!compact::DecodeImu(p, block.data() + block.size(), decoded));
+}
+
+}  // namespace
+
+int main() {
+  TestCrc16();
+  TestLegacyFrame();
+  TestCobsFrame();
+  TestRoundTrip(Framing::kLegacy);
+  TestRoundTrip(Framing::kCobs);
+  TestEncodeLimits();
+  TestDeltas();
+  TestImu();
+  return 0;
+}
@@ -0,0 +1,17 @@
+// Stick position to differential drive speeds
+#include <vector>
+
+#include "Check.h"
+#include "DriveMixer.h"
+
+int main() {
+  // Stick up is forward on both sides
+  CHECK(MixDifferentialDrive(0, -1, 100) == std::vector<int>({100, 100, 100, 100}));
+  CHECK(MixDifferentialDrive(0, 0, 100) == std::vector<int>({0, 0, 0, 0}));
+  // Turning right: left side forward, right side back
+  CHECK(MixDifferentialDrive(0.5, 0, 100) == std::vector<int>({50, 50, -50, -50}));
+  // Forward and turning saturates the outer side
+  CHECK(MixDifferentialDrive(1, -1, 100) == std::vector<int>({100, 100, 0, 0}));
+  CHECK(MixDifferentialDrive(-1, 1, 80) == std::vector<int>({-80, -80, 0, 0}));
+  return 0;
+}
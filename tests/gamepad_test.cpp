@@ -0,0 +1,200 @@
+// Stick shaping, and a virtual pad created through uinput that is moved and
+// then unplugged. The device part is skipped (exit code 77) without access
+// to /dev/uinput, e.g. in containers and on CI runners.
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "Gamepad.h"
+
+namespace {
+
+constexpr int kSkipped = 77;
+
+void TestShape() {
+  CHECK(Gamepad::Shape(0.05, 0.1, 0.3) == 0);
+  CHECK(Gamepad::Shape(-0.1, 0.1, 0.3) == 0);
+  CHECK(Gamepad::Shape(1, 0.1, 0.3) == 1);
+  CHECK(Gamepad::Shape(-1, 0.1, 0.3) == -1);
+  CHECK(std::fabs(Gamepad::Shape(0.55, 0.1, 0) - 0.5) < 1e-9);
+  // Expo makes half travel softer, but keeps the sign
+  CHECK(std::fabs(Gamepad::Shape(-0.55, 0.1, 1) + 0.125) < 1e-9);
+}
+
+// A pad with a stick and a button, removed when destroyed
+class VirtualPad {
+ public:
+  bool Create() {
+    fd_ = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) return false;
+    ioctl(fd_, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd_, UI_SET_KEYBIT, BTN_SOUTH);
+    ioctl(fd_, UI_SET_EVBIT, EV_ABS);
+    for (int code : {ABS_X, ABS_Y}) {
+      uinput_abs_setup abs{};
+      abs.code = code;
+      abs.absinfo.minimum = -32768;
+      abs.absinfo.maximum = 32767;
+      if (ioctl(fd_, UI_ABS_SETUP, &abs) < 0) return false;
+    }
+    uinput_setup setup{};
+    setup.id.bustype = BUS_VIRTUAL;
+    std::snprintf(setup.name, sizeof(setup.name), "ecu_pts test pad");
+    if (ioctl(fd_, UI_DEV_SETUP, &setup) < 0 || ioctl(fd_, UI_DEV_CREATE) < 0) {
+      return false;
+    }
+    created_ = true;
+    return FindEventNode();
+  }
+
+  ~VirtualPad() { Unplug(); }
+
+  void Unplug() {
+    if (created_) ioctl(fd_, UI_DEV_DESTROY);
+    created_ = false;
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+  void Move(int x, int y) {
+    Emit(EV_ABS, ABS_X, x);
+    Emit(EV_ABS, ABS_Y, y);
+    Emit(EV_SYN, SYN_REPORT, 0);
+  }
+
+  void Press(bool down) {
+    Emit(EV_KEY, BTN_SOUTH, down);
+    Emit(EV_SYN, SYN_REPORT, 0);
+  }
+
+  const std::string& device() const { return device_; }
+
+ private:
+  void Emit(int type, int code, int value) {
+    input_event ev{};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    CHECK(write(fd_, &ev, sizeof(ev)) == sizeof(ev));
+  }
+
+  // The event node is created by devtmpfs or udev shortly after the device
+  bool FindEventNode() {
+    char sysname[64] = {};
+    if (ioctl(fd_, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) return false;
+    std::string sys = std::string("/sys/devices/virtual/input/") + sysname;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+      if (DIR* dir = opendir(sys.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+          if (std::strncmp(entry->d_name, "event", 5) == 0) {
+            device_ = std::string("/dev/input/") + entry->d_name;
+          }
+        }
+        closedir(dir);
+      }
+      if (!device_.empty() && access(device_.c_str(), R_OK) == 0) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+  }
+
+  int fd_ = -1;
+  bool created_ = false;
+  std::string device_;
+};
+
+// States reported on the gamepad's input thread
+class Recorder {
+ public:
+  void Add(const Gamepad::State& state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.push_back(state);
+    changed_.notify_all();
+  }
+
+  // Waits for the report after the first count ones
+  Gamepad::State Wait(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    CHECK(changed_.wait_for(lock, std::chrono::seconds(2),
+                            [&] { return states_.size() > count; }));
+    return states_[count];
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return states_.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<Gamepad::State> states_;
+};
+
+int TestVirtualPad() {
+  VirtualPad pad;
+  if (!pad.Create()) {
+    std::printf("skipped: no uinput device available\n");
+    return kSkipped;
+  }
+  Gamepad::Config config;
+  config.deadzone = 0.1;
+  config.expo = 0;
+  Gamepad gamepad(pad.device(), config);
+  CHECK(gamepad.name() == "ecu_pts test pad");
+  Recorder recorder;
+  gamepad.Start([&](const Gamepad::State& state) { recorder.Add(state); });
+
+  pad.Move(32767, -32768);
+  auto sent = std::chrono::steady_clock::now();
+  Gamepad::State state = recorder.Wait(0);
+  CHECK(state.connected);
+  CHECK(std::fabs(state.x - 1) < 1e-3 && std::fabs(state.y + 1) < 1e-3);
+  // Kernel timestamps are on the steady_clock time base
+  CHECK(std::chrono::abs(state.time - sent) < std::chrono::milliseconds(500));
+
+  // Half travel, less the deadzone
+  pad.Move(-16384, 0);
+  state = recorder.Wait(1);
+  CHECK(std::fabs(state.x + (0.5 - 0.1) / 0.9) < 1e-3);
+  CHECK(state.y == 0);
+
+  // A button leaves the stick where it was and is not reported
+  pad.Press(true);
+  pad.Press(false);
+  pad.Move(0, 0);
+  state = recorder.Wait(2);
+  CHECK(state.x == 0 && state.y == 0 && state.connected);
+
+  // Unplugged while the stick is pushed: one centred, disconnected state
+  pad.Move(32767, 32767);
+  recorder.Wait(3);
+  pad.Unplug();
+  state = recorder.Wait(4);
+  CHECK(!state.connected);
+  CHECK(state.x == 0 && state.y == 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(recorder.size() == 5);
+  gamepad.Stop();
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  TestShape();
+  return TestVirtualPad();
+}
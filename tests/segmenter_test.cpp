@@ -0,0 +1,104 @@
+// Reassembly over a lossy link and the receiver's transfer size limit
+#include <vector>
+
+#include "Check.h"
+#include "Segmenter.h"
+
+namespace {
+
+using Clock = Segmenter::Clock;
+
+std::vector<uint8_t> MakePayload(size_t len) {
+  std::vector<uint8_t> payload(len);
+  for (size_t i = 0; i < len; ++i) payload[i] = static_cast<uint8_t>(i * 7 + 1);
+  return payload;
+}
+
+// Passes frames between two segmenters, dropping every drop_every-th
+// segment on the way, until nothing is left in flight
+void Run(Segmenter& sender, Segmenter& receiver, Segmenter::Frames to_receiver,
+         Clock::time_point& now, size_t drop_every,
+         Segmenter::Frames& completed) {
+  size_t forwarded = 0;
+  Segmenter::Frames to_sender;
+  for (int step = 0; step < 10000; ++step) {
+    for (auto& frame : to_receiver) {
+      if (drop_every && ++forwarded % drop_every == 0) continue;
+      receiver.OnFrame(frame, now, to_sender, completed);
+    }
+    to_receiver.clear();
+    Segmenter::Frames unused;
+    for (auto& frame : to_sender) {
+      sender.OnFrame(frame, now, to_receiver, unused);
+    }
+    to_sender.clear();
+    if (sender.idle() && to_receiver.empty()) return;
+    now += std::chrono::milliseconds(10);
+    sender.Poll(now, to_receiver);
+    receiver.Poll(now, to_sender);
+  }
+}
+
+void TestLossyTransfer() {
+  Segmenter sender;
+  Segmenter receiver;
+  auto now = Clock::time_point();
+  Segmenter::Frames frames;
+  std::vector<uint8_t> first = MakePayload(10 * Segmenter::kSegmentData + 5);
+  std::vector<uint8_t> second = MakePayload(Segmenter::kSegmentData);
+  CHECK(sender.Send(first, now, frames));
+  CHECK(sender.Send(second, now, frames));
+
+  Segmenter::Frames completed;
+  Run(sender, receiver, std::move(frames), now, 5, completed);
+  CHECK(sender.idle());
+  // The short transfer is not held up by the long one's losses
+  CHECK(completed.size() == 2);
+  CHECK((completed[0] == first && completed[1] == second) ||
+        (completed[0] == second && completed[1] == first));
+  CHECK(sender.stats().retransmits > 0);
+  CHECK(sender.stats().transfers_failed == 0);
+}
+
+void TestSendLimits() {
+  Segmenter sender;
+  Segmenter::Frames frames;
+  CHECK(!sender.Send({}, Clock::time_point(), frames));
+  CHECK(frames.empty());
+}
+
+void TestOversizedTransferDropped() {
+  Segmenter::Config config;
+  config.max_incoming = 4 * Segmenter::kSegmentData;
+  config.max_retries = 2;
+  Segmenter sender;
+  Segmenter receiver(config);
+  auto now = Clock::time_point();
+  Segmenter::Frames frames;
+  CHECK(sender.Send(MakePayload(5 * Segmenter::kSegmentData), now, frames));
+
+  // Nothing is reassembled or acknowledged, so the sender gives up
+  Segmenter::Frames completed;
+  Run(sender, receiver, std::move(frames), now, 0, completed);
+  CHECK(completed.empty());
+  CHECK(receiver.stats().segments_rejected > 0);
+  CHECK(receiver.stats().acks_sent == 0);
+  CHECK(sender.stats().transfers_failed == 1);
+
+  // Transfers within the limit still arrive
+  frames.clear();
+  std::vector<uint8_t> small = MakePayload(4 * Segmenter::kSegmentData);
+  CHECK(sender.Send(small, now, frames));
+  Run(sender, receiver, std::move(frames), now, 0, completed);
+  CHECK(completed.size() == 1);
+  CHECK(completed[0] == small);
+}
+
+}  // namespace
+
+int main() {
+  TestLossyTransfer();
+  TestSendLimits();
+  TestOversizedTransferDropped();
+  return 0;
+}
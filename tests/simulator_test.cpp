@@ -0,0 +1,38 @@
+// The simulator's link-timeout failsafe on an idle session
+#include <chrono>
+
+#include "Check.h"
+#include "EcuSimulator.h"
+
+namespace {
+
+using Clock = EcuSimulator::Clock;
+
+void TestFailsafeKeepsFraming() {
+  auto now = Clock::time_point() + std::chrono::seconds(1);
+  EcuSimulator ecu(EcuSimulator::Config(), now);
+  EcuSimulator::Frames out;
+  ecu.HandleRequest({protocol::kSetFraming, protocol::kFramingCobs}, now, out);
+  CHECK(out.size() == 1);
+  CHECK(out[0] == std::vector<uint8_t>({protocol::kSetFraming, 0}));
+  CHECK(ecu.UsesCobs());
+
+  // Idle for longer than the link timeout: the host is still in COBS, so
+  // the next request must be answered in it
+  for (int i = 0; i < 50; ++i) {
+    now += std::chrono::milliseconds(100);
+    ecu.Advance(now, out);
+  }
+  CHECK(ecu.UsesCobs());
+  out.clear();
+  ecu.HandleRequest({protocol::kGetApiVersion}, now, out);
+  CHECK(out.size() == 1);
+  CHECK(out[0][0] == protocol::kGetApiVersion);
+}
+
+}  // namespace
+
+int main() {
+  TestFailsafeKeepsFraming();
+  return 0;
+}